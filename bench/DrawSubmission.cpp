@@ -0,0 +1,370 @@
+#include "pch.h"
+#include "REngine.h"
+#include "RDevice.h"
+#include "RBuffer.h"
+#include "RTexture.h"
+#include "RPixelShader.h"
+#include "RVertexShader.h"
+#include "RResourceCache.h"
+#include "RThreadPool.h"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace RAPI;
+
+/**
+ * Headless end-to-end benchmark of the draw-submission path on the NULL backend. Builds a synthetic scene
+ * and measures QueuePipelineState -> ProcessRenderQueue -> OnFrameEnd -> Present for a range of thread counts.
+ * With pipelined frames, SubmitFrame takes the place of the last three and the flush runs on the render thread.
+ *
+ * Usage: rapi_bench [name=value ...]
+ *  draws     Number of drawcalls per frame
+ *  queues    Number of renderqueues the draws are spread over
+ *  immediate How many of those are not processed, but drawn directly when flushing
+ *  shaders   Number of distinct vertex-/pixelshader pairs
+ *  textures  Number of distinct textures
+ *  buffers   Number of distinct vertexbuffers
+ *  entropy   Chance of each resource to change between two consecutive draws, 0..1
+ *  rebuild   Number of states built again every frame, through the device's state machine
+ *  sort      Whether the queues sort their states
+ *  frames    Number of measured frames per thread count
+ *  warmup    Number of frames run before measuring
+ *  threads   Highest number of worker-threads to measure. Doubles from 1 up to this.
+ *  seed      Seed for the scene generation
+ *  pipelined Whether to measure every thread count with pipelined frames as well
+ *  out       File to write the JSON-report to. Goes to stdout if not set.
+ */
+
+typedef std::chrono::high_resolution_clock Clock;
+
+struct BenchConfig
+{
+	unsigned int Draws = 100000;
+	unsigned int Queues = 4;
+	unsigned int Immediate = 1;
+	unsigned int Shaders = 16;
+	unsigned int Textures = 64;
+	unsigned int Buffers = 64;
+	double Entropy = 0.25;
+	unsigned int Rebuild = 1000;
+	bool Sort = false;
+	unsigned int Frames = 30;
+	unsigned int Warmup = 5;
+	unsigned int MaxThreads = std::max(1u, std::thread::hardware_concurrency());
+	unsigned int Seed = 1337;
+	bool Pipelined = true;
+	std::string Out;
+};
+
+/** Time spent in each stage, summed up over all measured frames */
+struct BenchTimes
+{
+	double BuildNs = 0.0;
+	double QueueNs = 0.0;
+	double ProcessNs = 0.0;
+	double FrameEndNs = 0.0;
+	double PresentNs = 0.0;
+	double FrameNs = 0.0;
+};
+
+static double ElapsedNs(Clock::time_point start)
+{
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+/** Reads "name=value"-arguments into the config */
+static bool ParseArguments(int argc, char **argv, BenchConfig &cfg)
+{
+	for(int i = 1; i < argc; i++)
+	{
+		const char *eq = strchr(argv[i], '=');
+		if(!eq)
+		{
+			std::cerr << "Expected name=value, got: " << argv[i] << std::endl;
+			return false;
+		}
+
+		std::string name(argv[i], eq - argv[i]);
+		const char *value = eq + 1;
+
+		if(name == "draws") cfg.Draws = (unsigned int)atoi(value);
+		else if(name == "queues") cfg.Queues = (unsigned int)atoi(value);
+		else if(name == "immediate") cfg.Immediate = (unsigned int)atoi(value);
+		else if(name == "shaders") cfg.Shaders = (unsigned int)atoi(value);
+		else if(name == "textures") cfg.Textures = (unsigned int)atoi(value);
+		else if(name == "buffers") cfg.Buffers = (unsigned int)atoi(value);
+		else if(name == "entropy") cfg.Entropy = atof(value);
+		else if(name == "rebuild") cfg.Rebuild = (unsigned int)atoi(value);
+		else if(name == "sort") cfg.Sort = atoi(value) != 0;
+		else if(name == "frames") cfg.Frames = (unsigned int)atoi(value);
+		else if(name == "warmup") cfg.Warmup = (unsigned int)atoi(value);
+		else if(name == "threads") cfg.MaxThreads = (unsigned int)atoi(value);
+		else if(name == "seed") cfg.Seed = (unsigned int)atoi(value);
+		else if(name == "pipelined") cfg.Pipelined = atoi(value) != 0;
+		else if(name == "out") cfg.Out = value;
+		else
+		{
+			std::cerr << "Unknown argument: " << name << std::endl;
+			return false;
+		}
+	}
+
+	cfg.Queues = std::max(1u, cfg.Queues);
+	cfg.Shaders = std::max(1u, cfg.Shaders);
+	cfg.Textures = std::max(1u, cfg.Textures);
+	cfg.Buffers = std::max(1u, cfg.Buffers);
+	cfg.MaxThreads = std::max(1u, cfg.MaxThreads);
+	cfg.Rebuild = std::min(cfg.Rebuild, cfg.Draws);
+	cfg.Immediate = std::min(cfg.Immediate, cfg.Queues);
+
+	return true;
+}
+
+/** Resources of the scene and the states drawing them */
+struct BenchScene
+{
+	std::vector<RVertexShader *> VertexShaders;
+	std::vector<RPixelShader *> PixelShaders;
+	std::vector<RTexture *> Textures;
+	std::vector<RBuffer *> Buffers;
+	std::vector<RPipelineState *> States;
+
+	// States replaced while building the last frame. They may still be drawn until the next one is submitted.
+	std::vector<RPipelineState *> Retired;
+	size_t NextRebuild = 0;
+	std::mt19937 Rng;
+};
+
+static const unsigned int NUM_SCENE_VERTICES = 3;
+
+/** Builds a state drawing the given resources, using the device's state machine */
+static RPipelineState *MakeState(BenchScene &scene, unsigned int shader, unsigned int texture, unsigned int buffer)
+{
+	RStateMachine &sm = REngine::RenderingDevice->GetStateMachine();
+
+	sm.SetVertexShader(scene.VertexShaders[shader]);
+	sm.SetPixelShader(scene.PixelShaders[shader]);
+	sm.SetTexture(0, scene.Textures[texture], EShaderType::ST_PIXEL);
+	sm.SetVertexBuffer(0, scene.Buffers[buffer]);
+
+	return sm.MakeDrawCall(NUM_SCENE_VERTICES);
+}
+
+/**
+ * Creates the resources and one pipeline-state per draw. With an entropy of 0 all draws share the
+ * same resources, with 1 every resource is picked at random for every draw.
+ */
+static void CreateScene(const BenchConfig &cfg, BenchScene &scene)
+{
+	float vertices[NUM_SCENE_VERTICES * 3] = {};
+
+	for(unsigned int i = 0; i < cfg.Shaders; i++)
+	{
+		scene.VertexShaders.push_back(REngine::ResourceCache->CreateResource<RVertexShader>());
+		scene.PixelShaders.push_back(REngine::ResourceCache->CreateResource<RPixelShader>());
+	}
+
+	for(unsigned int i = 0; i < cfg.Textures; i++)
+		scene.Textures.push_back(REngine::ResourceCache->CreateResource<RTexture>());
+
+	for(unsigned int i = 0; i < cfg.Buffers; i++)
+	{
+		RBuffer *b = REngine::ResourceCache->CreateResource<RBuffer>();
+		b->Init(vertices, sizeof(vertices), sizeof(float) * 3, EBindFlags::B_VERTEXBUFFER);
+		scene.Buffers.push_back(b);
+	}
+
+	scene.Rng.seed(cfg.Seed);
+	std::uniform_real_distribution<double> chance(0.0, 1.0);
+	unsigned int shader = 0, texture = 0, buffer = 0;
+
+	scene.States.reserve(cfg.Draws);
+
+	for(unsigned int i = 0; i < cfg.Draws; i++)
+	{
+		if(chance(scene.Rng) < cfg.Entropy) shader = scene.Rng() % cfg.Shaders;
+		if(chance(scene.Rng) < cfg.Entropy) texture = scene.Rng() % cfg.Textures;
+		if(chance(scene.Rng) < cfg.Entropy) buffer = scene.Rng() % cfg.Buffers;
+
+		scene.States.push_back(MakeState(scene, shader, texture, buffer));
+	}
+}
+
+/**
+ * Builds some of the states again with different textures, like an application animating its scene.
+ * With pipelined frames this happens while the render thread draws the previous frame.
+ */
+static void RebuildStates(const BenchConfig &cfg, BenchScene &scene)
+{
+	// Nothing draws the states replaced last frame anymore, the frame before this one was presented
+	for(RPipelineState *s : scene.Retired)
+		REngine::ResourceCache->DeleteResource(s);
+	scene.Retired.clear();
+
+	for(unsigned int i = 0; i < cfg.Rebuild; i++)
+	{
+		size_t index = scene.NextRebuild;
+		scene.NextRebuild = (scene.NextRebuild + 1) % scene.States.size();
+
+		scene.Retired.push_back(scene.States[index]);
+		scene.States[index] = MakeState(scene, scene.Rng() % cfg.Shaders, scene.Rng() % cfg.Textures, scene.Rng() % cfg.Buffers);
+	}
+}
+
+/**
+ * Renders a single frame of the scene. Draws are split into consecutive ranges, one per queue.
+ * When pipelined, the time of SubmitFrame goes into the frame-end.
+ */
+static void RenderFrame(const BenchConfig &cfg, BenchScene &scene, BenchTimes &times)
+{
+	RDevice *device = REngine::RenderingDevice;
+	bool pipelined = device->IsPipeliningFrames();
+	Clock::time_point frameStart = Clock::now();
+
+	if(!pipelined)
+		device->OnFrameStart();
+
+	Clock::time_point start = Clock::now();
+	RebuildStates(cfg, scene);
+	times.BuildNs += ElapsedNs(start);
+
+	const std::vector<RPipelineState *> &states = scene.States;
+
+	start = Clock::now();
+	std::vector<RRenderQueueID> queues;
+	for(unsigned int q = 0; q < cfg.Queues; q++)
+	{
+		RRenderQueueID id = device->AcquireRenderQueue(cfg.Sort);
+		queues.push_back(id);
+
+		size_t first = states.size() * q / cfg.Queues;
+		size_t last = states.size() * (q + 1) / cfg.Queues;
+		for(size_t i = first; i < last; i++)
+			device->QueuePipelineState(states[i], id);
+	}
+	times.QueueNs += ElapsedNs(start);
+
+	start = Clock::now();
+	for(size_t q = cfg.Immediate; q < queues.size(); q++)
+		device->ProcessRenderQueue(queues[q]);
+	times.ProcessNs += ElapsedNs(start);
+
+	start = Clock::now();
+	if(pipelined)
+		device->SubmitFrame();
+	else
+		device->OnFrameEnd();
+	times.FrameEndNs += ElapsedNs(start);
+
+	if(!pipelined)
+	{
+		start = Clock::now();
+		device->Present();
+		times.PresentNs += ElapsedNs(start);
+	}
+
+	times.FrameNs += ElapsedNs(frameStart);
+}
+
+/** Runs the whole scene with the given number of worker-threads */
+static BenchTimes RunWithThreads(const BenchConfig &cfg, unsigned int numThreads, bool pipelined)
+{
+	REngine::InitializeEngine(numThreads);
+	REngine::RenderingDevice->CreateDevice();
+
+	BenchScene scene;
+	CreateScene(cfg, scene);
+	BenchTimes times;
+
+	if(pipelined)
+		REngine::RenderingDevice->SetPipelinedFrames(true);
+
+	for(unsigned int i = 0; i < cfg.Warmup; i++)
+		RenderFrame(cfg, scene, times);
+
+	times = BenchTimes();
+	for(unsigned int i = 0; i < cfg.Frames; i++)
+		RenderFrame(cfg, scene, times);
+
+	// Stopping waits for the last frame, which the measurement should include
+	if(pipelined)
+	{
+		Clock::time_point start = Clock::now();
+		REngine::RenderingDevice->SetPipelinedFrames(false);
+		times.FrameEndNs += ElapsedNs(start);
+		times.FrameNs += ElapsedNs(start);
+	}
+
+	REngine::UninitializeEngine();
+
+	return times;
+}
+
+int main(int argc, char **argv)
+{
+	BenchConfig cfg;
+	if(!ParseArguments(argc, argv, cfg))
+		return 1;
+
+	std::vector<unsigned int> threadCounts;
+	for(unsigned int t = 1; t < cfg.MaxThreads; t *= 2)
+		threadCounts.push_back(t);
+	threadCounts.push_back(cfg.MaxThreads);
+
+	std::vector<bool> modes = {false};
+	if(cfg.Pipelined)
+		modes.push_back(true);
+
+	std::ofstream file;
+	if(!cfg.Out.empty())
+		file.open(cfg.Out);
+
+	std::ostream &out = cfg.Out.empty() ? std::cout : file;
+	double drawsMeasured = std::max(1.0, (double)cfg.Draws * cfg.Frames);
+	double baseFrameNs[2] = {0.0, 0.0};
+
+	out << "{\n"
+		<< "  \"backend\": \"NULL\",\n"
+		<< "  \"config\": {"
+		<< "\"draws\": " << cfg.Draws << ", \"queues\": " << cfg.Queues << ", \"immediate\": " << cfg.Immediate << ", \"shaders\": " << cfg.Shaders
+		<< ", \"rebuild\": " << cfg.Rebuild << ", \"textures\": " << cfg.Textures << ", \"buffers\": " << cfg.Buffers << ", \"entropy\": " << cfg.Entropy
+		<< ", \"sort\": " << (cfg.Sort ? "true" : "false") << ", \"frames\": " << cfg.Frames
+		<< ", \"warmup\": " << cfg.Warmup << ", \"seed\": " << cfg.Seed
+		<< ", \"pipelined\": " << (cfg.Pipelined ? "true" : "false") << "},\n"
+		<< "  \"results\": [\n";
+
+	for(size_t m = 0; m < modes.size(); m++)
+	{
+		for(size_t i = 0; i < threadCounts.size(); i++)
+		{
+			BenchTimes t = RunWithThreads(cfg, threadCounts[i], modes[m]);
+
+			// Speedups are against a single thread of the same mode
+			if(i == 0)
+				baseFrameNs[m] = t.FrameNs;
+
+			bool last = m + 1 == modes.size() && i + 1 == threadCounts.size();
+
+			out << "    {\"threads\": " << threadCounts[i]
+				<< ", \"pipelined\": " << (modes[m] ? "true" : "false")
+				<< ", \"ns_per_draw\": " << t.FrameNs / drawsMeasured
+				<< ", \"build_ns_per_draw\": " << t.BuildNs / drawsMeasured
+				<< ", \"queue_ns_per_draw\": " << t.QueueNs / drawsMeasured
+				<< ", \"process_ns_per_draw\": " << t.ProcessNs / drawsMeasured
+				<< ", \"frame_end_ns_per_draw\": " << t.FrameEndNs / drawsMeasured
+				<< ", \"present_ns_per_draw\": " << t.PresentNs / drawsMeasured
+				<< ", \"ms_per_frame\": " << t.FrameNs / std::max(1u, cfg.Frames) / 1e6
+				<< ", \"speedup\": " << (t.FrameNs > 0.0 ? baseFrameNs[m] / t.FrameNs : 0.0)
+				<< "}" << (last ? "" : ",") << "\n";
+		}
+	}
+
+	out << "  ]\n"
+		<< "}" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,170 @@
+#include "pch.h"
+#include "REngine.h"
+#include "RDevice.h"
+#include "RFrameCapture.h"
+#include <chrono>
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef RND_GL
+#include <GLFW/glfw3.h>
+#endif
+
+using namespace RAPI;
+
+/**
+ * Replays a frame written by RDevice::CaptureNextFrame, so the submission path can be profiled
+ * without the application that produced it. Runs on the backend the tool was built for, the GL
+ * build opens a window for its context.
+ *
+ * Usage: rapi_replay <capture-file> [name=value ...]
+ *  frames    Number of measured frames
+ *  warmup    Number of frames run before measuring
+ *  threads   Number of worker-threads. Uses one per core if 0.
+ *
+ * Also reports the time taken to create the resources and render the first frame, which is where
+ * the GL build compiles and links its programs, or loads them from its program cache.
+ */
+
+typedef std::chrono::high_resolution_clock Clock;
+
+struct ReplayConfig
+{
+	std::string File;
+	unsigned int Frames = 100;
+	unsigned int Warmup = 5;
+	unsigned int Threads = 0;
+};
+
+/** Reads the file and the "name=value"-arguments into the config */
+static bool ParseArguments(int argc, char **argv, ReplayConfig &cfg)
+{
+	if(argc < 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " <capture-file> [frames=N] [warmup=N] [threads=N]" << std::endl;
+		return false;
+	}
+
+	cfg.File = argv[1];
+
+	for(int i = 2; i < argc; i++)
+	{
+		const char *eq = strchr(argv[i], '=');
+		if(!eq)
+		{
+			std::cerr << "Expected name=value, got: " << argv[i] << std::endl;
+			return false;
+		}
+
+		std::string name(argv[i], eq - argv[i]);
+		const char *value = eq + 1;
+
+		if(name == "frames") cfg.Frames = (unsigned int)atoi(value);
+		else if(name == "warmup") cfg.Warmup = (unsigned int)atoi(value);
+		else if(name == "threads") cfg.Threads = (unsigned int)atoi(value);
+		else
+		{
+			std::cerr << "Unknown argument: " << name << std::endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/** Renders a single replayed frame */
+static void RenderFrame(RFrameReplay &replay)
+{
+	RDevice *device = REngine::RenderingDevice;
+
+	device->OnFrameStart();
+	replay.QueueFrame();
+	device->OnFrameEnd();
+	device->Present();
+}
+
+int main(int argc, char **argv)
+{
+	ReplayConfig cfg;
+	if(!ParseArguments(argc, argv, cfg))
+		return 1;
+
+	// Resources of the replay have to go before the engine does, so it isn't kept on the stack
+	RFrameReplay *replay = new RFrameReplay();
+	if(!replay->LoadFromFile(cfg.File))
+	{
+		std::cerr << "Failed to load capture: " << cfg.File << std::endl;
+		delete replay;
+		return 1;
+	}
+
+#ifdef RND_GL
+	if(!glfwInit())
+		return 1;
+
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	GLFWwindow *wnd = glfwCreateWindow(1280, 720, "rapi_replay", nullptr, nullptr);
+	if(!wnd)
+	{
+		glfwTerminate();
+		return 1;
+	}
+#endif
+
+	REngine::InitializeEngine(cfg.Threads);
+	REngine::RenderingDevice->CreateDevice();
+
+#ifdef RND_GL
+	REngine::RenderingDevice->SetWindow(wnd);
+#endif
+
+	Clock::time_point startup = Clock::now();
+	replay->CreateResources();
+	double startupMs = (double)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - startup).count() / 1e3;
+
+	// The first frame links the programs, so keep it apart from the rest of the warmup
+	Clock::time_point firstFrame = Clock::now();
+	RenderFrame(*replay);
+	double firstFrameMs = (double)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - firstFrame).count() / 1e3;
+
+	for(unsigned int i = 1; i < cfg.Warmup; i++)
+		RenderFrame(*replay);
+
+	Clock::time_point start = Clock::now();
+	for(unsigned int i = 0; i < cfg.Frames; i++)
+		RenderFrame(*replay);
+
+	double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+	double frames = std::max(1.0, (double)cfg.Frames);
+
+	std::cout << "Replayed " << cfg.Frames << " frames of " << replay->GetNumQueues() << " queues, "
+			  << replay->GetNumDrawCalls() << " draws each" << std::endl;
+	std::cout << "  startup ms:   " << startupMs << ", first frame ms: " << firstFrameMs << std::endl;
+	std::cout << "  ms per frame: " << ns / frames / 1e6 << std::endl;
+	std::cout << "  ns per draw:  " << ns / (frames * std::max(1u, replay->GetNumDrawCalls())) << std::endl;
+
+#ifdef RND_GL
+	const RGLStateCacheStats &gl = REngine::RenderingDevice->GetStateCacheStats();
+	std::cout << "  GL calls per frame: " << gl.NumCalls << ", avoided: " << gl.NumAvoided << std::endl;
+
+	const RGLProgramCacheStats &programs = REngine::RenderingDevice->GetProgramCache().GetStats();
+	std::cout << "  GL programs loaded: " << programs.NumLoaded << ", linked: " << programs.NumLinked
+			  << ", rejected: " << programs.NumRejected << std::endl;
+#endif
+
+	for(auto &r : REngine::RenderingDevice->GetProfilerResults())
+		std::cout << "  " << r.first << ": " << r.second.GPUTime << " ms" << std::endl;
+
+	delete replay;
+
+	REngine::UninitializeEngine();
+
+#ifdef RND_GL
+	glfwTerminate();
+#endif
+
+	return 0;
+}
@@ -0,0 +1,87 @@
+#include "pch.h"
+#include "RThreadPool.h"
+#include <chrono>
+#include <iostream>
+#include <math.h>
+#include <stdlib.h>
+
+using namespace RAPI;
+
+/**
+ * Measures how the threadpool scales from 1 to N threads.
+ *  - enqueue:      many tiny tasks queued from the main thread and waited on through their futures
+ *  - parallel_for: a fixed amount of math split into automatically sized chunks
+ * Usage: rapi_threadpool_bench [maxThreads] [numTasks] [numElements]
+ */
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double ElapsedNs(Clock::time_point start)
+{
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+/** Some cheap but not optimizable work per element */
+static float Work(size_t i)
+{
+	float x = (float)i;
+	for(int j = 0; j < 16; j++)
+		x = sqrtf(x * 1.0001f + (float)j);
+
+	return x;
+}
+
+int main(int argc, char **argv)
+{
+	size_t maxThreads = argc > 1 ? (size_t)atoi(argv[1]) : std::max(1u, std::thread::hardware_concurrency());
+	size_t numTasks = argc > 2 ? (size_t)atoi(argv[2]) : 100000;
+	size_t numElements = argc > 3 ? (size_t)atoi(argv[3]) : 10000000;
+
+	std::vector<float> output(numElements);
+	double enqueueBase = 0.0;
+	double parallelForBase = 0.0;
+
+	std::cout << "threads, enqueue ns/task, enqueue speedup, parallel_for ns/element, parallel_for speedup" << std::endl;
+
+	for(size_t threads = 1; threads <= maxThreads; threads++)
+	{
+		RThreadPool pool(threads);
+
+		// Fine-grained tasks
+		std::vector<std::future<float>> futures;
+		futures.reserve(numTasks);
+
+		Clock::time_point start = Clock::now();
+		for(size_t i = 0; i < numTasks; i++)
+			futures.push_back(pool.enqueue(Work, i));
+
+		float sum = 0.0f;
+		for(auto &f : futures)
+			sum += f.get();
+
+		double enqueueNs = ElapsedNs(start) / numTasks;
+
+		// Data-parallel loop
+		start = Clock::now();
+		pool.parallel_for(0, numElements, [&](size_t s, size_t e)
+		{
+			for(size_t i = s; i < e; i++)
+				output[i] = Work(i);
+		});
+
+		double parallelForNs = ElapsedNs(start) / numElements;
+
+		if(threads == 1)
+		{
+			enqueueBase = enqueueNs;
+			parallelForBase = parallelForNs;
+		}
+
+		std::cout << threads << ", "
+			<< enqueueNs << ", " << enqueueBase / enqueueNs << ", "
+			<< parallelForNs << ", " << parallelForBase / parallelForNs
+			<< (sum < 0.0f ? " " : "") << std::endl;
+	}
+
+	return 0;
+}
@@ -65,6 +65,26 @@ bool RBuffer::UpdateData(const void *data, size_t dataSize)
     return UpdateDataAPI(data, dataSize);
 }
 
+/**
+ * Copies the contents of this buffer back to the CPU. Stalls until the GPU is done with it,
+ * so this is only meant for tools like the frame-capture.
+ */
+bool RBuffer::ReadBack(std::vector<uint8_t> &data)
+{
+    data.resize(SizeInBytes);
+
+    if (!SizeInBytes)
+        return true;
+
+    if (!ReadBackAPI(data.data()))
+    {
+        data.clear();
+        return false;
+    }
+
+    return true;
+}
+
 /**
 * Deletes all resources this holds but keeps the object around.
 * Recreate the buffer by calling Init
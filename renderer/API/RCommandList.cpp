@@ -18,6 +18,13 @@ bool RCommandList::Init()
     return InitAPI();
 }
 
+/** Records the packet at the given index of a renderqueue into this commandlist */
+bool RCommandList::RecordDrawPacket(const RDrawPackets &packets, size_t index, const RStateMachine::ChangesStruct &changes,
+									RStateMachine &stateMachine)
+{
+    return RecordDrawPacketAPI(packets, index, changes, stateMachine);
+}
+
 /** Creates the commandlist and makes it ready to be played back */
 bool RCommandList::FinalizeCommandList()
 {
@@ -0,0 +1,306 @@
+#include "pch.h"
+#include "RCullingSystem.h"
+#include "REngine.h"
+#include "RDevice.h"
+#include "RThreadPool.h"
+#include <atomic>
+#include <math.h>
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define RAPI_CULLING_SSE
+#include <xmmintrin.h>
+#endif
+
+using namespace RAPI;
+
+// Number of drawables a single task culls at least. Multiple of 4, so the SIMD-path stays on full groups.
+const size_t CULLING_CHUNK_SIZE = 1024;
+
+// Handle-slot of removed drawables
+const unsigned int INVALID_CULLING_INDEX = 0xFFFFFFFF;
+
+RCullingSystem::RCullingSystem()
+{
+}
+
+RCullingSystem::~RCullingSystem()
+{
+}
+
+/**
+ * Adds a drawable bounded by the given sphere. The state gets queued whenever the volume is visible.
+ */
+RCullingHandle RCullingSystem::AddSphere(const RFloat3 &center, float radius, const RPipelineState *state)
+{
+	RCullingHandle h = AllocateHandle();
+	UpdateSphere(h, center, radius);
+	SetPipelineState(h, state);
+
+	return h;
+}
+
+/**
+ * Adds a drawable bounded by the given box. The state gets queued whenever the volume is visible.
+ */
+RCullingHandle RCullingSystem::AddAABB(const RFloat3 &min, const RFloat3 &max, const RPipelineState *state)
+{
+	RCullingHandle h = AllocateHandle();
+	UpdateAABB(h, min, max);
+	SetPipelineState(h, state);
+
+	return h;
+}
+
+/**
+ * Moves the bounding volume of the given drawable
+ */
+void RCullingSystem::UpdateSphere(RCullingHandle handle, const RFloat3 &center, float radius)
+{
+	unsigned int i = HandleToIndex[handle];
+
+	CenterX[i] = center.x;
+	CenterY[i] = center.y;
+	CenterZ[i] = center.z;
+	ExtentX[i] = 0.0f;
+	ExtentY[i] = 0.0f;
+	ExtentZ[i] = 0.0f;
+	Radius[i] = radius;
+}
+
+void RCullingSystem::UpdateAABB(RCullingHandle handle, const RFloat3 &min, const RFloat3 &max)
+{
+	unsigned int i = HandleToIndex[handle];
+
+	CenterX[i] = (min.x + max.x) * 0.5f;
+	CenterY[i] = (min.y + max.y) * 0.5f;
+	CenterZ[i] = (min.z + max.z) * 0.5f;
+	ExtentX[i] = (max.x - min.x) * 0.5f;
+	ExtentY[i] = (max.y - min.y) * 0.5f;
+	ExtentZ[i] = (max.z - min.z) * 0.5f;
+	Radius[i] = 0.0f;
+}
+
+/**
+ * Changes the state queued for the given drawable
+ */
+void RCullingSystem::SetPipelineState(RCullingHandle handle, const RPipelineState *state)
+{
+	States[HandleToIndex[handle]] = state;
+}
+
+/**
+ * Removes the drawable. The last one takes its place, so the arrays stay packed.
+ */
+void RCullingSystem::Remove(RCullingHandle handle)
+{
+	unsigned int i = HandleToIndex[handle];
+	unsigned int last = (unsigned int)States.size() - 1;
+
+	CenterX[i] = CenterX[last];
+	CenterY[i] = CenterY[last];
+	CenterZ[i] = CenterZ[last];
+	ExtentX[i] = ExtentX[last];
+	ExtentY[i] = ExtentY[last];
+	ExtentZ[i] = ExtentZ[last];
+	Radius[i] = Radius[last];
+	States[i] = States[last];
+
+	RCullingHandle moved = IndexToHandle[last];
+	IndexToHandle[i] = moved;
+	HandleToIndex[moved] = i;
+
+	CenterX.pop_back();
+	CenterY.pop_back();
+	CenterZ.pop_back();
+	ExtentX.pop_back();
+	ExtentY.pop_back();
+	ExtentZ.pop_back();
+	Radius.pop_back();
+	States.pop_back();
+	IndexToHandle.pop_back();
+
+	HandleToIndex[handle] = INVALID_CULLING_INDEX;
+	FreeHandles.push_back(handle);
+}
+
+/**
+ * Removes all drawables
+ */
+void RCullingSystem::Clear()
+{
+	CenterX.clear();
+	CenterY.clear();
+	CenterZ.clear();
+	ExtentX.clear();
+	ExtentY.clear();
+	ExtentZ.clear();
+	Radius.clear();
+	States.clear();
+	HandleToIndex.clear();
+	IndexToHandle.clear();
+	FreeHandles.clear();
+}
+
+/**
+ * Returns a free handle, pointing to a new slot at the end of the arrays
+ */
+RCullingHandle RCullingSystem::AllocateHandle()
+{
+	RCullingHandle h;
+	if(!FreeHandles.empty()) {
+		h = FreeHandles.back();
+		FreeHandles.pop_back();
+	}
+	else {
+		h = (RCullingHandle)HandleToIndex.size();
+		HandleToIndex.push_back(INVALID_CULLING_INDEX);
+	}
+
+	HandleToIndex[h] = (unsigned int)States.size();
+	IndexToHandle.push_back(h);
+
+	CenterX.push_back(0.0f);
+	CenterY.push_back(0.0f);
+	CenterZ.push_back(0.0f);
+	ExtentX.push_back(0.0f);
+	ExtentY.push_back(0.0f);
+	ExtentZ.push_back(0.0f);
+	Radius.push_back(0.0f);
+	States.push_back(nullptr);
+
+	return h;
+}
+
+/**
+ * Pulls the 6 normalized frustum planes out of a view-projection matrix
+ */
+void RCullingSystem::ExtractFrustumPlanes(const RMatrix &viewProj, RFloat4 *planes)
+{
+	const float *m = viewProj.m;
+
+	// Rows of the matrix
+	RFloat4 r0(m[0], m[4], m[8], m[12]);
+	RFloat4 r1(m[1], m[5], m[9], m[13]);
+	RFloat4 r2(m[2], m[6], m[10], m[14]);
+	RFloat4 r3(m[3], m[7], m[11], m[15]);
+
+	planes[0] = RFloat4(r3.x + r0.x, r3.y + r0.y, r3.z + r0.z, r3.w + r0.w); // Left
+	planes[1] = RFloat4(r3.x - r0.x, r3.y - r0.y, r3.z - r0.z, r3.w - r0.w); // Right
+	planes[2] = RFloat4(r3.x + r1.x, r3.y + r1.y, r3.z + r1.z, r3.w + r1.w); // Bottom
+	planes[3] = RFloat4(r3.x - r1.x, r3.y - r1.y, r3.z - r1.z, r3.w - r1.w); // Top
+	planes[4] = RFloat4(r3.x + r2.x, r3.y + r2.y, r3.z + r2.z, r3.w + r2.w); // Near. Takes [-w, w] depth, which also covers [0, w].
+	planes[5] = RFloat4(r3.x - r2.x, r3.y - r2.y, r3.z - r2.z, r3.w - r2.w); // Far
+
+	for(int i = 0; i < 6; i++) {
+		float len = sqrtf(planes[i].x * planes[i].x + planes[i].y * planes[i].y + planes[i].z * planes[i].z);
+		if(len > 0.0f) {
+			planes[i].x /= len;
+			planes[i].y /= len;
+			planes[i].z /= len;
+			planes[i].w /= len;
+		}
+	}
+}
+
+/**
+ * Culls all drawables against the frustum of the given view-projection matrix
+ */
+unsigned int RCullingSystem::CullAndQueue(const RMatrix &viewProj, RRenderQueueID queue)
+{
+	RFloat4 planes[6];
+	ExtractFrustumPlanes(viewProj, planes);
+
+	return CullAndQueue(planes, queue);
+}
+
+/**
+ * Culls all drawables against the given planes, spread over the threadpool
+ */
+unsigned int RCullingSystem::CullAndQueue(const RFloat4 *planes, RRenderQueueID queue)
+{
+	std::atomic<unsigned int> numVisible(0);
+
+	REngine::ThreadPool->parallel_for(0, States.size(), [&](size_t start, size_t end) {
+		numVisible += CullRange(start, end, planes, queue);
+	}, CULLING_CHUNK_SIZE);
+
+	return numVisible;
+}
+
+/**
+ * Tests the drawables in [start, end) and queues the visible ones. A volume is outside as soon as
+ * it is completely behind one of the planes.
+ */
+unsigned int RCullingSystem::CullRange(size_t start, size_t end, const RFloat4 *planes, RRenderQueueID queue) const
+{
+	RDevice *device = REngine::RenderingDevice;
+	unsigned int numVisible = 0;
+	size_t i = start;
+
+#ifdef RAPI_CULLING_SSE
+	__m128 nx[6], ny[6], nz[6], nw[6], ax[6], ay[6], az[6];
+	for(int p = 0; p < 6; p++) {
+		nx[p] = _mm_set1_ps(planes[p].x);
+		ny[p] = _mm_set1_ps(planes[p].y);
+		nz[p] = _mm_set1_ps(planes[p].z);
+		nw[p] = _mm_set1_ps(planes[p].w);
+		ax[p] = _mm_set1_ps(fabsf(planes[p].x));
+		ay[p] = _mm_set1_ps(fabsf(planes[p].y));
+		az[p] = _mm_set1_ps(fabsf(planes[p].z));
+	}
+
+	__m128 zero = _mm_setzero_ps();
+
+	// 4 drawables at a time
+	for(; i + 4 <= end; i += 4) {
+		__m128 cx = _mm_loadu_ps(&CenterX[i]);
+		__m128 cy = _mm_loadu_ps(&CenterY[i]);
+		__m128 cz = _mm_loadu_ps(&CenterZ[i]);
+		__m128 ex = _mm_loadu_ps(&ExtentX[i]);
+		__m128 ey = _mm_loadu_ps(&ExtentY[i]);
+		__m128 ez = _mm_loadu_ps(&ExtentZ[i]);
+		__m128 r = _mm_loadu_ps(&Radius[i]);
+
+		__m128 outside = zero;
+		for(int p = 0; p < 6; p++) {
+			// Signed distance of the center and how far the volume reaches towards the plane
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], cx), _mm_mul_ps(ny[p], cy)),
+								  _mm_add_ps(_mm_mul_ps(nz[p], cz), nw[p]));
+			__m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[p], ex), _mm_mul_ps(ay[p], ey)),
+									  _mm_add_ps(_mm_mul_ps(az[p], ez), r));
+
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(d, reach), zero));
+		}
+
+		int visible = ~_mm_movemask_ps(outside) & 0xF;
+		while(visible) {
+			int bit = visible & -visible;
+			int lane = bit == 1 ? 0 : bit == 2 ? 1 : bit == 4 ? 2 : 3;
+
+			device->QueuePipelineState(States[i + lane], queue);
+			numVisible++;
+
+			visible &= visible - 1;
+		}
+	}
+#endif
+
+	// Scalar path for whatever is left
+	for(; i < end; i++) {
+		bool outside = false;
+		for(int p = 0; p < 6 && !outside; p++) {
+			const RFloat4 &n = planes[p];
+			float d = n.x * CenterX[i] + n.y * CenterY[i] + n.z * CenterZ[i] + n.w;
+			float reach = fabsf(n.x) * ExtentX[i] + fabsf(n.y) * ExtentY[i] + fabsf(n.z) * ExtentZ[i] + Radius[i];
+
+			outside = d + reach < 0.0f;
+		}
+
+		if(!outside) {
+			device->QueuePipelineState(States[i], queue);
+			numVisible++;
+		}
+	}
+
+	return numVisible;
+}
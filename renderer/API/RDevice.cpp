@@ -8,6 +8,10 @@
 #include "RCommandList.h"
 #include "RBuffer.h"
 #include "RTools.h"
+#include "RDynamicBufferCache.h"
+#include "RFrameCapture.h"
+#include "RDrawContext.h"
+#include <chrono>
 
 using namespace RAPI;
 
@@ -18,6 +22,43 @@ using namespace RAPI;
 
 const unsigned int MIN_STATES_FOR_THREADED_RENDER = 2;
 
+// Smallest number of states a single thread computes the changes for when processing a queue
+const unsigned int MIN_STATES_PER_CHANGES_CHUNK = 1024;
+
+#ifndef PUBLIC_RELEASE
+/**
+ * Makes sure the draw of the given state doesn't read past the end of its vertexbuffer
+ */
+static void CheckVertexBufferBounds(const RPipelineState &state, RBuffer *vertexBuffer)
+{
+	if(!vertexBuffer || !vertexBuffer->GetStructuredByteSize())
+		return;
+
+	size_t numBufferElements = vertexBuffer->GetSizeInBytes() / vertexBuffer->GetStructuredByteSize();
+	assert(numBufferElements >= state.NumDrawElements + state.StartVertexOffset);
+}
+#endif
+
+/**
+ * Rough estimate of how expensive recording a state with the given changes is, compared to the others.
+ * Shaders and vertexbuffers need lookups on the API-Side, simple states don't.
+ */
+static unsigned int EstimateRecordingCost(const RStateMachine::ChangesStruct &c)
+{
+	unsigned int cost = 2; // The drawcall itself
+
+	cost += (c.VertexShader || c.PixelShader) ? 8 : 0;
+	cost += (c.VertexBuffers[0] || c.VertexBuffers[1] || c.InputLayout) ? 4 : 0;
+	cost += c.MainTexture ? 4 : 0;
+	cost += c.IndexBuffer ? 2 : 0;
+	cost += c.RasterizerState + c.BlendState + c.DepthStencilState + c.SamplerState + c.Viewport;
+
+	for(int i = 0; i < EShaderType::ST_NUM_SHADER_TYPES; i++)
+		cost += 2 * (c.ConstantBuffers[i] + c.StructuredBuffers[i]);
+
+	return cost;
+}
+
 RDevice::RDevice()
 {
 }
@@ -25,7 +66,14 @@ RDevice::RDevice()
 
 RDevice::~RDevice()
 {
+	if(IsPipeliningFrames())
+		SetPipelinedFrames(false);
+
+	delete PendingCapture.exchange(nullptr);
+
 	RTools::DeleteElements(RenderQueue);
+	RTools::DeleteElements(SubmittedRenderQueue);
+	RTools::DeleteElements(DrawContexts);
 }
 
 /**
@@ -44,6 +92,10 @@ bool RDevice::CreateDevice()
 		RegisterThread((uint32_t)threadIDs[i]);
 	}
 
+	// One draw-context per worker, the last one for everyone else
+	for(size_t i = 0; i <= REngine::ThreadPool->getNumThreads(); i++)
+		DrawContexts.push_back(new RDrawContext());
+
 	return true;
 }
 
@@ -99,7 +151,7 @@ bool RDevice::OnResize()
 bool RDevice::OnFrameStart()
 {
 	// Prepare for new frame
-	StateMachine.Invalidate();
+	ContextStateMachine.Invalidate();
 
 	Profiler.StartProfile("Frame");
 
@@ -113,23 +165,186 @@ bool RDevice::OnFrameStart()
 */
 bool RDevice::OnFrameEnd()
 {
+	ApplicationFrameCounter++;
+
 	PrepareFrameAPI();
+	HandOffFrameData();
 
-	for(unsigned int i = 0; i < RenderQueue.size(); i++) {
-		if(RenderQueue[i]->InUse)
-			PrepareCommandlists(i);
-	}
+	return FlushRenderQueues(RenderQueue);
+}
+
+/**
+ * Gets the data written for the frame onto the GPU before anything gets drawn and
+ * moves the dynamic buffers on, so the next frame can be written to already. Buffers this frame
+ * is done with only come back after it was drawn, which the buffer cache keeps a second frame for.
+ */
+void RDevice::HandOffFrameData()
+{
+	REngine::DynamicBufferCache->FlushTransientAllocations();
+	REngine::DynamicBufferCache->OnFrameEnded();
+}
+
+/**
+ * Submits all queues of the given set
+ */
+bool RDevice::FlushRenderQueues(std::vector<RRenderQueue *> &queues)
+{
+	// Processed queues have been recording their commandlists since they were processed, so only
+	// submission is left to do. It waits for each queue just before it is needed.
+	std::vector<RRenderQueueID> order;
+	GetSubmissionOrder(queues, order);
+
+	// Pick up a capture requested for this frame
+	ActiveCapture = PendingCapture.exchange(nullptr);
 
 	Profiler.StartProfile("Flush total");
-	for(unsigned int i = 0; i < RenderQueue.size(); i++) {
-		if(RenderQueue[i]->InUse)
-			FlushRenderQueue(i);
-	}
+	for(RRenderQueueID i : order)
+		FlushRenderQueue(*queues[i]);
 	Profiler.EndProfile("Flush total");
 
+	// The set of the render thread gets its free slots and stats collected when it is swapped back in
+	if(&queues == &RenderQueue) {
+		for(RRenderQueueID i : order)
+			if(!queues[i]->Persistent)
+				FreeRenderQueues.push_back(i);
+
+		CollectRegisteredQueueStats(RenderQueue);
+	}
+
+	if(ActiveCapture) {
+		ActiveCapture->WriteToFile();
+		delete ActiveCapture;
+		ActiveCapture = nullptr;
+	}
+
 	return OnFrameEndAPI();
 }
 
+/**
+ * Writes the queues flushed at the end of the next frame into the given file
+ */
+void RDevice::CaptureNextFrame(const std::string &file, bool withBufferContents)
+{
+	delete PendingCapture.exchange(new RFrameCapture(file, withBufferContents));
+}
+
+/**
+ * Starts or stops rendering on a separate thread. While pipelining, SubmitFrame replaces OnFrameStart,
+ * OnFrameEnd and Present: The application builds the next frame while the last one gets drawn.
+ * The API-Context moves to the render thread, so resources must not be created while this is active.
+ */
+bool RDevice::SetPipelinedFrames(bool enabled)
+{
+	if(enabled == IsPipeliningFrames())
+		return true;
+
+	if(enabled) {
+		LEB_R(ReleaseContextAPI());
+		RenderThread = std::thread([this]() { RenderThreadFunc(); });
+	}
+	else {
+		WaitForSubmittedFrame();
+
+		{
+			std::lock_guard<std::mutex> lock(RenderThreadMutex);
+			StopRenderThread = true;
+		}
+
+		RenderThreadCV.notify_all();
+		RenderThread.join();
+		StopRenderThread = false;
+
+		// The last frame never gets swapped back in
+		CollectRegisteredQueueStats(SubmittedRenderQueue);
+
+		LEB_R(MakeContextCurrentAPI());
+	}
+
+	return true;
+}
+
+/**
+ * Hands the queues of the current frame to the render thread and returns once they can be
+ * filled again. Waits for the frame before that to finish first, so there is at most one frame in flight.
+ */
+bool RDevice::SubmitFrame()
+{
+	if(!IsPipeliningFrames()) {
+		LogWarn() << "SubmitFrame called without pipelined frames, use OnFrameEnd instead";
+		return false;
+	}
+
+	std::unique_lock<std::mutex> lock(RenderThreadMutex);
+	RenderThreadCV.wait(lock, [this]() { return !FrameInFlight; });
+
+	// The queues of the last frame are free again, fill those next
+	std::swap(RenderQueue, SubmittedRenderQueue);
+
+	FreeRenderQueues.clear();
+	for(RRenderQueueID i = (RRenderQueueID)RenderQueue.size(); i > 0; i--)
+		if(!RenderQueue[i - 1]->Persistent)
+			FreeRenderQueues.push_back(i - 1);
+
+	// The render thread is done with these
+	CollectRegisteredQueueStats(RenderQueue);
+
+	FrameInFlight = true;
+	FrameDataHandedOff = false;
+	ApplicationFrameCounter++;
+	RenderThreadCV.notify_all();
+
+	// Transient allocations still have to be uploaded from where they were written
+	RenderThreadCV.wait(lock, [this]() { return FrameDataHandedOff; });
+
+	return true;
+}
+
+/**
+ * Blocks until the last submitted frame was presented
+ */
+void RDevice::WaitForSubmittedFrame()
+{
+	std::unique_lock<std::mutex> lock(RenderThreadMutex);
+	RenderThreadCV.wait(lock, [this]() { return !FrameInFlight; });
+}
+
+/**
+ * Draws the submitted frames, owns the API-Context while running
+ */
+void RDevice::RenderThreadFunc()
+{
+	LEB(MakeContextCurrentAPI());
+
+	while(true) {
+		std::unique_lock<std::mutex> lock(RenderThreadMutex);
+		RenderThreadCV.wait(lock, [this]() { return (FrameInFlight && !FrameDataHandedOff) || StopRenderThread; });
+
+		if(StopRenderThread)
+			break;
+
+		lock.unlock();
+
+		HandOffFrameData();
+
+		lock.lock();
+		FrameDataHandedOff = true;
+		lock.unlock();
+		RenderThreadCV.notify_all();
+
+		OnFrameStart();
+		PrepareFrameAPI();
+		FlushRenderQueues(SubmittedRenderQueue);
+		Present();
+
+		lock.lock();
+		FrameInFlight = false;
+		lock.unlock();
+		RenderThreadCV.notify_all();
+	}
+
+	LEB(ReleaseContextAPI());
+}
+
 /**
 * Presents the backbuffer on screen
 */
@@ -155,21 +370,16 @@ bool RDevice::Present()
  */
 bool RDevice::DrawPipelineState(const struct RPipelineState &state)
 {
-	StateMachine.SetFromPipelineState(&state);
+	ContextStateMachine.SetFromPipelineState(&state);
 
 #ifndef PUBLIC_RELEASE
 	// Do some safety checks
-	if(StateMachine.GetCurrentState().VertexBuffers[0]) {
-		size_t bufferSize = StateMachine.GetCurrentState().VertexBuffers[0]->GetSizeInBytes();
-		size_t numBufferElements =
-			bufferSize / StateMachine.GetCurrentState().VertexBuffers[0]->GetStructuredByteSize();
-		assert(numBufferElements >= state.NumDrawElements + state.StartVertexOffset);
-	}
+	CheckVertexBufferBounds(state, ContextStateMachine.GetCurrentState().VertexBuffers[0]);
 #endif
 
-	bool r = DrawPipelineStateAPI(state, StateMachine.GetChanges(), StateMachine);
+	bool r = DrawPipelineStateAPI(state, ContextStateMachine.GetChanges(), ContextStateMachine);
 
-	StateMachine.ResetChanges();
+	ContextStateMachine.ResetChanges();
 
 	return r;
 }
@@ -183,11 +393,25 @@ bool RDevice::DrawPipelineState(const struct RPipelineState &state, const RState
 /**
  * Renders an array of pipeline-states
  */
-bool RDevice::DrawPipelineStates(struct RPipelineState *const *stateArray, unsigned int numStates)
+bool RDevice::DrawPipelineStates(const struct RPipelineState *const *stateArray, unsigned int numStates)
 {
+#ifndef PUBLIC_RELEASE
+	// The backend only looks at the states whose bindings changed, so check them all here
+	for(unsigned int i = 0; i < numStates; i++)
+		CheckVertexBufferBounds(*stateArray[i], REngine::ResourceCache->GetFromID<RBuffer>(stateArray[i]->IDs.VertexBuffer0));
+#endif
+
 	return DrawPipelineStatesAPI(stateArray, numStates);
 }
 
+/**
+ * Gets everything the shaders of the given pipeline-states need ready ahead
+ */
+bool RDevice::PrecompilePrograms(const struct RPipelineState *const *stateArray, unsigned int numStates)
+{
+	return PrecompileProgramsAPI(stateArray, numStates);
+}
+
 /**
  * Returns a list of available display modes
  */
@@ -203,6 +427,23 @@ unsigned int RDevice::GetFrameCounter()
 	return FrameCounter;
 }
 
+/**
+ * Returns how many frames the application has handed to the device. Counts up in OnFrameEnd or
+ * SubmitFrame, so it stays on the frame being built while frames are pipelined.
+ */
+unsigned int RDevice::GetApplicationFrameCounter()
+{
+	return ApplicationFrameCounter;
+}
+
+/**
+ * Returns the draw-context of the calling thread
+ */
+RDrawContext &RDevice::GetThreadDrawContext()
+{
+	return *DrawContexts[REngine::ThreadPool->getCurrentWorkerIndex()];
+}
+
 /**
 * Puts the given pipeline-state into the renderingqueue, which is flushed at the end of the frame
 */
@@ -215,42 +456,120 @@ bool RDevice::QueuePipelineState(const struct RPipelineState *state, RRenderQueu
 	}
 #endif
 
-	QueuedDrawCallCounter++;
-	RenderQueue[queue]->Queue.push_back(state);
+	// Every thread has its own buffer in the queue, so no locking is needed here
+	RRenderQueueAppendBuffer &b = *RenderQueue[queue]->ThreadQueues[REngine::ThreadPool->getCurrentWorkerIndex()];
+	b.Packets.Push(state);
+	b.NumQueued.store((unsigned int)b.Packets.Size(), std::memory_order_relaxed);
 
 	return true;
 }
 
+/**
+ * Moves the states queued by the different threads into the main queue
+ */
+void RDevice::MergeQueuedStates(RRenderQueue &q)
+{
+	// Start with the thread owning the device, so single-threaded queues keep their order
+	size_t numBuffers = q.ThreadQueues.size();
+	for(size_t i = 0; i < numBuffers; i++) {
+		RRenderQueueAppendBuffer &b = *q.ThreadQueues[(i + numBuffers - 1) % numBuffers];
+
+		if(b.Packets.Empty())
+			continue;
+
+		q.Packets.Append(b.Packets);
+		QueuedDrawCallCounter += (unsigned int)b.Packets.Size();
+
+		b.Packets.Clear();
+		b.NumQueued.store(0, std::memory_order_relaxed);
+	}
+}
+
 /**
 * Renders everything in the renderqueue
 */
 bool RDevice::FlushRenderQueue(RRenderQueueID queue)
 {
-	RRenderQueue *q = RenderQueue[queue];
+	bool r = FlushRenderQueue(*RenderQueue[queue]);
+	CollectRegisteredQueueStats(RenderQueue);
+
+	if(!RenderQueue[queue]->Persistent)
+		FreeRenderQueues.push_back(queue);
+
+	return r;
+}
+
+/**
+* Renders everything in the given renderqueue and frees it for the next frame
+*/
+bool RDevice::FlushRenderQueue(RRenderQueue &q)
+{
+	// The threadpool may still be working on this queue
+	bool processing;
+	{
+		std::lock_guard<std::mutex> lock(QueueScheduleMutex);
+		processing = q.ProcessState != RQS_NotProcessed;
+	}
+
+	if(processing)
+		q.ProcessedFuture.wait();
 
-	if(!q->Name.empty())
-		Profiler.StartProfile(q->Name);
+	// Pick up everything that wasn't processed before
+	MergeQueuedStates(q);
+
+	if(ActiveCapture)
+		ActiveCapture->AddQueue(q);
+
+	if(!q.Name.empty())
+		Profiler.StartProfile(q.Name);
+
+	auto startTime = std::chrono::high_resolution_clock::now();
 
 	// Check if we have commandlists to do
-	if(q->QueueCommandLists.empty()) {
-		LEB(FlushQueueImmediate(queue))
+	if(!q.UsesCommandLists) {
+		LEB(FlushQueueImmediate(q))
 	}
 	else {
-		LEB(FlushQueueCmdLists(queue))
+		LEB(FlushQueueCmdLists(q))
+	}
+
+	std::chrono::duration<double, std::milli> flushTime = std::chrono::high_resolution_clock::now() - startTime;
+
+	if(!q.Name.empty())
+		Profiler.EndProfile(q.Name);
+
+	RRenderQueueStats flush;
+	flush.NumDraws = (unsigned int)(q.Packets.Size() * std::max((size_t)1, q.Views.size()));
+	flush.SortTimeMS = q.SortTimeMS;
+	flush.ProcessTimeMS = q.ProcessTimeMS;
+	flush.FlushTimeMS = flushTime.count();
+	q.Stats.AddFlush(flush);
+	q.StatsPending = q.Persistent;
+	q.SortTimeMS = 0.0;
+	q.ProcessTimeMS = 0.0;
+
+	// Registered queues stay in use for the next frame
+	if(!q.Persistent) {
+		QueueCounter--;
+		q.InUse = false;
 	}
 
-	if(!q->Name.empty())
-		Profiler.EndProfile(q->Name);
+	QueuedDrawCallCounter -= (unsigned int)q.Packets.Size();
+	q.UsesCommandLists = false;
+	q.Packets.Clear();
+	q.Changes.clear();
+	q.Views.clear();
 
-	QueueCounter--;
-	QueuedDrawCallCounter -= (unsigned int)RenderQueue[queue]->Queue.size();
-	RenderQueue[queue]->InUse = false;
-	RenderQueue[queue]->Queue.clear();
-	RenderQueue[queue]->Changes.clear();
-	RenderQueue[queue]->QueueCommandLists.clear();
+	{
+		std::lock_guard<std::mutex> lock(QueueScheduleMutex);
+		q.Dependencies.clear();
+		q.Dependents.clear();
+		q.PendingDependencies.clear();
+		q.ProcessState = RQS_NotProcessed;
+	}
 
 #ifndef PUBLIC_RELEASE
-	RenderQueue[queue]->Sources.clear();
+	q.Sources.clear();
 #endif
 
 	return true;
@@ -259,42 +578,71 @@ bool RDevice::FlushRenderQueue(RRenderQueueID queue)
 /**
 * Draws the whole given queue on the main thread
 */
-bool RDevice::FlushQueueImmediate(RRenderQueueID queue)
+bool RDevice::FlushQueueImmediate(RRenderQueue &q)
 {
-	RRenderQueue *q = RenderQueue[queue];
-
 	// Sort the queue, in case it is wanted
-	if(q->SortQueue)
-		std::sort(q->Queue.begin(), q->Queue.end(), RPipelineState::KeyCompareSmall);
+	if(q.SortQueue) {
+		auto startTime = std::chrono::high_resolution_clock::now();
+		q.Packets.Sort();
+
+		std::chrono::duration<double, std::milli> time = std::chrono::high_resolution_clock::now() - startTime;
+		q.SortTimeMS = time.count();
+	}
+
+	// Just draw everything on the immediate context. The backend may put runs of states sharing
+	// all of their bindings into single calls.
+	if(q.Views.empty())
+		return DrawPipelineStates(q.Packets.States.data(), (unsigned int)q.Packets.Size());
+
+	// Once per view. Invalidating makes the first draw bind the overrides.
+	for(const RViewOverrides &view : q.Views) {
+		ContextStateMachine.Invalidate();
+		ContextStateMachine.SetOverrides(&view);
 
-	// Just draw everything on the immediate context
-	for(const RPipelineState *s : q->Queue) {
-		DrawPipelineState(*s);
+		LEB(DrawPipelineStates(q.Packets.States.data(), (unsigned int)q.Packets.Size()));
 	}
 
+	ContextStateMachine.SetOverrides(nullptr);
+	ContextStateMachine.Invalidate();
+
 	return true;
 }
 
 /**
 * Uses the generated commandlists of the given queue and draws them
 */
-bool RDevice::FlushQueueCmdLists(RRenderQueueID queue)
-{
-	if(!RenderQueue[queue]->Queue.empty()) {
-		// Execute the commandlists
-		for(unsigned int i = 0; i < RenderQueue[queue]->QueueCommandLists.size(); i++) {
-			// Wait for the commandlist to be available
-			RenderQueue[queue]->QueueCommandListFutures[i].get();
-
-			// Now execute
-			RCommandList *c = RenderQueue[queue]->QueueCommandLists[i];
-			LEB(c->ExecuteCommandList());
-			REngine::ResourceCache->DeleteResource(c);
+bool RDevice::FlushQueueCmdLists(RRenderQueue &q)
+{
+	if(!q.Packets.Empty()) {
+		size_t numViews = std::max((size_t)1, q.Views.size());
+		size_t listsPerView = q.QueueCommandListFutures.size() / numViews;
+
+		for(size_t v = 0; v < numViews; v++) {
+			// Execute the commandlists of this view. They are kept for the next time this queue is used.
+			for(size_t i = v * listsPerView; i < (v + 1) * listsPerView; i++) {
+				// Wait for the commandlist to be available
+				q.QueueCommandListFutures[i].get();
+
+				// Now execute
+				LEB(q.QueueCommandLists[i]->ExecuteCommandList());
+			}
+
+			// Make sure we are back to default
+			PrepareContextAPI(RTools::GetCurrentThreadId());
+			ContextStateMachine.Invalidate();
+
+			if(!q.Views.empty())
+				ContextStateMachine.SetOverrides(&q.Views[v]);
+
+			// Draw whatever was queued after the queue got processed
+			for(size_t i = q.Changes.size(); i < q.Packets.Size(); i++)
+				DrawPipelineState(*q.Packets.States[i]);
 		}
 
-		// Make sure we are back to default
-		PrepareContextAPI(RTools::GetCurrentThreadId());
-		StateMachine.Invalidate();
+		if(!q.Views.empty()) {
+			ContextStateMachine.SetOverrides(nullptr);
+			ContextStateMachine.Invalidate();
+		}
 	}
 	return true;
 }
@@ -302,64 +650,223 @@ bool RDevice::FlushQueueCmdLists(RRenderQueueID queue)
 /**
  * Registers a renderingqueue in the device. Registration will be cleared every frame, so you have to
  * get one every frame you want to use it */
-unsigned int RDevice::AcquireRenderQueue(bool sortable, const std::string &name)
+unsigned int RDevice::AcquireRenderQueue(bool sortable, const std::string &name, int priority)
 {
 	QueueCounter++;
 
-	for(unsigned int i = 0; i < RenderQueue.size(); i++) {
-		if(!RenderQueue[i]->InUse) {
-			RenderQueue[i]->InUse = true;
-			RenderQueue[i]->SortQueue = sortable;
-			RenderQueue[i]->Name = name;
-			return i;
+	RRenderQueueID id;
+	if(!FreeRenderQueues.empty()) {
+		id = FreeRenderQueues.back();
+		FreeRenderQueues.pop_back();
+	}
+	else {
+		// No free queue, add one
+		id = (RRenderQueueID)RenderQueue.size();
+		RenderQueue.push_back(CreateRenderQueue());
+	}
+
+	RRenderQueue &q = *RenderQueue[id];
+	q.InUse = true;
+	q.SortQueue = sortable;
+	q.Priority = priority;
+	q.Sequence = QueueSequenceCounter++;
+	q.Name = name;
+	q.Stats = RRenderQueueStats();
+
+	return id;
+}
+
+/**
+ * Creates a queue which stays valid until it is unregistered
+ */
+RRenderQueueID RDevice::RegisterRenderQueue(const std::string &name, int priority, bool sortable)
+{
+	// The queue needs the same slot in both sets, so its ID stays valid when they get swapped.
+	// The render thread must be done with its set for that.
+	if(IsPipeliningFrames())
+		WaitForSubmittedFrame();
+
+	while(SubmittedRenderQueue.size() < RenderQueue.size())
+		SubmittedRenderQueue.push_back(CreateRenderQueue());
+
+	while(RenderQueue.size() < SubmittedRenderQueue.size()) {
+		FreeRenderQueues.push_back((RRenderQueueID)RenderQueue.size());
+		RenderQueue.push_back(CreateRenderQueue());
+	}
+
+	RRenderQueueID id = (RRenderQueueID)RenderQueue.size();
+	RenderQueue.push_back(CreateRenderQueue());
+	SubmittedRenderQueue.push_back(CreateRenderQueue());
+
+	RegisteredQueueStats.resize(RenderQueue.size());
+	RegisteredQueueStats[id] = RRenderQueueStats();
+
+	uint64_t sequence = QueueSequenceCounter++;
+	for(RRenderQueue *q : {RenderQueue[id], SubmittedRenderQueue[id]}) {
+		q->InUse = true;
+		q->Persistent = true;
+		q->SortQueue = sortable;
+		q->Priority = priority;
+		q->Sequence = sequence;
+		q->Name = name;
+	}
+
+	QueueCounter++;
+
+	return id;
+}
+
+/**
+ * Frees a queue made by RegisterRenderQueue
+ */
+void RDevice::UnregisterRenderQueue(RRenderQueueID queue)
+{
+	if(IsPipeliningFrames())
+		WaitForSubmittedFrame();
+
+	for(RRenderQueue *q : {RenderQueue[queue], SubmittedRenderQueue[queue]}) {
+		q->InUse = false;
+		q->Persistent = false;
+		q->Stats = RRenderQueueStats();
+		q->StatsPending = false;
+	}
+
+	RegisteredQueueStats[queue] = RRenderQueueStats();
+
+	FreeRenderQueues.push_back(queue);
+	QueueCounter--;
+}
+
+/**
+ * Returns the counts and timings of the given queue
+ */
+const RRenderQueueStats &RDevice::GetRenderQueueStats(RRenderQueueID queue)
+{
+	if(RenderQueue[queue]->Persistent)
+		return RegisteredQueueStats[queue];
+
+	return RenderQueue[queue]->Stats;
+}
+
+/**
+ * Adds the flushes of the registered queues in the given set to the stats of their slots
+ */
+void RDevice::CollectRegisteredQueueStats(std::vector<RRenderQueue *> &queues)
+{
+	for(size_t i = 0; i < queues.size(); i++) {
+		RRenderQueue &q = *queues[i];
+		if(!q.StatsPending)
+			continue;
+
+		RegisteredQueueStats[i].AddFlush(q.Stats);
+		q.StatsPending = false;
+	}
+}
+
+/**
+ * Creates an empty queue with a buffer for every thread which can fill it
+ */
+RRenderQueue *RDevice::CreateRenderQueue()
+{
+	RRenderQueue *q = new RRenderQueue();
+	for(size_t i = 0; i < REngine::ThreadPool->getNumThreads() + 1; i++)
+		q->ThreadQueues.push_back(new RRenderQueueAppendBuffer());
+
+	return q;
+}
+
+/**
+ * Makes the given queue wait for an other one: It will only be processed once the dependency
+ * was processed and gets submitted after it. Must be called before processing the queue.
+ */
+bool RDevice::AddRenderQueueDependency(RRenderQueueID queue, RRenderQueueID dependency)
+{
+#ifndef PUBLIC_RELEASE
+	if(RenderQueue.size() <= queue || !RenderQueue[queue]->InUse
+	   || RenderQueue.size() <= dependency || !RenderQueue[dependency]->InUse) {
+		LogError() << "Renderqueue dependency " << queue << " -> " << dependency << " between unaquired queues";
+		return false;
+	}
+#endif
+
+	if(queue == dependency || DependsOnRenderQueue(dependency, queue)) {
+		LogError() << "Renderqueue dependency " << queue << " -> " << dependency << " would create a cycle!";
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(QueueScheduleMutex);
+	RenderQueue[queue]->Dependencies.push_back(dependency);
+	RenderQueue[dependency]->Dependents.push_back(RenderQueue[queue]);
+
+	return true;
+}
+
+/**
+ * Makes the queue get drawn once for each of the given views. Must be called before processing the queue.
+ */
+bool RDevice::SetRenderQueueViews(RRenderQueueID queue, const RViewOverrides *views, unsigned int numViews)
+{
+	if(RenderQueue.size() <= queue || !RenderQueue[queue]->InUse) {
+		LogError() << "Setting views of unaquired renderqueue " << queue;
+		return false;
+	}
+
+	RRenderQueue &q = *RenderQueue[queue];
+
+	{
+		std::lock_guard<std::mutex> lock(QueueScheduleMutex);
+		if(q.ProcessState != RQS_NotProcessed) {
+			LogError() << "Views of renderqueue " << queue << " set after processing it";
+			return false;
 		}
 	}
 
-	// No free queue, add one
-	RenderQueue.push_back(new RRenderQueue());
+	q.Views.assign(views, views + numViews);
 
-	RenderQueue.back()->InUse = true;
-	RenderQueue.back()->SortQueue = sortable;
-	RenderQueue.back()->Name = name;
+	return true;
+}
+
+/**
+ * Returns true if the given queue depends on the other one, directly or indirectly
+ */
+bool RDevice::DependsOnRenderQueue(RRenderQueueID queue, RRenderQueueID dependency)
+{
+	for(RRenderQueueID d : RenderQueue[queue]->Dependencies) {
+		if(d == dependency || DependsOnRenderQueue(d, dependency))
+			return true;
+	}
 
-	return (unsigned int)(RenderQueue.size() - 1);
+	return false;
 }
 
 /**
- * Fills the "changes"-vector of the given queue with values
+ * Fills the "changes"-vector of the given queue with values and records its commandlists.
+ * This happens on the threadpool as soon as all dependencies of the queue were processed.
  */
 void RDevice::ProcessRenderQueue(RRenderQueueID queue)
 {
 	RRenderQueue &q = *RenderQueue[queue];
 
+	MergeQueuedStates(q);
+
 #ifdef NO_MULTITHREADED_RENDERING
 	return;
 #endif
 
-	if(q.Queue.size() < MIN_STATES_FOR_THREADED_RENDER)
+	if(q.Packets.Size() < MIN_STATES_FOR_THREADED_RENDER)
 		return; // Don't do all this for really simple "immediate"-style queues
 
-	if(!q.QueueCommandLists.empty()) // This should never happen as commandlists should be cleared after flushing!
-		LogWarn() << "Processing queue with non-empty commandlist vector! This could cause memory leaks!";
+	// Every view gets its own set of lists, recorded from the same changes
+	size_t numLists = REngine::ThreadPool->getNumThreads() * std::max((size_t)1, q.Views.size());
 
-	q.QueueCommandLists.resize(REngine::ThreadPool->getNumThreads());
-	q.QueueCommandListFutures.resize(REngine::ThreadPool->getNumThreads());
+	// Lists are only ever added, a queue may be drawn into less views next time
+	if(q.QueueCommandLists.size() < numLists)
+		q.QueueCommandLists.resize(numLists);
 
-#ifndef PUBLIC_RELEASE
-	// Sanity // TODO: Remove, testing only.
-	for(unsigned int i = 0; i < q.Queue.size() - 1; i++) {
-		const RPipelineState *cs = q.Queue[i];
-		const RPipelineState *ns = q.Queue[i + 1];
-		/*if (cs->IDs.MainTexture == ns->IDs.MainTexture
-			&& cs->IDs.VertexBuffer0 == ns->IDs.VertexBuffer0
-			&& cs->StartIndexOffset == ns->StartIndexOffset
-			&& cs->NumDrawElements == ns->NumDrawElements
-			&& memcmp(&cs->Key, &ns->Key, sizeof(RPipelineState::Key)) == 0)
-			__debugbreak();*/
-	}
-#endif
+	q.QueueCommandListFutures.resize(numLists);
+	q.CommandListStats.resize(numLists);
 
-	for(unsigned int i = 0; i < REngine::ThreadPool->getNumThreads(); i++) {
+	for(unsigned int i = 0; i < numLists; i++) {
 		// Make sure we have a commandlist
 		if(!q.QueueCommandLists[i]) {
 			q.QueueCommandLists[i] = REngine::ResourceCache->CreateResource<RCommandList>();
@@ -367,112 +874,233 @@ void RDevice::ProcessRenderQueue(RRenderQueueID queue)
 		}
 	}
 
-	// Make a new task for computing the changes of this queue
-	q.ProcessedFuture = REngine::ThreadPool->enqueue(
-		[this](unsigned int queue1) {
-		RRenderQueue *q1p = RenderQueue[queue1];
-		RRenderQueue &q1 = *q1p;
+	q.UsesCommandLists = true;
+	q.ProcessedPromise = std::promise<void>();
+	q.ProcessedFuture = q.ProcessedPromise.get_future();
+
+	// Only wait for dependencies which are actually processed on the threadpool. The others are drawn
+	// immediately when flushing, which happens in the right order anyways.
+	bool ready;
+	{
+		std::lock_guard<std::mutex> lock(QueueScheduleMutex);
+
+		q.PendingDependencies.clear();
+		for(RRenderQueueID d : q.Dependencies) {
+			ERenderQueueState s = RenderQueue[d]->ProcessState;
+			if(s == RQS_WaitingForDependencies || s == RQS_Processing)
+				q.PendingDependencies.push_back(RenderQueue[d]);
+		}
+
+		ready = q.PendingDependencies.empty();
+		q.ProcessState = ready ? RQS_Processing : RQS_WaitingForDependencies;
+	}
+
+	if(ready) {
+		RRenderQueue *qp = &q;
+		REngine::ThreadPool->enqueue([this, qp]() { ProcessRenderQueueTask(*qp); });
+	}
+}
+
+/**
+ * Task processing a single queue. Starts the processing of waiting dependents when done.
+ */
+void RDevice::ProcessRenderQueueTask(RRenderQueue &q)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	ComputeQueueChanges(q);
+	LEB(PrepareCommandlists(q));
 
-		// Sort the queue if wanted
-		if(q1.SortQueue)
-			std::sort(q1.Queue.begin(), q1.Queue.end(), RPipelineState::KeyCompareSmall);
+	// Recording the commandlists goes on in the background, its time is in the commandlist-stats
+	std::chrono::duration<double, std::milli> time = std::chrono::high_resolution_clock::now() - startTime;
+	q.ProcessTimeMS = time.count();
 
-		// Make sure the changes vector is big enough
-		q1.Changes.resize(q1.Queue.size());
+	// Find the queues which only waited for this one
+	std::vector<RRenderQueue *> readyQueues;
+	{
+		std::lock_guard<std::mutex> lock(QueueScheduleMutex);
 
-		// Make a new state machine, so we don't interfere with other threads
-		RStateMachine sm;
-		sm.Invalidate();
+		q.ProcessState = RQS_Processed;
 
-		// Create changes for each of the states
-		for(unsigned int i = 0; i < q1.Queue.size(); i++) {
-			// Enter our states and get the changes out
-			sm.SetFromPipelineState(q1.Queue[i]);
-			q1.Changes[i] = sm.GetChanges();
+		// The queue-vector itself may be swapped by the application thread meanwhile, so
+		// only go through the queues linked to this one
+		for(RRenderQueue *r : q.Dependents) {
+			if(r->ProcessState != RQS_WaitingForDependencies)
+				continue;
 
-			// Bound everything, reset changes
-			sm.ResetChanges();
+			auto it = std::find(r->PendingDependencies.begin(), r->PendingDependencies.end(), &q);
+			if(it == r->PendingDependencies.end())
+				continue;
+
+			r->PendingDependencies.erase(it);
+			if(r->PendingDependencies.empty()) {
+				r->ProcessState = RQS_Processing;
+				readyQueues.push_back(r);
+			}
 		}
-	}, queue);
+	}
 
-	/*q.ProcessedFuture.wait();
+	for(RRenderQueue *r : readyQueues)
+		REngine::ThreadPool->enqueue([this, r]() { ProcessRenderQueueTask(*r); });
 
-	for (unsigned int i = 0; i < REngine::ThreadPool->getNumThreads(); i++)
-	{
-		q.QueueCommandListFutures[i].wait();
-	}*/
+	q.ProcessedPromise.set_value();
 }
 
 /**
-* Prepares the renderqueues for rendering. Does the actual drawcalls.
-*/
-bool RDevice::PrepareCommandlists(RRenderQueueID queue)
+ * Sorts the queue and computes the changes between its states, in parallel chunks
+ */
+void RDevice::ComputeQueueChanges(RRenderQueue &q1)
 {
-	RRenderQueue &q1 = *RenderQueue[queue];
+	// Sort the queue if wanted
+	if(q1.SortQueue) {
+		auto startTime = std::chrono::high_resolution_clock::now();
+		q1.Packets.Sort();
 
-	if(q1.QueueCommandLists.empty())
-		return true; // No multithreading for this queue
-
-	// Make sure the queue was successfully processed
-	RenderQueue[queue]->ProcessedFuture.get();
+		std::chrono::duration<double, std::milli> time = std::chrono::high_resolution_clock::now() - startTime;
+		q1.SortTimeMS = time.count();
+	}
 
-	if(RenderQueue[queue]->Changes.size() != RenderQueue[queue]->Queue.size()) {
-		// This queue hasn't been processed yet
+	// Make sure the changes vector is big enough
+	q1.Changes.resize(q1.Packets.Size());
+	q1.StateCosts.resize(q1.Packets.Size());
 
-#ifndef PUBLIC_RELEASE
-		LogWarn() <<
-			"Flushing un-processed renderingqueue! This can be a performance-problem and should be done manually!";
-#endif
+	// Every packet is only compared to the one before it, so the chunks don't depend on each other
+	size_t numStates = q1.Packets.Size();
+	size_t chunkSize = std::max((size_t)MIN_STATES_PER_CHANGES_CHUNK,
+								numStates / ((REngine::ThreadPool->getNumThreads() + 1) * THREADPOOL_CHUNKS_PER_THREAD));
 
-		ProcessRenderQueue(queue);
+	REngine::ThreadPool->parallel_for(0, numStates, [&](size_t start, size_t end) {
+		for(size_t i = start; i < end; i++) {
+			q1.Packets.ComputeChanges(i, q1.Changes[i]);
+			q1.StateCosts[i] = EstimateRecordingCost(q1.Changes[i]);
+		}
+	}, chunkSize);
+}
 
-		// Wait for the task to be done..
-		RenderQueue[queue]->ProcessedFuture.get();
-	}
+/**
+* Prepares the renderqueues for rendering. Does the actual drawcalls.
+*/
+bool RDevice::PrepareCommandlists(RRenderQueue &q1)
+{
+	if(!q1.UsesCommandLists)
+		return true; // No multithreading for this queue
 
 	// Threadfunc which draws states from the queue
-	auto threadfunc = [this](unsigned int queue2, unsigned int threadIdx, unsigned int start, unsigned int num) {
-		RRenderQueue &q2 = *RenderQueue[queue2];
-
-		// Make sure we set all states on first drawcall
-		if(num > 0)
-			memset(&q2.Changes[start], 1, sizeof(RStateMachine::ChangesStruct));
+	auto threadfunc = [this](RRenderQueue *q2p, unsigned int listIdx, const RViewOverrides *view,
+							 unsigned int start, unsigned int num) {
+		RRenderQueue &q2 = *q2p;
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		// Make sure we set all states on first drawcall. Every bit of the bitfields has to be set.
+		// The views of the queue share its changes, so this goes into a copy.
+		RStateMachine::ChangesStruct first;
+		memset(&first, 0xFF, sizeof(RStateMachine::ChangesStruct));
+		std::fill(std::begin(first.VertexBuffers), std::end(first.VertexBuffers), true);
+		std::fill(std::begin(first.ConstantBuffers), std::end(first.ConstantBuffers), true);
+		std::fill(std::begin(first.StructuredBuffers), std::end(first.StructuredBuffers), true);
 
 		// Create a new state-machine for this thread
 		RStateMachine stateMachine;
+		stateMachine.SetOverrides(view);
 
 		// Set up the initial states for this context
 		PrepareContextAPI(RTools::GetCurrentThreadId());
 
+		RCommandList *cmdList = q2.QueueCommandLists[listIdx];
 		for(unsigned int i = start; i < start + num; i++) {
-			DrawPipelineState(*q2.Queue[i], q2.Changes[i], stateMachine);
-
-			// TODO: DEBUG-CODE
-			((RPipelineState *)q2.Queue[i])->Locked = false;
+			cmdList->RecordDrawPacket(q2.Packets, i, i == start ? first : q2.Changes[i], stateMachine);
 		}
 
 		// Finalize threads commandlist
-		LEB(q2.QueueCommandLists[threadIdx]->FinalizeCommandList());
+		LEB(cmdList->FinalizeCommandList());
+
+		std::chrono::duration<double, std::milli> time = std::chrono::high_resolution_clock::now() - startTime;
+		q2.CommandListStats[listIdx].RecordingTimeMS = time.count();
 	};
 
-	std::vector<std::future<void>> cmdListFutures;
-	for(unsigned int i = 0; i < REngine::ThreadPool->getNumThreads(); i++) {
-		unsigned int num = ((unsigned int)q1.Queue.size()) / (unsigned int)REngine::ThreadPool->getNumThreads();
-		unsigned int start = num * i;
+	assert(!q1.Packets.Empty());
+
+	uint64_t totalCost = 0;
+	for(unsigned int c : q1.StateCosts)
+		totalCost += c;
+
+	// Cut the queue into slices of about the same cost, rather than the same number of states
+	unsigned int numThreads = (unsigned int)REngine::ThreadPool->getNumThreads();
+	unsigned int numStates = (unsigned int)q1.Packets.Size();
+	unsigned int numViews = std::max(1u, (unsigned int)q1.Views.size());
+	unsigned int start = 0;
+	uint64_t cost = 0;
+	for(unsigned int i = 0; i < numThreads; i++) {
+		uint64_t sliceStartCost = cost;
+		uint64_t targetCost = totalCost * (i + 1) / numThreads;
+		unsigned int end = start;
+
+		// Add all of the remaining work to the last thread
+		if(i + 1 == numThreads) {
+			end = numStates;
+			cost = totalCost;
+		}
+		else {
+			while(end < numStates && cost < targetCost)
+				cost += q1.StateCosts[end++];
+		}
+
+		// Record the same slice for every view
+		for(unsigned int v = 0; v < numViews; v++) {
+			unsigned int listIdx = v * numThreads + i;
+			const RViewOverrides *view = q1.Views.empty() ? nullptr : &q1.Views[v];
 
-		// Add all  of the remaining work to the last thread
-		if(i + 1 == REngine::ThreadPool->getNumThreads())
-			num = ((unsigned int)q1.Queue.size()) - start;
+			q1.CommandListStats[listIdx] = RCommandListStats();
+			q1.CommandListStats[listIdx].NumStates = end - start;
+			q1.CommandListStats[listIdx].EstimatedCost = cost - sliceStartCost;
 
-		assert(!q1.Queue.empty());
+			// Push to threadpool
+			q1.QueueCommandListFutures[listIdx] =
+				std::move(REngine::ThreadPool->enqueue(threadfunc, &q1, listIdx, view, start, end - start));
+		}
 
-		// Push to threadpool
-		q1.QueueCommandListFutures[i] = std::move(REngine::ThreadPool->enqueue(threadfunc, queue, i, start, num));
+		start = end;
 	}
 
 	return true;
 }
 
+/**
+ * Puts the in-use queues into the order they get submitted in. Goes by priority, then by the order
+ * the queues were acquired in, unless a queue has to wait for a dependency.
+ */
+void RDevice::GetSubmissionOrder(const std::vector<RRenderQueue *> &queues, std::vector<RRenderQueueID> &order)
+{
+	std::vector<bool> submitted(queues.size(), false);
+
+	while(true) {
+		// Take the queue coming first by priority, out of those with all of their dependencies submitted
+		bool found = false;
+		RRenderQueueID next = 0;
+		for(RRenderQueueID i = 0; i < queues.size(); i++) {
+			if(!queues[i]->InUse || submitted[i])
+				continue;
+
+			bool ready = true;
+			for(RRenderQueueID d : queues[i]->Dependencies)
+				ready = ready && (submitted[d] || !queues[d]->InUse);
+
+			if(ready && (!found || queues[i]->Priority < queues[next]->Priority
+						 || (queues[i]->Priority == queues[next]->Priority
+							 && queues[i]->Sequence < queues[next]->Sequence))) {
+				next = i;
+				found = true;
+			}
+		}
+
+		if(!found)
+			break;
+
+		order.push_back(next);
+		submitted[next] = true;
+	}
+}
+
 /**
  * Returns the number of queues in use
  */
@@ -486,7 +1114,23 @@ unsigned int RDevice::GetNumQueuesInUse()
  */
 unsigned int RDevice::GetNumRegisteredDrawCalls()
 {
-	return QueuedDrawCallCounter;
+	// Add what the threads have queued, but wasn't merged yet
+	unsigned int num = QueuedDrawCallCounter;
+	for(RRenderQueue *q : RenderQueue) {
+		for(RRenderQueueAppendBuffer *b : q->ThreadQueues)
+			num += b->NumQueued.load(std::memory_order_relaxed);
+	}
+
+	return num;
+}
+
+/**
+ * Returns how recording the commandlists of the given queue went the last time it was processed.
+ * Only valid after the queue was flushed.
+ */
+const std::vector<RCommandListStats> &RDevice::GetCommandListStats(RRenderQueueID queue)
+{
+	return RenderQueue[queue]->CommandListStats;
 }
 
 /**
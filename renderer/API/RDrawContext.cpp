@@ -0,0 +1,56 @@
+#include "pch.h"
+#include "RDrawContext.h"
+#include "REngine.h"
+#include "RResourceCache.h"
+#include "RPipelineState.h"
+
+using namespace RAPI;
+
+// Number of pipeline-states taken from the resource-cache at once
+const unsigned int DRAW_CONTEXT_RESERVE_SIZE = 64;
+
+RDrawContext::RDrawContext()
+{
+}
+
+RDrawContext::~RDrawContext()
+{
+	// Give back what wasn't handed out
+	for(RPipelineState *s : Reserve)
+		REngine::ResourceCache->DeleteResource(s);
+}
+
+/**
+ * Puts the current state back to how a new context starts out
+ */
+void RDrawContext::Reset()
+{
+	State = RPipelineStateFull();
+	Invalidate();
+
+	State.BoundIDs.PrimitiveType = EPrimitiveType::PT_TRIANGLE_LIST;
+}
+
+/**
+ * Takes over the current state of the given state machine
+ */
+void RDrawContext::CopyStateFrom(const RStateMachine &other)
+{
+	State = other.GetCurrentState();
+}
+
+/**
+ * Returns a pipeline-state from the reserve, refilling it first if needed
+ */
+RPipelineState *RDrawContext::AllocatePipelineState()
+{
+	if(Reserve.empty()) {
+		Reserve.resize(DRAW_CONTEXT_RESERVE_SIZE);
+		REngine::ResourceCache->CreateResources(Reserve.data(), DRAW_CONTEXT_RESERVE_SIZE);
+	}
+
+	RPipelineState *s = Reserve.back();
+	Reserve.pop_back();
+
+	return s;
+}
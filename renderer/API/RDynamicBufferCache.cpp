@@ -10,12 +10,41 @@ using namespace RAPI;
 RDynamicBufferCache::RDynamicBufferCache(void)
 {
     Frame = 0;
+
+    TransientRegions.push_back(new RTransientUploadRegion(EBindFlags::B_VERTEXBUFFER, TRANSIENT_REGION_DEFAULT_SIZE));
+    TransientRegions.push_back(new RTransientUploadRegion(EBindFlags::B_INDEXBUFFER, TRANSIENT_REGION_DEFAULT_SIZE));
+    TransientRegions.push_back(new RTransientUploadRegion(EBindFlags::B_CONSTANTBUFFER, TRANSIENT_REGION_DEFAULT_SIZE));
 }
 
 
 RDynamicBufferCache::~RDynamicBufferCache(void)
 {
     // TODO: Free memory!!
+    for (RTransientUploadRegion *r : TransientRegions)
+        delete r;
+}
+
+/** Allocates memory from the transient upload region of the given type */
+RTransientAllocation RDynamicBufferCache::AllocateTransient(EBindFlags bindFlags, unsigned int size,
+                                                            unsigned int alignment)
+{
+    // Every thread gets its own allocator, so only page-switches touch shared memory
+    static thread_local RTransientAllocator allocator;
+
+    for (RTransientUploadRegion *r : TransientRegions)
+    {
+        if (r->GetBindFlags() == bindFlags)
+            return allocator.Allocate(r, size, alignment);
+    }
+
+    return RTransientAllocation();
+}
+
+/** Uploads all transient allocations of this frame */
+void RDynamicBufferCache::FlushTransientAllocations()
+{
+    for (RTransientUploadRegion *r : TransientRegions)
+        r->Flush();
 }
 
 /** Request a dynamic buffer from the stash */
@@ -67,6 +96,10 @@ void RDynamicBufferCache::OnFrameEnded()
 
     // Move the done buffers from this frame to the free ones
     MarkFrameAsFree(Frame);
+
+    // Everything allocated from the transient regions is gone now
+    for (RTransientUploadRegion *r : TransientRegions)
+        r->Reset();
 }
 
 /** Inserts a new buffer into the current frames map */
@@ -44,12 +44,16 @@ namespace RAPI
 /**
  * Initializes these objects 
  */
-	bool REngine::InitializeEngine()
+	bool REngine::InitializeEngine(unsigned int numThreads)
 	{
 		REngine::RenderingDevice = new RDevice();
 		REngine::ResourceCache = new RResourceCache();
 		REngine::DynamicBufferCache = new RDynamicBufferCache();
-		REngine::ThreadPool = new RThreadPool(std::thread::hardware_concurrency() * 2);
+		// Idle workers steal work from the busy ones, so more threads than cores would only fight for them
+		if(!numThreads)
+			numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+		REngine::ThreadPool = new RThreadPool(numThreads);
 
 		return true;
 	}
@@ -0,0 +1,732 @@
+#include "pch.h"
+#include "RFrameCapture.h"
+#include "REngine.h"
+#include "RDevice.h"
+#include "RResourceCache.h"
+#include "RBuffer.h"
+#include "RTexture.h"
+#include "RVertexShader.h"
+#include "RPixelShader.h"
+#include "RInputLayout.h"
+#include "RBlendState.h"
+#include "RRasterizerState.h"
+#include "RDepthStencilState.h"
+#include "RSamplerState.h"
+#include "RViewport.h"
+#include "Logger.h"
+#include <fstream>
+
+using namespace RAPI;
+
+// "RCAP", followed by the version of the format
+const uint32_t RCAPTURE_MAGIC = 0x50414352;
+const uint32_t RCAPTURE_VERSION = 1;
+
+// Flags in the header
+const uint32_t RCAPTURE_FLAG_BUFFER_CONTENTS = 1;
+
+template<typename T>
+static void WriteValue(std::ostream &s, const T &value)
+{
+	s.write((const char *)&value, sizeof(T));
+}
+
+static void WriteString(std::ostream &s, const std::string &str)
+{
+	WriteValue(s, (uint32_t)str.size());
+	s.write(str.data(), str.size());
+}
+
+template<typename T>
+static bool ReadValue(std::istream &s, T &value)
+{
+	s.read((char *)&value, sizeof(T));
+	return s.good();
+}
+
+/**
+ * Returns whether the given number of elements of the given size can still be read from the stream.
+ * Counts come from the file, so they are checked before allocating anything for them.
+ */
+static bool FitsInStream(std::istream &s, uint64_t count, uint64_t elementSize)
+{
+	std::streampos pos = s.tellg();
+	s.seekg(0, std::ios::end);
+	std::streampos end = s.tellg();
+	s.seekg(pos);
+
+	if(pos < 0 || end < pos)
+		return false;
+
+	return count * elementSize <= (uint64_t)(end - pos);
+}
+
+static bool ReadString(std::istream &s, std::string &str)
+{
+	uint32_t size;
+	if(!ReadValue(s, size) || !FitsInStream(s, size, 1))
+		return false;
+
+	str.resize(size);
+	s.read(&str[0], size);
+	return s.good() || (size == 0 && !s.bad());
+}
+
+/**
+ * Stores the ID of the given resource and remembers it for writing its description
+ */
+template<typename T>
+static uint32_t RememberResource(std::map<uint32_t, T *> &resources, T *resource)
+{
+	if(!resource)
+		return RCAPTURE_NO_RESOURCE;
+
+	resources[resource->GetID()] = resource;
+	return resource->GetID();
+}
+
+/**
+ * Returns the object created for the given captured ID, nullptr if there is none
+ */
+template<typename T>
+static T *FindResource(const std::unordered_map<uint32_t, T *> &resources, uint32_t id)
+{
+	auto it = resources.find(id);
+	return it != resources.end() ? (*it).second : nullptr;
+}
+
+/**
+ * Deletes all created objects of a type
+ */
+template<typename T>
+static void DeleteResources(std::unordered_map<uint32_t, T *> &resources)
+{
+	for(auto &r : resources)
+		REngine::ResourceCache->DeleteResource(r.second);
+
+	resources.clear();
+}
+
+static void WriteShader(std::ostream &s, RBaseShader *shader)
+{
+	WriteValue(s, (uint8_t)shader->IsLoadedFromMemory());
+	WriteString(s, shader->GetShaderFile());
+
+	const std::vector<std::vector<std::string>> &definitions = shader->GetDefinitions();
+	WriteValue(s, (uint32_t)definitions.size());
+	for(const std::vector<std::string> &d : definitions) {
+		WriteValue(s, (uint32_t)d.size());
+		for(const std::string &str : d)
+			WriteString(s, str);
+	}
+}
+
+RFrameCapture::RFrameCapture(const std::string &file, bool withBufferContents)
+{
+	File = file;
+	WithBufferContents = withBufferContents;
+}
+
+RFrameCapture::~RFrameCapture()
+{
+}
+
+/**
+ * Adds the states of the given queue. Must be called with the merged and processed queue,
+ * in the order the queues get submitted.
+ */
+void RFrameCapture::AddQueue(const RRenderQueue &queue)
+{
+	Queues.push_back(RCapturedQueue());
+
+	RCapturedQueue &q = Queues.back();
+	q.Name = queue.Name;
+	q.SortQueue = queue.SortQueue;
+	q.States.resize(queue.Packets.Size());
+
+	for(size_t i = 0; i < queue.Packets.Size(); i++)
+		CaptureState(*queue.Packets.States[i], q.States[i]);
+}
+
+/**
+ * Converts a single pipeline-state and remembers the resources it uses
+ */
+void RFrameCapture::CaptureState(const RPipelineState &state, RCapturedState &out)
+{
+	// Resolve the objects the same way the statemachine does when drawing the state
+	RResourceCache *cache = REngine::ResourceCache;
+	const RPipelineState::IDStruct &ids = state.IDs;
+
+	out.PrimitiveType = ids.PrimitiveType;
+	out.DrawFunctionID = ids.DrawFunctionID;
+	out.NumDrawElements = state.NumDrawElements;
+	out.StartVertexOffset = state.StartVertexOffset;
+	out.StartIndexOffset = state.StartIndexOffset;
+	out.StartInstanceOffset = state.StartInstanceOffset;
+	out.NumInstances = state.NumInstances;
+
+	out.VertexShader = RememberResource(VertexShaders, cache->GetFromID<RVertexShader>(ids.VertexShader));
+	out.PixelShader = RememberResource(PixelShaders, cache->GetFromID<RPixelShader>(ids.PixelShader));
+	out.InputLayout = RememberResource(InputLayouts, cache->GetFromID<RInputLayout>(ids.InputLayout));
+	out.BlendState = RememberResource(BlendStates, cache->GetFromID<RBlendState>(ids.BlendState));
+	out.RasterizerState = RememberResource(RasterizerStates, cache->GetFromID<RRasterizerState>(ids.RasterizerState));
+	out.DepthStencilState = RememberResource(DepthStencilStates, cache->GetFromID<RDepthStencilState>(ids.DepthStencilState));
+	out.SamplerState = RememberResource(SamplerStates, cache->GetFromID<RSamplerState>(ids.SamplerState));
+	out.Viewport = RememberResource(Viewports, cache->GetFromID<RViewport>(ids.ViewportID));
+	out.VertexBuffers[0] = RememberResource(Buffers, cache->GetFromID<RBuffer>(ids.VertexBuffer0));
+	out.VertexBuffers[1] = RememberResource(Buffers, cache->GetFromID<RBuffer>(ids.VertexBuffer1));
+	out.IndexBuffer = RememberResource(Buffers, cache->GetFromID<RBuffer>(ids.IndexBuffer));
+
+	// D3D11 needs a shader to create the inputlayout for
+	if(out.InputLayout != RCAPTURE_NO_RESOURCE && out.VertexShader != RCAPTURE_NO_RESOURCE
+	   && InputLayoutShaders.find(out.InputLayout) == InputLayoutShaders.end())
+		InputLayoutShaders[out.InputLayout] = out.VertexShader;
+
+	for(int i = 0; i < EShaderType::ST_NUM_SHADER_TYPES; i++) {
+		for(int j = 0; j < RAPI_MAX_NUM_SHADER_RESOURCES; j++) {
+			out.Textures[i][j] = j < state._NumTextures[i]
+								 ? RememberResource(Textures, state.Textures[i][j]) : RCAPTURE_NO_RESOURCE;
+			out.ConstantBuffers[i][j] = j < state._NumConstantBuffers[i]
+										? RememberResource(Buffers, state.ConstantBuffers[i][j]) : RCAPTURE_NO_RESOURCE;
+			out.StructuredBuffers[i][j] = j < state._NumStructuredBuffers[i]
+										  ? RememberResource(Buffers, state.StructuredBuffers[i][j]) : RCAPTURE_NO_RESOURCE;
+		}
+	}
+}
+
+/**
+ * Writes everything captured so far into the file
+ */
+bool RFrameCapture::WriteToFile()
+{
+	std::ofstream f(File, std::ios::binary);
+	if(!f.is_open()) {
+		LogWarn() << "Failed to open frame-capture file: " << File;
+		return false;
+	}
+
+	// Header. The sizes make sure the replay was built with the same structs.
+	WriteValue(f, RCAPTURE_MAGIC);
+	WriteValue(f, RCAPTURE_VERSION);
+	WriteValue(f, WithBufferContents ? RCAPTURE_FLAG_BUFFER_CONTENTS : 0u);
+	WriteValue(f, (uint32_t)sizeof(RCapturedState));
+	WriteValue(f, (uint32_t)sizeof(RBlendStateInfo));
+	WriteValue(f, (uint32_t)sizeof(RRasterizerStateInfo));
+	WriteValue(f, (uint32_t)sizeof(RDepthStencilStateInfo));
+	WriteValue(f, (uint32_t)sizeof(RSamplerStateInfo));
+	WriteValue(f, (uint32_t)sizeof(ViewportInfo));
+
+	WriteValue(f, (uint32_t)Buffers.size());
+	std::vector<uint8_t> contents;
+	for(auto &b : Buffers) {
+		RBuffer *buffer = b.second;
+		WriteValue(f, b.first);
+		WriteValue(f, (uint32_t)buffer->GetSizeInBytes());
+		WriteValue(f, (uint32_t)buffer->GetStructuredByteSize());
+		WriteValue(f, (uint32_t)buffer->GetBindFlags());
+		WriteValue(f, (uint32_t)buffer->GetUsage());
+		WriteValue(f, (uint32_t)buffer->GetCpuAccess());
+
+		contents.clear();
+		if(WithBufferContents && !buffer->ReadBack(contents))
+			LogWarn() << "Failed to read back buffer " << b.first << " for the frame-capture";
+
+		WriteValue(f, (uint32_t)contents.size());
+		f.write((const char *)contents.data(), contents.size());
+	}
+
+	WriteValue(f, (uint32_t)Textures.size());
+	for(auto &t : Textures) {
+		RTexture *texture = t.second;
+		WriteValue(f, t.first);
+		WriteValue(f, (uint8_t)texture->IsInitialized());
+		WriteValue(f, texture->GetResolution());
+		WriteValue(f, (uint32_t)texture->GetTextureFormat());
+		WriteValue(f, (uint32_t)texture->GetNumMipLevels());
+		WriteValue(f, (uint32_t)texture->GetBindFlags());
+		WriteValue(f, (uint32_t)texture->GetUsageFlags());
+		WriteValue(f, (uint32_t)texture->GetArraySize());
+	}
+
+	WriteValue(f, (uint32_t)VertexShaders.size());
+	for(auto &s : VertexShaders) {
+		WriteValue(f, s.first);
+		WriteShader(f, s.second);
+	}
+
+	WriteValue(f, (uint32_t)PixelShaders.size());
+	for(auto &s : PixelShaders) {
+		WriteValue(f, s.first);
+		WriteShader(f, s.second);
+	}
+
+	WriteValue(f, (uint32_t)InputLayouts.size());
+	for(auto &l : InputLayouts) {
+		auto shader = InputLayoutShaders.find(l.first);
+
+		WriteValue(f, l.first);
+		WriteValue(f, shader != InputLayoutShaders.end() ? (*shader).second : RCAPTURE_NO_RESOURCE);
+		WriteValue(f, (uint32_t)l.second->GetNumInputDescElements());
+
+		const INPUT_ELEMENT_DESC *desc = l.second->GetInputElementDesc();
+		for(unsigned int i = 0; i < l.second->GetNumInputDescElements(); i++) {
+			WriteString(f, desc[i].SemanticName ? desc[i].SemanticName : "");
+			WriteValue(f, (uint32_t)desc[i].SemanticIndex);
+			WriteValue(f, (uint32_t)desc[i].Format);
+			WriteValue(f, (uint32_t)desc[i].InputSlot);
+			WriteValue(f, (uint32_t)desc[i].AlignedByteOffset);
+			WriteValue(f, (uint32_t)desc[i].InputSlotClass);
+			WriteValue(f, (uint32_t)desc[i].InstanceDataStepRate);
+		}
+	}
+
+	// Plain state-descriptions
+	WriteValue(f, (uint32_t)BlendStates.size());
+	for(auto &s : BlendStates) {
+		WriteValue(f, s.first);
+		WriteValue(f, s.second->GetStateInfo());
+	}
+
+	WriteValue(f, (uint32_t)RasterizerStates.size());
+	for(auto &s : RasterizerStates) {
+		WriteValue(f, s.first);
+		WriteValue(f, s.second->GetStateInfo());
+	}
+
+	WriteValue(f, (uint32_t)DepthStencilStates.size());
+	for(auto &s : DepthStencilStates) {
+		WriteValue(f, s.first);
+		WriteValue(f, s.second->GetStateInfo());
+	}
+
+	WriteValue(f, (uint32_t)SamplerStates.size());
+	for(auto &s : SamplerStates) {
+		WriteValue(f, s.first);
+		WriteValue(f, s.second->GetStateInfo());
+	}
+
+	WriteValue(f, (uint32_t)Viewports.size());
+	for(auto &v : Viewports) {
+		WriteValue(f, v.first);
+		WriteValue(f, v.second->GetViewportInfo());
+	}
+
+	// Queues in submission order. Dependencies between them are covered by the order.
+	WriteValue(f, (uint32_t)Queues.size());
+	for(const RCapturedQueue &q : Queues) {
+		WriteString(f, q.Name);
+		WriteValue(f, (uint8_t)q.SortQueue);
+		WriteValue(f, (uint32_t)q.States.size());
+		f.write((const char *)q.States.data(), q.States.size() * sizeof(RCapturedState));
+	}
+
+	if(!f.good()) {
+		LogWarn() << "Failed to write frame-capture file: " << File;
+		return false;
+	}
+
+	LogInfo() << "Captured " << Queues.size() << " queues into " << File;
+
+	return true;
+}
+
+RFrameReplay::RFrameReplay()
+{
+}
+
+RFrameReplay::~RFrameReplay()
+{
+	for(std::vector<RPipelineState *> &states : States) {
+		for(RPipelineState *s : states)
+			REngine::ResourceCache->DeleteResource(s);
+	}
+
+	// Layouts before the shaders they were made for
+	DeleteResources(InputLayouts);
+	DeleteResources(VertexShaders);
+	DeleteResources(PixelShaders);
+	DeleteResources(Buffers);
+	DeleteResources(Textures);
+	DeleteResources(BlendStates);
+	DeleteResources(RasterizerStates);
+	DeleteResources(DepthStencilStates);
+	DeleteResources(SamplerStates);
+	DeleteResources(Viewports);
+}
+
+static bool ReadShader(std::istream &s, bool &fromMemory, std::string &source,
+					   std::vector<std::vector<std::string>> &definitions)
+{
+	uint8_t mem;
+	uint32_t numDefinitions;
+	// Every definition and string starts with its size
+	if(!ReadValue(s, mem) || !ReadString(s, source) || !ReadValue(s, numDefinitions)
+	   || !FitsInStream(s, numDefinitions, sizeof(uint32_t)))
+		return false;
+
+	fromMemory = mem != 0;
+	definitions.resize(numDefinitions);
+	for(std::vector<std::string> &d : definitions) {
+		uint32_t num;
+		if(!ReadValue(s, num) || !FitsInStream(s, num, sizeof(uint32_t)))
+			return false;
+
+		d.resize(num);
+		for(std::string &str : d)
+			if(!ReadString(s, str))
+				return false;
+	}
+
+	return true;
+}
+
+/**
+ * Reads a section of plain state-descriptions
+ */
+template<typename T>
+static bool ReadInfos(std::istream &s, std::map<uint32_t, T> &infos)
+{
+	uint32_t num;
+	if(!ReadValue(s, num))
+		return false;
+
+	for(uint32_t i = 0; i < num; i++) {
+		uint32_t id;
+		T info;
+		if(!ReadValue(s, id) || !ReadValue(s, info))
+			return false;
+
+		infos[id] = info;
+	}
+
+	return true;
+}
+
+/**
+ * Reads the given capture. Returns false if the file is missing, or was written by an incompatible build.
+ */
+bool RFrameReplay::LoadFromFile(const std::string &file)
+{
+	std::ifstream f(file, std::ios::binary);
+	if(!f.is_open()) {
+		LogWarn() << "Failed to open frame-capture file: " << file;
+		return false;
+	}
+
+	uint32_t header[9];
+	if(!ReadValue(f, header))
+		return false;
+
+	if(header[0] != RCAPTURE_MAGIC || header[1] != RCAPTURE_VERSION) {
+		LogWarn() << "Not a frame-capture of this version: " << file;
+		return false;
+	}
+
+	if(header[3] != sizeof(RCapturedState) || header[4] != sizeof(RBlendStateInfo)
+	   || header[5] != sizeof(RRasterizerStateInfo) || header[6] != sizeof(RDepthStencilStateInfo)
+	   || header[7] != sizeof(RSamplerStateInfo) || header[8] != sizeof(ViewportInfo)) {
+		LogWarn() << "Frame-capture was written by an incompatible build: " << file;
+		return false;
+	}
+
+	if(!ReadSections(f)) {
+		LogWarn() << "Frame-capture file is truncated or corrupt: " << file;
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Reads everything following the header
+ */
+bool RFrameReplay::ReadSections(std::istream &f)
+{
+	uint32_t num;
+	if(!ReadValue(f, num))
+		return false;
+
+	for(uint32_t i = 0; i < num; i++) {
+		uint32_t id, size;
+		BufferDesc d;
+		if(!(ReadValue(f, id) && ReadValue(f, d.SizeInBytes) && ReadValue(f, d.StructuredByteSize)
+			 && ReadValue(f, d.BindFlags) && ReadValue(f, d.Usage) && ReadValue(f, d.CpuAccess)
+			 && ReadValue(f, size) && FitsInStream(f, size, 1)))
+			return false;
+
+		d.Contents.resize(size);
+		f.read((char *)d.Contents.data(), size);
+		BufferDescs[id] = std::move(d);
+	}
+
+	if(!ReadValue(f, num))
+		return false;
+
+	for(uint32_t i = 0; i < num; i++) {
+		uint32_t id;
+		uint8_t initialized;
+		TextureDesc d;
+		if(!(ReadValue(f, id) && ReadValue(f, initialized) && ReadValue(f, d.Resolution) && ReadValue(f, d.Format)
+			 && ReadValue(f, d.NumMipLevels) && ReadValue(f, d.BindFlags) && ReadValue(f, d.Usage)
+			 && ReadValue(f, d.ArraySize)))
+			return false;
+
+		d.Initialized = initialized != 0;
+		TextureDescs[id] = d;
+	}
+
+	for(std::map<uint32_t, ShaderDesc> *shaders : {&VertexShaderDescs, &PixelShaderDescs}) {
+		if(!ReadValue(f, num))
+			return false;
+
+		for(uint32_t i = 0; i < num; i++) {
+			uint32_t id;
+			ShaderDesc d;
+			if(!(ReadValue(f, id) && ReadShader(f, d.FromMemory, d.Source, d.Definitions)))
+				return false;
+
+			(*shaders)[id] = std::move(d);
+		}
+	}
+
+	if(!ReadValue(f, num))
+		return false;
+
+	for(uint32_t i = 0; i < num; i++) {
+		uint32_t id, numElements;
+		InputLayoutDesc d;
+		// Each element is its semantic's size and six values at least
+		if(!(ReadValue(f, id) && ReadValue(f, d.TemplateShader) && ReadValue(f, numElements)
+			 && FitsInStream(f, numElements, sizeof(uint32_t) * 7)))
+			return false;
+
+		d.Elements.resize(numElements);
+		d.Semantics.resize(numElements);
+		for(uint32_t j = 0; j < numElements; j++) {
+			uint32_t v[6];
+			if(!(ReadString(f, d.Semantics[j]) && ReadValue(f, v)))
+				return false;
+
+			INPUT_ELEMENT_DESC &e = d.Elements[j];
+			e.SemanticName = nullptr; // Set when creating, the strings may still move
+			e.SemanticIndex = v[0];
+			e.Format = (EFormat)v[1];
+			e.InputSlot = v[2];
+			e.AlignedByteOffset = v[3];
+			e.InputSlotClass = (EInputClassification)v[4];
+			e.InstanceDataStepRate = v[5];
+		}
+
+		InputLayoutDescs[id] = std::move(d);
+	}
+
+	if(!(ReadInfos(f, BlendStateDescs) && ReadInfos(f, RasterizerStateDescs) && ReadInfos(f, DepthStencilStateDescs)
+		 && ReadInfos(f, SamplerStateDescs) && ReadInfos(f, ViewportDescs)))
+		return false;
+
+	// Each queue is at least its name's size, the sort-flag and the number of states
+	if(!ReadValue(f, num) || !FitsInStream(f, num, sizeof(uint32_t) * 2 + sizeof(uint8_t)))
+		return false;
+
+	Queues.resize(num);
+	for(RCapturedQueue &q : Queues) {
+		uint8_t sort;
+		uint32_t numStates;
+		if(!(ReadString(f, q.Name) && ReadValue(f, sort) && ReadValue(f, numStates)
+			 && FitsInStream(f, numStates, sizeof(RCapturedState))))
+			return false;
+
+		q.SortQueue = sort != 0;
+		q.States.resize(numStates);
+		f.read((char *)q.States.data(), numStates * sizeof(RCapturedState));
+	}
+
+	return f.good();
+}
+
+/**
+ * Creates the resources and pipeline-states of the loaded capture. The device must be created.
+ */
+bool RFrameReplay::CreateResources()
+{
+	RResourceCache *cache = REngine::ResourceCache;
+
+	for(auto &d : BufferDescs) {
+		// Buffers which were never initialized can't be created on every API, only keep them for binding
+		RBuffer *b = cache->CreateResource<RBuffer>();
+		Buffers[d.first] = b;
+
+		if(!d.second.SizeInBytes)
+			continue;
+
+		b->Init(d.second.Contents.empty() ? nullptr : d.second.Contents.data(), d.second.SizeInBytes,
+				d.second.StructuredByteSize, (EBindFlags)d.second.BindFlags, (EUsageFlags)d.second.Usage,
+				(ECPUAccessFlags)d.second.CpuAccess);
+	}
+
+	for(auto &d : TextureDescs) {
+		// Still bind textures which never got created, so the state-changes stay the same
+		RTexture *t = cache->CreateResource<RTexture>();
+		if(d.second.Initialized)
+			t->CreateTexture(nullptr, 0, d.second.Resolution, d.second.NumMipLevels, (ETextureFormat)d.second.Format,
+							 (EBindFlags)d.second.BindFlags, (EUsageFlags)d.second.Usage, d.second.ArraySize);
+
+		Textures[d.first] = t;
+	}
+
+	for(auto &d : VertexShaderDescs) {
+		RVertexShader *s = cache->CreateResource<RVertexShader>();
+		if(!d.second.Source.empty()) {
+			if(d.second.FromMemory)
+				s->LoadShaderFromString(d.second.Source, d.second.Definitions);
+			else
+				s->LoadShader(d.second.Source, d.second.Definitions);
+		}
+
+		VertexShaders[d.first] = s;
+	}
+
+	for(auto &d : PixelShaderDescs) {
+		RPixelShader *s = cache->CreateResource<RPixelShader>();
+		if(!d.second.Source.empty()) {
+			if(d.second.FromMemory)
+				s->LoadShaderFromString(d.second.Source, d.second.Definitions);
+			else
+				s->LoadShader(d.second.Source, d.second.Definitions);
+		}
+
+		PixelShaders[d.first] = s;
+	}
+
+	for(auto &d : InputLayoutDescs) {
+		for(size_t i = 0; i < d.second.Elements.size(); i++)
+			d.second.Elements[i].SemanticName = d.second.Semantics[i].c_str();
+
+		RInputLayout *l = cache->CreateResource<RInputLayout>();
+		l->CreateInputLayout(FindResource(VertexShaders, d.second.TemplateShader), d.second.Elements.data(),
+							 (unsigned int)d.second.Elements.size());
+		InputLayouts[d.first] = l;
+	}
+
+	for(auto &d : BlendStateDescs) {
+		RBlendState *s = cache->CreateResource<RBlendState>();
+		s->CreateState(d.second);
+		BlendStates[d.first] = s;
+	}
+
+	for(auto &d : RasterizerStateDescs) {
+		RRasterizerState *s = cache->CreateResource<RRasterizerState>();
+		s->CreateState(d.second);
+		RasterizerStates[d.first] = s;
+	}
+
+	for(auto &d : DepthStencilStateDescs) {
+		RDepthStencilState *s = cache->CreateResource<RDepthStencilState>();
+		s->CreateState(d.second);
+		DepthStencilStates[d.first] = s;
+	}
+
+	for(auto &d : SamplerStateDescs) {
+		RSamplerState *s = cache->CreateResource<RSamplerState>();
+		s->CreateState(d.second);
+		SamplerStates[d.first] = s;
+	}
+
+	for(auto &d : ViewportDescs) {
+		RViewport *v = cache->CreateResource<RViewport>();
+		v->CreateViewport(d.second);
+		Viewports[d.first] = v;
+	}
+
+	States.resize(Queues.size());
+	for(size_t i = 0; i < Queues.size(); i++) {
+		States[i].reserve(Queues[i].States.size());
+		for(const RCapturedState &s : Queues[i].States)
+			States[i].push_back(CreatePipelineState(s));
+
+		// Get the programs linked now, rather than hitching on the first frame
+		REngine::RenderingDevice->PrecompilePrograms(States[i].data(), (unsigned int)States[i].size());
+	}
+
+	return true;
+}
+
+/**
+ * Creates the pipeline-state for a single captured one
+ */
+RPipelineState *RFrameReplay::CreatePipelineState(const RCapturedState &s)
+{
+	// Use an own statemachine, so nothing of this leaks into the one of the device
+	RStateMachine sm;
+	sm.Invalidate();
+
+	if(RVertexShader *vs = FindResource(VertexShaders, s.VertexShader))
+		sm.SetVertexShader(vs);
+
+	if(RPixelShader *ps = FindResource(PixelShaders, s.PixelShader))
+		sm.SetPixelShader(ps);
+
+	if(RBlendState *bs = FindResource(BlendStates, s.BlendState))
+		sm.SetBlendState(bs);
+
+	if(RRasterizerState *rs = FindResource(RasterizerStates, s.RasterizerState))
+		sm.SetRasterizerState(rs);
+
+	if(RDepthStencilState *ds = FindResource(DepthStencilStates, s.DepthStencilState))
+		sm.SetDepthStencilState(ds);
+
+	if(RSamplerState *ss = FindResource(SamplerStates, s.SamplerState))
+		sm.SetSamplerState(ss);
+
+	if(RViewport *vp = FindResource(Viewports, s.Viewport))
+		sm.SetViewport(vp);
+
+	sm.SetInputLayout(FindResource(InputLayouts, s.InputLayout));
+	sm.SetVertexBuffer(0, FindResource(Buffers, s.VertexBuffers[0]));
+	sm.SetVertexBuffer(1, FindResource(Buffers, s.VertexBuffers[1]));
+	sm.SetIndexBuffer(FindResource(Buffers, s.IndexBuffer));
+	sm.SetPrimitiveTopology((EPrimitiveType)s.PrimitiveType);
+
+	for(int i = 0; i < EShaderType::ST_NUM_SHADER_TYPES; i++) {
+		for(unsigned int j = 0; j < RAPI_MAX_NUM_SHADER_RESOURCES; j++) {
+			sm.SetTexture(j, FindResource(Textures, s.Textures[i][j]), (EShaderType)i);
+			sm.SetConstantBuffer(j, FindResource(Buffers, s.ConstantBuffers[i][j]), (EShaderType)i);
+			sm.SetStructuredBuffer(j, FindResource(Buffers, s.StructuredBuffers[i][j]), (EShaderType)i);
+		}
+	}
+
+	RPipelineState *state = sm.MakeDrawCall(s.NumDrawElements, s.StartVertexOffset);
+	state->StartIndexOffset = s.StartIndexOffset;
+	state->StartInstanceOffset = s.StartInstanceOffset;
+	state->NumInstances = s.NumInstances;
+	state->IDs.DrawFunctionID = s.DrawFunctionID;
+
+	return state;
+}
+
+/**
+ * Acquires the captured queues, fills them and processes them. Finish the frame with
+ * OnFrameEnd and Present as usual.
+ */
+void RFrameReplay::QueueFrame()
+{
+	RDevice *device = REngine::RenderingDevice;
+
+	for(size_t i = 0; i < Queues.size(); i++) {
+		RRenderQueueID id = device->AcquireRenderQueue(Queues[i].SortQueue, Queues[i].Name);
+
+		for(RPipelineState *s : States[i])
+			device->QueuePipelineState(s, id);
+
+		device->ProcessRenderQueue(id);
+	}
+}
+
+unsigned int RFrameReplay::GetNumDrawCalls() const
+{
+	unsigned int num = 0;
+	for(const RCapturedQueue &q : Queues)
+		num += (unsigned int)q.States.size();
+
+	return num;
+}
@@ -184,7 +184,7 @@ bool RLineRenderer::AddLine(const LineVertex &v1, const LineVertex &v2)
 /** Flushes the cached lines */
 bool RLineRenderer::Flush(const RMatrix &viewProj)
 {
-	if(LastFrameFlushed == REngine::RenderingDevice->GetFrameCounter()) {
+	if(LastFrameFlushed == REngine::RenderingDevice->GetApplicationFrameCounter()) {
 		LogWarn() << "LineRenderer should only be flushed once per frame!";
 		return false;
 	}
@@ -192,7 +192,7 @@ bool RLineRenderer::Flush(const RMatrix &viewProj)
 	if(LineCache.empty())
 		return true; // No need to do anything
 
-	LastFrameFlushed = REngine::RenderingDevice->GetFrameCounter();
+	LastFrameFlushed = REngine::RenderingDevice->GetApplicationFrameCounter();
 
 	// Initialize, if this is our first flush
 	if(!LineBuffer)
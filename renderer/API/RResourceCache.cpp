@@ -13,8 +13,23 @@ namespace RAPI
 		for (auto it = RegisteredCaches.begin(); it != RegisteredCaches.end(); it++) {
 			std::vector<RResource *> &v = (*it)->Objects;
 
-			for(auto& e : v)
-				delete e;
+			// Freed objects were already destructed, only their memory is left
+			std::vector<bool> freed(v.size(), false);
+			for(unsigned int f : (*it)->FreeMemory)
+				freed[f] = true;
+
+			for(size_t i = 0; i < v.size(); i++) {
+				if(freed[i])
+					::operator delete(v[i]);
+				else
+					delete v[i];
+			}
+
+			// The caches are static, so leave them empty for the next instance
+			v.clear();
+			(*it)->FreeMemory.clear();
+			(*it)->HashCache.clear();
+			(*it)->Registered.store(false);
 		}
 	}
 
@@ -24,6 +24,7 @@ namespace RAPI
 	{
 		memset(&Changes, 0, sizeof(Changes));
 		memset(&ChangesCount, 0, sizeof(ChangesCount));
+		Overrides = nullptr;
 
 		Invalidate();
 
@@ -61,12 +62,12 @@ namespace RAPI
 		}
 
 		if (state->IDs.SamplerState != State.BoundIDs.SamplerState) {
-			State.SamplerState = cache->GetFromID<RSamplerState>(state->IDs.BlendState);
+			State.SamplerState = cache->GetFromID<RSamplerState>(state->IDs.SamplerState);
 			Changes.SamplerState = true;
 			ChangesCount.SamplerState++;
 		}
 		if (state->IDs.DepthStencilState != State.BoundIDs.DepthStencilState) {
-			State.DepthStencilState = cache->GetFromID<RDepthStencilState>(state->IDs.BlendState);
+			State.DepthStencilState = cache->GetFromID<RDepthStencilState>(state->IDs.DepthStencilState);
 			Changes.DepthStencilState = true;
 			ChangesCount.DepthStencilState++;
 		}
@@ -138,6 +139,9 @@ namespace RAPI
 		State.StartVertexOffset = state->StartVertexOffset;
 		State.StartInstanceOffset = state->StartInstanceOffset;
 		State.BoundIDs = state->IDs;
+
+		if (Overrides)
+			ApplyOverrides();
 	}
 
 	void RStateMachine::SetFromPipelineState(const struct RPipelineState *state, const ChangesStruct &changes)
@@ -203,6 +207,24 @@ namespace RAPI
 		State.StartVertexOffset = state->StartVertexOffset;
 		State.StartInstanceOffset = state->StartInstanceOffset;
 		State.BoundIDs = state->IDs;
+
+		if (Overrides)
+			ApplyOverrides();
+	}
+
+/**
+ * Puts the overriding resources into the current state. The bound IDs stay the ones of the state,
+ * so the next state is still compared against what it would have bound.
+ */
+	void RStateMachine::ApplyOverrides()
+	{
+		for (unsigned int i = 0; i < Overrides->NumConstantBuffers; i++) {
+			const RViewOverrides::ConstantBufferOverride &o = Overrides->ConstantBuffers[i];
+			State.ConstantBuffers[o.Stage][o.Slot] = o.Buffer;
+		}
+
+		if (Overrides->Viewport)
+			State.Viewport = Overrides->Viewport;
 	}
 
 /**
@@ -253,6 +275,19 @@ namespace RAPI
 			
 		}
 
+		size_t tablesHash = 0;
+		for (int i = 0; i < EShaderType::ST_NUM_SHADER_TYPES; i++) {
+			RTools::hash_combine(tablesHash, (uint32_t)(state->_NumConstantBuffers[i] | (state->_NumTextures[i] << 8) | (state->_NumStructuredBuffers[i] << 16)));
+			RTools::hash_combine(tablesHash, state->_ConstantBuffersHash[i]);
+			RTools::hash_combine(tablesHash, state->_TexturesHash[i]);
+			RTools::hash_combine(tablesHash, state->_StructuredBuffersHash[i]);
+		}
+
+		state->_ResourceTablesHash = (uint32_t)tablesHash;
+
+		// States get reused by the resource-cache, the device has to look this up again
+		state->_APIProgram = 0;
+
 		state->IDs = State.BoundIDs;
 
 
@@ -315,9 +350,17 @@ namespace RAPI
 		memset(&Changes, 0, sizeof(Changes));
 	}
 
+/**
+ * Returns a new pipeline-state for the MakeDrawCall-functions
+ */
+	RPipelineState *RStateMachine::AllocatePipelineState()
+	{
+		return REngine::ResourceCache->CreateResource<RPipelineState>();
+	}
+
 	RPipelineState *RStateMachine::MakeDrawCall(unsigned int numVertices, unsigned int startVertexOffset)
 	{
-		RPipelineState *s = REngine::ResourceCache->CreateResource<RPipelineState>();
+		RPipelineState *s = AllocatePipelineState();
 		AssignPipelineStateValues(s);
 
 		s->NumDrawElements = numVertices;
@@ -330,7 +373,7 @@ namespace RAPI
 	RPipelineState *RStateMachine::MakeDrawCallIndexed(unsigned int numIndices, unsigned int startIndexOffset,
 													   unsigned int startVertexOffset)
 	{
-		RPipelineState *s = REngine::ResourceCache->CreateResource<RPipelineState>();
+		RPipelineState *s = AllocatePipelineState();
 		AssignPipelineStateValues(s);
 
 		s->NumDrawElements = numIndices;
@@ -347,7 +390,7 @@ namespace RAPI
 																unsigned int startVertexOffset,
 																unsigned int startInstanceOffset)
 	{
-		RPipelineState *s = REngine::ResourceCache->CreateResource<RPipelineState>();
+		RPipelineState *s = AllocatePipelineState();
 		AssignPipelineStateValues(s);
 
 		s->NumDrawElements = numIndices;
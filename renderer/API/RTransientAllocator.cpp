@@ -0,0 +1,147 @@
+#include "pch.h"
+#include "RTransientAllocator.h"
+#include "REngine.h"
+#include "RResourceCache.h"
+#include "RBuffer.h"
+#include "Logger.h"
+
+using namespace RAPI;
+
+RTransientUploadRegion::RTransientUploadRegion(EBindFlags bindFlags, unsigned int capacity)
+{
+	BindFlags = bindFlags;
+	Capacity = capacity;
+	Staging.resize(capacity);
+	Used = 0;
+	Generation = 0;
+	BufferCreated = false;
+
+	// The buffer is only initialized on the first flush, since we may not have an API-Context yet
+	Buffer = REngine::ResourceCache->CreateResource<RBuffer>();
+}
+
+RTransientUploadRegion::~RTransientUploadRegion()
+{
+	// Buffer is owned by the resource-cache
+}
+
+/**
+ * Reserves a range of the given size. Returns false if the region is exhausted. Lock-free.
+ */
+bool RTransientUploadRegion::Reserve(unsigned int size, unsigned int &offsetOut)
+{
+	// Only commit if it fits, so failed attempts can't push the counter around and wrap it
+	unsigned int offset = Used.load(std::memory_order_acquire);
+	do
+	{
+		if((uint64_t)offset + size > Capacity)
+			return false;
+	} while(!Used.compare_exchange_weak(offset, offset + size, std::memory_order_acq_rel, std::memory_order_acquire));
+
+	offsetOut = offset;
+	return true;
+}
+
+/**
+ * Uploads everything written this frame into the GPU-Buffer. Must be called on the main-thread.
+ */
+bool RTransientUploadRegion::Flush()
+{
+	unsigned int used = GetUsedBytes();
+
+	if(!BufferCreated)
+	{
+		LEB_R(Buffer->Init(nullptr, Capacity, 1, BindFlags, EUsageFlags::U_DYNAMIC, ECPUAccessFlags::CA_WRITE,
+			"Transient upload region"));
+
+		BufferCreated = true;
+	}
+
+	if(!used)
+		return true;
+
+	return Buffer->UpdateData(Staging.data(), used);
+}
+
+/**
+ * Starts a new frame. All previously handed out ranges get invalid.
+ */
+void RTransientUploadRegion::Reset()
+{
+	Used.store(0, std::memory_order_release);
+	Generation.fetch_add(1, std::memory_order_acq_rel);
+}
+
+RTransientAllocator::RTransientAllocator()
+{
+}
+
+/**
+ * Returns the page-slot used for the given region
+ */
+RTransientAllocator::Page &RTransientAllocator::GetPageFor(RTransientUploadRegion *region)
+{
+	for(Page &p : Pages)
+	{
+		if(p.Region == region)
+			return p;
+	}
+
+	Page p;
+	p.Region = region;
+	p.Generation = region->GetGeneration() - 1; // Force a fresh page
+	p.Cursor = 0;
+	p.End = 0;
+	Pages.push_back(p);
+
+	return Pages.back();
+}
+
+/**
+ * Allocates memory from the given region. The returned memory may be written until the end of the frame.
+ */
+RTransientAllocation RTransientAllocator::Allocate(RTransientUploadRegion *region, unsigned int size,
+												   unsigned int alignment)
+{
+	RTransientAllocation a;
+	Page &page = GetPageFor(region);
+
+	// No alignment is the same as byte-alignment
+	alignment = std::max(1u, alignment);
+
+	// Drop pages from previous frames
+	unsigned int generation = region->GetGeneration();
+	if(page.Generation != generation)
+	{
+		page.Generation = generation;
+		page.Cursor = 0;
+		page.End = 0;
+	}
+
+	unsigned int start = (page.Cursor + alignment - 1) / alignment * alignment;
+
+	if(start + size > page.End)
+	{
+		// Big allocations get their own range, everything else starts a new page
+		unsigned int reserve = std::max(TRANSIENT_PAGE_SIZE, size + alignment);
+		unsigned int offset;
+		if(!region->Reserve(reserve, offset))
+		{
+			LogWarn() << "Transient upload region exhausted! Requested " << size << " bytes.";
+			return a;
+		}
+
+		page.Cursor = offset;
+		page.End = offset + reserve;
+		start = (page.Cursor + alignment - 1) / alignment * alignment;
+	}
+
+	page.Cursor = start + size;
+
+	a.Data = region->GetStagingData() + start;
+	a.Buffer = region->GetBuffer();
+	a.Offset = start;
+	a.Size = size;
+
+	return a;
+}
@@ -154,6 +154,42 @@ bool RD3D11Buffer::UpdateDataAPI(const void* data, size_t dataSize)
 	return UnmapAPI();
 }
 
+/**
+ * Copies the contents of this buffer into the given memory, which must be GetSizeInBytes() large
+ */
+bool RD3D11Buffer::ReadBackAPI(void* data)
+{
+	HRESULT hr;
+	ID3D11DeviceContext* context = REngine::RenderingDevice->GetThreadContext(GetCurrentThreadId());
+
+	// Default-buffers can't be mapped for reading, go through a staging-copy
+	D3D11_BUFFER_DESC desc;
+	Buffer->GetDesc(&desc);
+	desc.Usage = D3D11_USAGE_STAGING;
+	desc.BindFlags = 0;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	desc.MiscFlags = 0;
+
+	ID3D11Buffer* staging = nullptr;
+	LE(REngine::RenderingDevice->GetDevice()->CreateBuffer(&desc, nullptr, &staging));
+	if(!staging)
+		return false;
+
+	context->CopyResource(staging, Buffer);
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	LE(context->Map(staging, 0, D3D11_MAP_READ, 0, &mapped));
+	if(SUCCEEDED(hr))
+	{
+		memcpy(data, mapped.pData, SizeInBytes);
+		context->Unmap(staging, 0);
+	}
+
+	SafeRelease(staging);
+
+	return SUCCEEDED(hr);
+}
+
 /** Switches to the next buffer in the stash, if we're doing maps on the same frame 
 		Returns true if switched. */
 bool RD3D11Buffer::TrySwitchBuffers()
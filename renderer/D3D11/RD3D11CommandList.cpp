@@ -29,6 +29,14 @@ bool RD3D11CommandList::InitAPI()
 	return true;
 }
 
+/** Records the given packet of a renderqueue into the deferred context of this thread */
+bool RD3D11CommandList::RecordDrawPacketAPI(const RDrawPackets &packets, size_t index,
+											const RStateMachine::ChangesStruct &changes, RStateMachine &stateMachine)
+{
+	// The device picks the deferred context of the calling thread
+	return REngine::RenderingDevice->DrawPipelineState(*packets.States[index], changes, stateMachine);
+}
+
 /** Creates the commandlist and makes it ready to be played back */
 bool RD3D11CommandList::FinalizeCommandListAPI()
 {
@@ -231,6 +231,22 @@ bool RD3D11Device::PrepareContextAPI(unsigned int threadId)
 	return true;
 }
 
+/**
+* Binds the API-Context to the calling thread, or releases it from there.
+* The immediate context is looked up by thread, like the deferred ones.
+*/
+bool RD3D11Device::MakeContextCurrentAPI()
+{
+	ThreadContexts[GetCurrentThreadId()].first = ImmediateContext;
+	return true;
+}
+
+bool RD3D11Device::ReleaseContextAPI()
+{
+	ThreadContexts.erase(GetCurrentThreadId());
+	return true;
+}
+
 bool RD3D11Device::OnFrameEndAPI()
 {
 
@@ -408,11 +424,15 @@ bool RD3D11Device::DrawPipelineStateAPI(const struct RPipelineState& state, cons
 /**
  * Renders an array of pipeline-states
  */
-bool RD3D11Device::DrawPipelineStatesAPI(struct RPipelineState*const* stateArray, unsigned int numStates)
+bool RD3D11Device::DrawPipelineStatesAPI(const struct RPipelineState*const* stateArray, unsigned int numStates)
 {
-	// TODO: Rendering queue
-	/*for(int i=0;i<numStates;i++)
-		DrawPipelineStateAPI(*stateArray[i]);*/
+	// No batching here, D3D11 has no cheap way to issue multiple draws with one call
+	for(unsigned int i=0;i<numStates;i++)
+	{
+		ContextStateMachine.SetFromPipelineState(stateArray[i]);
+		DrawPipelineStateAPI(*stateArray[i], ContextStateMachine.GetChanges(), ContextStateMachine);
+		ContextStateMachine.ResetChanges();
+	}
 
 	return true;
 }
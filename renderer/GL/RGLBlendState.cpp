@@ -4,4 +4,76 @@
 #ifdef RND_GL
 using namespace RAPI;
 
-#endif
\ No newline at end of file
+/**
+ * Converts the D3D11-Style blend-factor
+ */
+static GLenum GetGLBlendFunc(RBlendStateInfo::EBlendFunc func)
+{
+	switch(func)
+	{
+	case RBlendStateInfo::BF_ZERO: return GL_ZERO;
+	case RBlendStateInfo::BF_ONE: return GL_ONE;
+	case RBlendStateInfo::BF_SRC_COLOR: return GL_SRC_COLOR;
+	case RBlendStateInfo::BF_INV_SRC_COLOR: return GL_ONE_MINUS_SRC_COLOR;
+	case RBlendStateInfo::BF_SRC_ALPHA: return GL_SRC_ALPHA;
+	case RBlendStateInfo::BF_INV_SRC_ALPHA: return GL_ONE_MINUS_SRC_ALPHA;
+	case RBlendStateInfo::BF_DEST_ALPHA: return GL_DST_ALPHA;
+	case RBlendStateInfo::BF_INV_DEST_ALPHA: return GL_ONE_MINUS_DST_ALPHA;
+	case RBlendStateInfo::BF_DEST_COLOR: return GL_DST_COLOR;
+	case RBlendStateInfo::BF_INV_DEST_COLOR: return GL_ONE_MINUS_DST_COLOR;
+	case RBlendStateInfo::BF_SRC_ALPHA_SAT: return GL_SRC_ALPHA_SATURATE;
+	case RBlendStateInfo::BF_BLEND_FACTOR: return GL_CONSTANT_COLOR;
+	case RBlendStateInfo::BF_INV_BLEND_FACTOR: return GL_ONE_MINUS_CONSTANT_COLOR;
+	case RBlendStateInfo::BF_SRC1_COLOR: return GL_SRC1_COLOR;
+	case RBlendStateInfo::BF_INV_SRC1_COLOR: return GL_ONE_MINUS_SRC1_COLOR;
+	case RBlendStateInfo::BF_SRC1_ALPHA: return GL_SRC1_ALPHA;
+	case RBlendStateInfo::BF_INV_SRC1_ALPHA: return GL_ONE_MINUS_SRC1_ALPHA;
+	default: return GL_ONE;
+	}
+}
+
+/**
+ * Converts the D3D11-Style blend-operation
+ */
+static GLenum GetGLBlendEquation(RBlendStateInfo::EBlendOp op)
+{
+	switch(op)
+	{
+	case RBlendStateInfo::BO_BLEND_OP_SUBTRACT: return GL_FUNC_SUBTRACT;
+	case RBlendStateInfo::BO_BLEND_OP_REV_SUBTRACT: return GL_FUNC_REVERSE_SUBTRACT;
+	case RBlendStateInfo::BO_BLEND_OP_MIN: return GL_MIN;
+	case RBlendStateInfo::BO_BLEND_OP_MAX: return GL_MAX;
+	case RBlendStateInfo::BO_BLEND_OP_ADD:
+	default: return GL_FUNC_ADD;
+	}
+}
+
+/**
+ * API-Version of CreateState
+ */
+bool RGLBlendState::CreateStateAPI()
+{
+	Record = MakeRecord(StateInfo);
+	return true;
+}
+
+/**
+ * Converts the given stateinfo to GL-Values
+ */
+RGLBlendRecord RGLBlendState::MakeRecord(const RBlendStateInfo &info)
+{
+	RGLBlendRecord r;
+	r.Enabled = info.BlendEnabled ? GL_TRUE : GL_FALSE;
+	r.AlphaToCoverage = info.AlphaToCoverage ? GL_TRUE : GL_FALSE;
+	r.ColorWrites = info.ColorWritesEnabled ? GL_TRUE : GL_FALSE;
+	r.SrcRGB = GetGLBlendFunc(info.SrcBlend);
+	r.DstRGB = GetGLBlendFunc(info.DestBlend);
+	r.EquationRGB = GetGLBlendEquation(info.BlendOp);
+	r.SrcAlpha = GetGLBlendFunc(info.SrcBlendAlpha);
+	r.DstAlpha = GetGLBlendFunc(info.DestBlendAlpha);
+	r.EquationAlpha = GetGLBlendEquation(info.BlendOpAlpha);
+
+	return r;
+}
+
+#endif
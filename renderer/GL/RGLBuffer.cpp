@@ -10,13 +10,32 @@ using namespace RAPI;
 
 #ifdef RND_GL
 
-const bool USE_DOUBLEBUFFERING = true;
+// Regions are placed at multiples of this, which satisfies the alignment of uniformbuffer-offsets on common hardware
+const GLintptr DYNAMIC_BUFFER_REGION_ALIGNMENT = 256;
+
+/**
+ * Rounds the given size up to a multiple of the region-alignment
+ */
+static GLsizeiptr AlignRegionSize(size_t size)
+{
+	GLintptr alignment = std::max(DYNAMIC_BUFFER_REGION_ALIGNMENT, (GLintptr)REngine::RenderingDevice->GetLimits().UniformBufferOffsetAlignment);
+	return (GLsizeiptr)((size + alignment - 1) / alignment * alignment);
+}
+
+/**
+ * Returns true if buffers are edited without binding them
+ */
+static bool UseDirectStateAccess()
+{
+	return REngine::RenderingDevice->GetLimits().DirectStateAccess;
+}
 
 RAPI::RGLBuffer::RGLBuffer()
 {
 	VertexBufferObject = 0;
-	VertexArrayObject = 0;
-	StashBufferRotation = 0;
+	BindOffset = 0;
+	CurrentRegion = 0;
+	RegionSize = 0;
 }
 
 RAPI::RGLBuffer::~RGLBuffer()
@@ -25,30 +44,45 @@ RAPI::RGLBuffer::~RGLBuffer()
 }
 
 /**
-* Creates the vertexbuffer with the given arguments
+* Creates the vertexbuffer with the given arguments. Dynamic buffers get persistently mapped storage, which
+* is written through the pointer returned by MapAPI without any further GL-Calls.
 */
 bool RGLBuffer::CreateBufferAPI(const void *initData)
 {
-	unsigned int buffersToCreate = 1;
+	if(Usage == EUsageFlags::U_DYNAMIC && GLEW_ARB_buffer_storage)
+	{
+		RegionSize = AlignRegionSize(SizeInBytes);
+		if(!AddStorage())
+			return false;
 
-	// Make more buffers if this is supposed to be dynamic
-	if((Usage & EUsageFlags::U_DYNAMIC) != 0 && USE_DOUBLEBUFFERING)
-		buffersToCreate = NUM_BUFFERSTASH_FRAME_STORAGES;
+		SetCurrentRegion(0);
 
-	for(unsigned int i = 0; i < buffersToCreate; i++)
-	{
-		glGenBuffers(1, &VertexBufferObject);
-		CheckGlError();
+		if(initData)
+			memcpy(Regions[0].Mapped, initData, SizeInBytes);
 
-		glBindBuffer(BindFlags, VertexBufferObject);
-		CheckGlError();
+		return true;
+	}
 
-		// Apply initial data and set size
-		glBufferData(BindFlags, SizeInBytes, initData, Usage);
+	if(UseDirectStateAccess())
+	{
+		glCreateBuffers(1, &VertexBufferObject);
+		glNamedBufferData(VertexBufferObject, SizeInBytes, initData, Usage);
 		CheckGlError();
 
-		BufferStash[i].first = VertexBufferObject;
+		return true;
 	}
+
+	glGenBuffers(1, &VertexBufferObject);
+	CheckGlError();
+
+	// Don't use the actual target, binding an indexbuffer would change the current VAO
+	REngine::RenderingDevice->GetStateCache().BindBuffer(GL_COPY_WRITE_BUFFER, VertexBufferObject);
+	CheckGlError();
+
+	// Apply initial data and set size
+	glBufferData(GL_COPY_WRITE_BUFFER, SizeInBytes, initData, Usage);
+	CheckGlError();
+
 	return true;
 }
 
@@ -57,14 +91,28 @@ bool RGLBuffer::CreateBufferAPI(const void *initData)
 */
 bool RGLBuffer::MapAPI(void **dataOut)
 {
-	// Switch buffers if needed to avoid cpu stall
-	TrySwitchBuffers();
+	if(IsPersistentlyMapped())
+	{
+		// Already mapped, only need a region the GPU doesn't read anymore
+		if(!SwitchRegion())
+			return false;
 
-	// Get buffer pointer
-	glBindBuffer (BindFlags, VertexBufferObject);
-	//void* ptr = glMapBuffer(BindFlags, GL_WRITE_ONLY);
+		*dataOut = Regions[CurrentRegion].Mapped;
+		return true;
+	}
 
-	void* ptr = glMapBufferRange(BindFlags, 0, SizeInBytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	// Get buffer pointer
+	const GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
+	void* ptr;
+	if(UseDirectStateAccess())
+	{
+		ptr = glMapNamedBufferRange(VertexBufferObject, 0, SizeInBytes, access);
+	}
+	else
+	{
+		REngine::RenderingDevice->GetStateCache().BindBuffer(GL_COPY_WRITE_BUFFER, VertexBufferObject);
+		ptr = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, SizeInBytes, access);
+	}
 
 	CheckGlError();
 
@@ -81,9 +129,20 @@ bool RGLBuffer::MapAPI(void **dataOut)
 */
 bool RGLBuffer::UnmapAPI()
 {
+	// Coherent storage, the writes are visible to the GPU without doing anything
+	if(IsPersistentlyMapped())
+		return true;
+
 	// Unmap our buffer again
-	glBindBuffer (BindFlags, VertexBufferObject);
-	glUnmapBuffer(BindFlags);
+	if(UseDirectStateAccess())
+	{
+		glUnmapNamedBuffer(VertexBufferObject);
+	}
+	else
+	{
+		REngine::RenderingDevice->GetStateCache().BindBuffer(GL_COPY_WRITE_BUFFER, VertexBufferObject);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+	}
 
 	CheckGlError();
 
@@ -98,17 +157,52 @@ bool RGLBuffer::UpdateDataAPI(const void *data, size_t dataSize)
 {
 	if(dataSize != 0 && dataSize > GetSizeInBytes())
 	{
-		// Buffer too small for requested size, resize.
-		DeallocateAPI();
+		if(IsPersistentlyMapped())
+		{
+			// Regions have room left, the next one can simply take more data
+			if((GLsizeiptr)dataSize <= RegionSize)
+			{
+				SizeInBytes = (unsigned int)dataSize;
+			}
+			else
+			{
+				// Chain storage with room to grow further, so this doesn't happen on every update.
+				// The old storage can go right away, GL keeps it alive until the draws using it are done.
+				DeleteRegions();
+
+				SizeInBytes = (unsigned int)dataSize;
+				RegionSize = AlignRegionSize(dataSize + dataSize / 2);
+				if(!AddStorage())
+					return false;
+
+				SetCurrentRegion(0);
+				memcpy(Regions[0].Mapped, data, dataSize);
+
+				REngine::RenderingDevice->OnBufferRegionChangedGL((RBuffer*)this);
+				return true;
+			}
+		}
+		else
+		{
+			// Buffer too small for requested size, resize.
+			DeallocateAPI();
 
-		// Just set the new size and keep the old settings
-		SizeInBytes = (unsigned int)dataSize;
+			// Just set the new size and keep the old settings
+			SizeInBytes = (unsigned int)dataSize;
 
-		// Create buffer and immediately set the data
-		return CreateBufferAPI(data);
+			// Create buffer and immediately set the data
+			return CreateBufferAPI(data);
+		}
 	}
 
 	// Buffer is large enough, simply copy the data
+	if(!IsPersistentlyMapped() && UseDirectStateAccess())
+	{
+		glNamedBufferSubData(VertexBufferObject, 0, dataSize != 0 ? dataSize : GetSizeInBytes(), data);
+		CheckGlError();
+		return true;
+	}
+
 	void* mappedData;
 	if(!MapAPI(&mappedData))
 		return false;
@@ -118,123 +212,185 @@ bool RGLBuffer::UpdateDataAPI(const void *data, size_t dataSize)
 	return UnmapAPI();
 }
 
+/**
+ * Copies the contents of this buffer into the given memory, which must be GetSizeInBytes() large
+ */
+bool RGLBuffer::ReadBackAPI(void *data)
+{
+	if(UseDirectStateAccess())
+	{
+		glGetNamedBufferSubData(VertexBufferObject, BindOffset, SizeInBytes, data);
+	}
+	else
+	{
+		REngine::RenderingDevice->GetStateCache().BindBuffer(GL_COPY_READ_BUFFER, VertexBufferObject);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, BindOffset, SizeInBytes, data);
+	}
+
+	CheckGlError();
+
+	return true;
+}
+
 /**
 * Deletes all resources this holds but keeps the object around.
 * Recreate the buffer by calling Init
 */
 void RGLBuffer::DeallocateAPI()
 {
-	// Clear our VBO
-	glDeleteBuffers(1, &VertexBufferObject);
-	CheckGlError();
+	if(IsPersistentlyMapped())
+	{
+		DeleteRegions();
+		return;
+	}
+
+	// Clear our VBO, VAOs using it go with it
+	if(VertexBufferObject)
+	{
+		glDeleteBuffers(1, &VertexBufferObject);
+		CheckGlError();
+
+		OnBufferObjectDeleted(VertexBufferObject);
+	}
 
 	VertexBufferObject = 0;
 }
 
 /**
-* Updates the VAO-Info of this buffer, if this is used as a vertexbuffer 
+* Tells the caches of the device that the given buffer object is gone
 */
-void RGLBuffer::UpdateVAO(const RInputLayout* inputLayout, RBuffer* instanceBuffer)
+void RGLBuffer::OnBufferObjectDeleted(GLuint buffer)
 {
-	// Already initialized?
-	if(VertexArrayObject || BindFlags != GL_ARRAY_BUFFER)
-		return;
+	if(REngine::RenderingDevice)
+		REngine::RenderingDevice->OnBufferObjectDeletedGL(buffer);
+}
+
+/**
+* Creates storage for NUM_DYNAMIC_BUFFER_REGIONS more regions and puts them into the chain after
+* the current one
+*/
+bool RGLBuffer::AddStorage()
+{
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	GLsizeiptr size = RegionSize * NUM_DYNAMIC_BUFFER_REGIONS;
 
-	// Get input element desc
-	const INPUT_ELEMENT_DESC* desc = inputLayout->GetInputElementDesc();
+	GLuint buffer;
+	uint8_t* mapped;
+	if(UseDirectStateAccess())
+	{
+		glCreateBuffers(1, &buffer);
+		glNamedBufferStorage(buffer, size, nullptr, flags);
+		mapped = (uint8_t*)glMapNamedBufferRange(buffer, 0, size, flags);
+	}
+	else
+	{
+		glGenBuffers(1, &buffer);
+
+		RGLStateCache& stateCache = REngine::RenderingDevice->GetStateCache();
+		stateCache.BindBuffer(GL_COPY_WRITE_BUFFER, buffer);
 
-	// Create VAO
-	glGenVertexArrays(1, &VertexArrayObject);
+		glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+		mapped = (uint8_t*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+	}
 	CheckGlError();
 
-	glBindVertexArray(VertexArrayObject);
-	
-	size_t structuredByteSize = StructuredByteSize;
-	size_t offset = 0;
-	for(unsigned int i = 0; i < inputLayout->GetNumInputDescElements(); i++)
+	if(!mapped)
 	{
-		const INPUT_ELEMENT_DESC& d = desc[i];
-		
-		glEnableVertexAttribArray(i);
-		CheckGlError();
+		LogWarn() << "Failed to persistently map buffer of size " << size;
+
+		glDeleteBuffers(1, &buffer);
+		OnBufferObjectDeleted(buffer);
+		return false;
+	}
+
+	unsigned int insertAt = Regions.empty() ? 0 : CurrentRegion + 1;
+	for(unsigned int i = 0; i < NUM_DYNAMIC_BUFFER_REGIONS; i++)
+	{
+		RGLBufferRegion r = {};
+		r.Buffer = buffer;
+		r.Offset = RegionSize * i;
+		r.Mapped = mapped + r.Offset;
+
+		Regions.insert(Regions.begin() + insertAt + i, r);
+	}
+
+	return true;
+}
+
+/**
+* Moves on to a region the GPU is done with. Chains new storage if the next one was used by one of the
+* last frames the CPU may be ahead by, only waits for the GPU on regions older than that.
+*/
+bool RGLBuffer::SwitchRegion()
+{
+	unsigned int frame = REngine::RenderingDevice->GetFrameCounter();
 
-		// Bind main vertex-buffer or instance buffer depending on the slot
-		// TODO: Allow for multiple buffers
-		if(d.InputSlot == 0)
+	// Draws of this frame may still read what we are leaving
+	Regions[CurrentRegion].LastFrameUsed = frame;
+	Regions[CurrentRegion].Used = true;
+
+	unsigned int next = (CurrentRegion + 1) % Regions.size();
+	if(Regions[next].Used)
+	{
+		if(Regions[next].LastFrameUsed + GL_NUM_FRAME_FENCES > frame)
 		{
-			glBindBuffer(GL_ARRAY_BUFFER, VertexBufferObject);
+			// The GPU may still be working on that frame, and waiting for it would throw away the time the CPU
+			// is ahead. Mapped more often than we have regions, so get more.
+			if(!AddStorage())
+				return false;
+
+			next = CurrentRegion + 1;
 		}
 		else
 		{
-			glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer->GetBufferObjectAPI());
-			StructuredByteSize = instanceBuffer->GetStructuredByteSize();
+			// The device already waited for frames this far behind before starting the current one,
+			// so this doesn't block
+			REngine::RenderingDevice->WaitForFrameGL(Regions[next].LastFrameUsed);
 		}
+	}
 
-		// Restart offset in case we are at a new buffer
-		if(i > 0 && offset != 0 && d.InputSlot != 0 && desc[i-1].InputSlot == 0)
-			offset = 0;
-
-		// Use instancing if we got a slot more than 1
-		// FIXME: Need to give an option for these for multiple vertex buffers...
-		glVertexAttribDivisor(i, d.InputSlot > 0 ? 1 : 0);
+	SetCurrentRegion(next);
 
-		// Unpack the formats
-		switch(d.Format)
-		{
-		case FORMAT_R32G32B32A32_FLOAT:
-			glVertexAttribPointer(i, 4, GL_FLOAT, GL_FALSE, StructuredByteSize, (void*)offset);
-			offset += sizeof(float) * 4;
-			break;
-
-		case FORMAT_R32G32B32_FLOAT:
-			glVertexAttribPointer(i, 3, GL_FLOAT, GL_FALSE, StructuredByteSize, (void*)offset);
-			offset += sizeof(float) * 3;
-			break;
-
-		case FORMAT_R32G32_FLOAT:
-			glVertexAttribPointer(i, 2, GL_FLOAT, GL_FALSE, StructuredByteSize, (void*)offset);
-			offset += sizeof(float) * 2;
-			break;
-
-		case FORMAT_R8G8B8A8_UNORM:
-			glVertexAttribPointer(i, 4, GL_UNSIGNED_BYTE, GL_TRUE, StructuredByteSize, (void*)offset);
-			offset += sizeof(uint32_t);
-			break;
-
-		default:
-			LogWarnBox() << "Unknown INPUT_ELEMENT_DESC-Format: " << d.Format;
-			return;
-		}
+	REngine::RenderingDevice->OnBufferRegionChangedGL((RBuffer*)this);
+	return true;
+}
 
-		CheckGlError();
-		
-	}
+/**
+* Makes the given region the current one
+*/
+void RGLBuffer::SetCurrentRegion(unsigned int region)
+{
+	CurrentRegion = region;
 
-	BufferStash[StashBufferRotation].second = VertexArrayObject;
+	const RGLBufferRegion& r = Regions[CurrentRegion];
+	VertexBufferObject = r.Buffer;
+	BindOffset = r.Offset;
 }
 
-/** Switches to the next buffer in the stash, if we're doing maps on the same frame 
-Returns true if switched. */
-bool RGLBuffer::TrySwitchBuffers()
+/**
+* Deletes the storage of the region chain
+*/
+void RGLBuffer::DeleteRegions()
 {
-	// Only on dynamic buffers
-	if((Usage & EUsageFlags::U_DYNAMIC) == 0 || !USE_DOUBLEBUFFERING)
-		return false;
-
-	unsigned int frame = REngine::RenderingDevice->GetFrameCounter();
+	std::vector<GLuint> storages;
+	for(const RGLBufferRegion& r : Regions)
+	{
+		if(std::find(storages.begin(), storages.end(), r.Buffer) == storages.end())
+			storages.push_back(r.Buffer);
+	}
 
-	// Check if we were updated on the current or last frame
-	if(LastFrameUpdated == frame || LastFrameUpdated + 1 == frame)
+	// Deleting the storage unmaps it as well
+	for(GLuint buffer : storages)
 	{
-		// We were, do the switch!
-		StashBufferRotation = (StashBufferRotation + 1) % NUM_BUFFERSTASH_FRAME_STORAGES;
-		VertexBufferObject = BufferStash[StashBufferRotation].first;
-		VertexArrayObject = BufferStash[StashBufferRotation].second;
-		return true;
+		glDeleteBuffers(1, &buffer);
+		OnBufferObjectDeleted(buffer);
 	}
 
-	LastFrameUpdated = frame;
+	CheckGlError();
 
-	return false;
+	Regions.clear();
+	CurrentRegion = 0;
+	VertexBufferObject = 0;
+	BindOffset = 0;
 }
 #endif
\ No newline at end of file
@@ -2,6 +2,25 @@
 #include "RGLCommandList.h"
 
 #ifdef RND_GL
+#include "REngine.h"
+#include "RDevice.h"
+
 using namespace RAPI;
 
-#endif
\ No newline at end of file
+/** Records the given packet of a renderqueue into this commandlist */
+bool RGLCommandList::RecordDrawPacketAPI(const RDrawPackets &packets, size_t index,
+										 const RStateMachine::ChangesStruct &changes, RStateMachine &stateMachine)
+{
+	Commands.RecordDrawPacket(packets, index, changes, stateMachine);
+	return true;
+}
+
+/** Plays the generated commandlist back on the main-thread */
+bool RGLCommandList::ExecuteCommandListAPI()
+{
+	bool r = REngine::RenderingDevice->ReplayCommandBuffer(Commands);
+	Commands.Reset();
+
+	return r;
+}
+#endif
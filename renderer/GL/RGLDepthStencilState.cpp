@@ -4,4 +4,45 @@
 #ifdef RND_GL
 using namespace RAPI;
 
-#endif
\ No newline at end of file
+/**
+ * Converts the D3D11-Style comparison-function
+ */
+static GLenum GetGLCompareFunc(RDepthStencilStateInfo::ECompareFunc func)
+{
+	switch(func)
+	{
+	case RDepthStencilStateInfo::CF_COMPARISON_NEVER: return GL_NEVER;
+	case RDepthStencilStateInfo::CF_COMPARISON_LESS: return GL_LESS;
+	case RDepthStencilStateInfo::CF_COMPARISON_EQUAL: return GL_EQUAL;
+	case RDepthStencilStateInfo::CF_COMPARISON_GREATER: return GL_GREATER;
+	case RDepthStencilStateInfo::CF_COMPARISON_NOT_EQUAL: return GL_NOTEQUAL;
+	case RDepthStencilStateInfo::CF_COMPARISON_GREATER_EQUAL: return GL_GEQUAL;
+	case RDepthStencilStateInfo::CF_COMPARISON_ALWAYS: return GL_ALWAYS;
+	case RDepthStencilStateInfo::CF_COMPARISON_LESS_EQUAL:
+	default: return GL_LEQUAL;
+	}
+}
+
+/**
+ * API-Version of CreateState
+ */
+bool RGLDepthStencilState::CreateStateAPI()
+{
+	Record = MakeRecord(StateInfo);
+	return true;
+}
+
+/**
+ * Converts the given stateinfo to GL-Values
+ */
+RGLDepthStencilRecord RGLDepthStencilState::MakeRecord(const RDepthStencilStateInfo &info)
+{
+	RGLDepthStencilRecord r;
+	r.DepthTest = info.DepthBufferEnabled ? GL_TRUE : GL_FALSE;
+	r.DepthWrites = info.DepthWriteEnabled ? GL_TRUE : GL_FALSE;
+	r.DepthFunc = GetGLCompareFunc(info.DepthBufferCompareFunc);
+
+	return r;
+}
+
+#endif
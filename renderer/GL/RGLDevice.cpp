@@ -7,10 +7,93 @@
 #include "RPixelShader.h"
 #include "RVertexShader.h"
 #include "RTexture.h"
+#include "RViewport.h"
+#include "RSamplerState.h"
+#include "RBlendState.h"
+#include "RRasterizerState.h"
+#include "RDepthStencilState.h"
+#include "REngine.h"
+#include "RResourceCache.h"
 
 #ifdef RND_GL
 using namespace RAPI;
 
+/**
+* Layouts of the indirect commands, as GL expects them. Array-draws are put into slots of the size of
+* the indexed ones, so both can share the buffer.
+*/
+struct GLDrawElementsIndirectCommand
+{
+	GLuint Count;
+	GLuint InstanceCount;
+	GLuint FirstIndex;
+	GLint BaseVertex;
+	GLuint BaseInstance;
+};
+
+struct GLDrawArraysIndirectCommand
+{
+	GLuint Count;
+	GLuint InstanceCount;
+	GLuint First;
+	GLuint BaseInstance;
+};
+
+/**
+* Returns true if both states can be drawn without binding anything in between
+*/
+static bool HasSameBindings(const RPipelineState& a, const RPipelineState& b)
+{
+	if(memcmp(&a.Key, &b.Key, sizeof(a.Key)) != 0 || a._ResourceTablesHash != b._ResourceTablesHash)
+		return false;
+
+	for(int i = 0; i < EShaderType::ST_NUM_SHADER_TYPES; i++)
+	{
+		if(a.Textures[i] != b.Textures[i] || a.ConstantBuffers[i] != b.ConstantBuffers[i] || a.StructuredBuffers[i] != b.StructuredBuffers[i])
+			return false;
+	}
+
+	return true;
+}
+
+RGLDevice::RGLDevice()
+{
+	BoundVertexBuffers[0] = nullptr;
+	BoundVertexBuffers[1] = nullptr;
+	BoundInputLayout = nullptr;
+	BoundIndexBuffer = nullptr;
+	VertexArrayDirty = true;
+	BoundConstantBuffers.fill(nullptr);
+
+	for(int i = 0; i < GL_NUM_FRAME_FENCES; i++)
+	{
+		FrameFences[i] = nullptr;
+		FenceFrames[i] = 0;
+	}
+
+	IndirectBuffer = 0;
+	IndirectMapped = nullptr;
+	IndirectFrame = 0;
+	IndirectUsed = 0;
+
+	ProgramCacheFile = GL_DEFAULT_PROGRAM_CACHE_FILE;
+}
+
+RGLDevice::~RGLDevice()
+{
+	VertexArrayCache.Clear();
+	TextureUploader.Clear();
+
+	for(int i = 0; i < GL_NUM_FRAME_FENCES; i++)
+	{
+		if(FrameFences[i])
+			glDeleteSync(FrameFences[i]);
+	}
+
+	if(IndirectBuffer)
+		glDeleteBuffers(1, &IndirectBuffer);
+}
+
 bool RGLDevice::CreateDeviceAPI()
 {
     return true;
@@ -22,11 +105,6 @@ bool RGLDevice::SetWindowAPI()
 	glfwMakeContextCurrent(OutputWindow);
 	CheckGlError();
 
-    // Init first viewport
-    RInt2 windowSize = GetWindowResolutionAPI(OutputWindow);
-    glViewport(0, 0, windowSize.x, windowSize.y);
-	CheckGlError();
-
     glClearColor(0.0f, 0.5f, 0.5f,0.0f);
 	CheckGlError();
 
@@ -52,28 +130,65 @@ bool RGLDevice::SetWindowAPI()
 		LogError() << "GL_ARB_explicit_uniform_location not supported!";
 	}
 
+	// Query the limits once, rather than whenever they are needed
+	glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &Limits.MaxTextureUnits);
+	glGetIntegerv(GL_MAX_UNIFORM_BUFFER_BINDINGS, &Limits.MaxUniformBufferBindings);
+	glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &Limits.MaxVertexAttribs);
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &Limits.UniformBufferOffsetAlignment);
+
+	if(GLEW_EXT_texture_filter_anisotropic)
+		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &Limits.MaxAnisotropy);
+
+	// Editing resources won't disturb the bindings of the draws then. Binding them is kept as fallback.
+	Limits.DirectStateAccess = GLEW_ARB_direct_state_access != GL_FALSE;
+
+	CheckGlError();
+
+	StateCache.Init(Limits);
+
+	// Stream texel-data through a persistently mapped ring, rather than having the driver copy it right away
+	TextureUploader.Init();
+
+	// Let the driver compile on as many threads as it likes, shaders only get waited on when linking
+	if(GLEW_ARB_parallel_shader_compile)
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+
+	// Binaries are only valid for the driver which made them
+	if(GLEW_ARB_get_program_binary)
+	{
+		std::string driver = std::string((const char*)glGetString(GL_VENDOR)) + "|" + (const char*)renderer + "|" + (const char*)version;
+		ProgramCache.Open(ProgramCacheFile, driver);
+	}
+
+	// Init first viewport
+	RInt2 windowSize = GetWindowResolutionAPI(OutputWindow);
+	StateCache.Viewport(0, 0, windowSize.x, windowSize.y);
+	CheckGlError();
+
 
     return true;
 }
 
 bool RGLDevice::OnResizeAPI()
 {
-	glViewport(0, 0, OutputResolution.x, OutputResolution.y);
+	StateCache.Viewport(0, 0, OutputResolution.x, OutputResolution.y);
     return true;
 }
 
 bool RGLDevice::OnFrameStartAPI()
 {
-    glClearColor(0.0f, 0.5f, 1.0f,0.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	StateCache.OnFrameStart();
 
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LESS);
-	
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK);
+	// Marks the textures whose uploads finished as ready
+	TextureUploader.Update();
+
+	// Clearing respects the write-masks. The states of the first draw are applied again anyways,
+	// since the statemachine is invalidated at frame start.
+	StateCache.ColorMask(GL_TRUE);
+	StateCache.DepthMask(GL_TRUE);
 
-	glFrontFace(GL_CCW);
+    glClearColor(0.0f, 0.5f, 1.0f,0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     return true;
 }
 
@@ -89,10 +204,71 @@ bool RGLDevice::OnFrameEndAPI()
 
 bool RGLDevice::PresentAPI()
 {
+	// Fence the frame, so dynamic buffers know when the GPU is done with the regions written on it.
+	// Reusing a fence waits for its frame, which keeps the CPU from getting too far ahead.
+	int slot = FrameCounter % GL_NUM_FRAME_FENCES;
+	if(FrameFences[slot])
+		WaitForFrameGL(FenceFrames[slot]);
+
+	FrameFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	FenceFrames[slot] = FrameCounter;
+
 	glfwSwapBuffers(OutputWindow);
     return true;
 }
 
+/**
+* Blocks until the GPU is done with the given frame. Frames which weren't presented yet can't be waited on.
+*/
+void RGLDevice::WaitForFrameGL(unsigned int frame)
+{
+	int slot = frame % GL_NUM_FRAME_FENCES;
+
+	// No fence for it anymore means it was waited on already
+	if(!FrameFences[slot] || FenceFrames[slot] != frame)
+		return;
+
+	GLenum r;
+	do
+	{
+		r = glClientWaitSync(FrameFences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+	} while(r == GL_TIMEOUT_EXPIRED);
+
+	if(r == GL_WAIT_FAILED)
+		LogWarn() << "Waiting for frame " << frame << " failed";
+
+	glDeleteSync(FrameFences[slot]);
+	FrameFences[slot] = nullptr;
+}
+
+/**
+* Called by dynamic buffers when their data moved to another region. Rebinds them, if currently bound.
+*/
+void RGLDevice::OnBufferRegionChangedGL(RBuffer* buffer)
+{
+	// The VAO of the new data is picked on the next draw
+	if(buffer == BoundVertexBuffers[0] || buffer == BoundVertexBuffers[1] || buffer == BoundIndexBuffer)
+		VertexArrayDirty = true;
+
+	for(unsigned int j = 0; j < BoundConstantBuffers.size(); j++)
+	{
+		if(buffer == BoundConstantBuffers[j])
+			StateCache.BindBufferRange(GL_UNIFORM_BUFFER, j, buffer->GetBufferObjectAPI(), buffer->GetBindOffsetAPI(), buffer->GetSizeInBytes());
+	}
+}
+
+/**
+* Called by buffers after deleting one of their buffer objects. Drops everything still using it.
+*/
+void RGLDevice::OnBufferObjectDeletedGL(GLuint buffer)
+{
+	StateCache.OnBufferDeleted(buffer);
+	VertexArrayCache.OnBufferDeleted(buffer);
+
+	// Could have deleted the VAO currently bound
+	VertexArrayDirty = true;
+}
+
 /**
 * Binds the resources of the given pipeline state
 */
@@ -106,201 +282,526 @@ bool RGLDevice::BindPipelineState(const RPipelineState& _state, const RStateMach
 
 	stateMachine.SetFromPipelineState(&state, changes);
 	const RPipelineStateFull& fs = stateMachine.GetCurrentState();
+	
+	if(changes.RasterizerState)
+		BindRasterizerStateGL(fs.RasterizerState);
+
+	if(changes.BlendState)
+		BindBlendStateGL(fs.BlendState);
+
+	if(changes.DepthStencilState)
+		BindDepthStencilStateGL(fs.DepthStencilState);
+
+	if(changes.SamplerState)
+		BindSamplerStateGL(fs.SamplerState);
+
+	if(changes.VertexBuffers[0] || changes.VertexBuffers[1] || changes.InputLayout)
+		BindVertexBuffersGL(fs.VertexBuffers[0], fs.VertexBuffers[1], fs.InputLayout);
+
+	if(changes.IndexBuffer)
+		BindIndexBufferGL(fs.IndexBuffer);
+
+	BindVertexArrayGL();
+
+	BindShadersGL(state, fs.VertexShader, fs.PixelShader);
+
+	if(changes.MainTexture)
+		BindTexturesGL(EShaderType::ST_PIXEL, fs.Textures[EShaderType::ST_PIXEL]);
+
+	if(changes.ConstantBuffers[EShaderType::ST_VERTEX])
+		BindConstantBuffersGL(EShaderType::ST_VERTEX, fs.ConstantBuffers[EShaderType::ST_VERTEX]);
+
+	//if(changes.StructuredBuffers[EShaderType::ST_VERTEX])
+	//{
+	//	for(unsigned int j=0;j<fs.StructuredBuffers[EShaderType::ST_VERTEX].size();j++)
+	//	{
+	//		if(fs.StructuredBuffers[EShaderType::ST_VERTEX][j])
+	//		{
+	//			context->VSSetShaderResources(j, 1, fs.StructuredBuffers[EShaderType::ST_VERTEX][j]->GetBufferSRVPtr());
+	//		}
+	//	}
+	//}
+
+	if(changes.Viewport)
+		BindViewportGL(fs.Viewport);
+
+	return true;
+}
+
+/**
+* Sets the given viewport. GL counts from the bottom of the window, the viewports from the top.
+*/
+void RGLDevice::BindViewportGL(RViewport* viewport)
+{
+	if(!viewport)
+		return;
+
+	const ViewportInfo& vp = viewport->GetViewportInfo();
+	StateCache.Viewport((GLint)vp.TopLeftX, (GLint)(OutputResolution.y - vp.TopLeftY - vp.Height), (GLsizei)vp.Width, (GLsizei)vp.Height);
+	StateCache.DepthRange(vp.MinZ, vp.MaxZ);
+}
+
+/**
+* Applies the given states. Fields matching the current GL-State are skipped by the state cache.
+* Without a state bound, the defaults of the stateinfos are used.
+*/
+void RGLDevice::BindRasterizerStateGL(RRasterizerState* rasterizerState)
+{
+	static const RGLRasterizerRecord defaultRecord = RGLRasterizerState::MakeRecord(RRasterizerStateInfo());
+	StateCache.ApplyRasterizerState(rasterizerState ? rasterizerState->GetRecordAPI() : defaultRecord);
+}
+
+void RGLDevice::BindBlendStateGL(RBlendState* blendState)
+{
+	static const RGLBlendRecord defaultRecord = RGLBlendState::MakeRecord(RBlendStateInfo());
+	StateCache.ApplyBlendState(blendState ? blendState->GetRecordAPI() : defaultRecord);
+}
+
+void RGLDevice::BindDepthStencilStateGL(RDepthStencilState* depthStencilState)
+{
+	static const RGLDepthStencilRecord defaultRecord = RGLDepthStencilState::MakeRecord(RDepthStencilStateInfo());
+	StateCache.ApplyDepthStencilState(depthStencilState ? depthStencilState->GetRecordAPI() : defaultRecord);
+}
+
+/**
+* Binds the sampler-object of the given state to all units the textures go to
+*/
+void RGLDevice::BindSamplerStateGL(RSamplerState* samplerState)
+{
+	if(!samplerState)
+		return;
+
+	GLuint sampler = samplerState->GetSamplerObjectAPI();
+	for(GLuint i = 0; i < RAPI_MAX_NUM_SHADER_RESOURCES; i++)
+		StateCache.BindSampler(i, sampler);
+}
+
+/**
+* Sets the given vertexbuffers. Their VAO is bound before the next draw.
+*/
+void RGLDevice::BindVertexBuffersGL(RBuffer* vertexBuffer0, RBuffer* vertexBuffer1, RInputLayout* inputLayout)
+{
+	BoundVertexBuffers[0] = vertexBuffer0;
+	BoundVertexBuffers[1] = vertexBuffer1;
+	BoundInputLayout = inputLayout;
+	VertexArrayDirty = true;
+}
+
+/**
+* Sets the given indexbuffer. It is part of the VAO, which is bound before the next draw.
+*/
+void RGLDevice::BindIndexBufferGL(RBuffer* indexBuffer)
+{
+	BoundIndexBuffer = indexBuffer;
+	VertexArrayDirty = true;
+}
+
+/**
+* Binds the VAO of the last set vertexbuffers, layout and indexbuffer, if they changed
+*/
+void RGLDevice::BindVertexArrayGL()
+{
+	if(!VertexArrayDirty)
+		return;
+
+	VertexArrayCache.BindVertexArray(BoundInputLayout, BoundVertexBuffers[0], BoundVertexBuffers[1], BoundIndexBuffer);
+	VertexArrayDirty = false;
+	CheckGlError();
+}
+
+/**
+* Binds the program of the given state's shaders. Looking it up is only done once per state,
+* after that it's only compared.
+*/
+void RGLDevice::BindShadersGL(RPipelineState& state, RVertexShader* vertexShader, RPixelShader* pixelShader)
+{
+	if(!state._APIProgram)
+		state._APIProgram = LinkShadersGL(vertexShader, pixelShader);
+
+	if(state._APIProgram)
+		StateCache.UseProgram(state._APIProgram);
+}
+
+/**
+* Links the given shaders or gets a program from cache. Returns 0 without a vertexshader.
+*/
+GLuint RGLDevice::LinkShadersGL(RVertexShader* vertexShader, RPixelShader* pixelShader)
+{
 	std::array<RGLShader*, EShaderType::ST_NUM_SHADER_TYPES> shaders;
 	shaders.fill(0);
-	
-	//if(changes.RasterizerState && fs.RasterizerState)
-	//	context->RSSetState(fs.RasterizerState->GetState());
 
-	//if(changes.BlendState && fs.BlendState)
-	//	context->OMSetBlendState(fs.BlendState->GetState(), (float *)&RFloat4(0.0f,0.0f,0.0f,0.0f), 0xFFFFFFFF);
+	shaders[EShaderType::ST_PIXEL] = pixelShader;
+	shaders[EShaderType::ST_VERTEX] = vertexShader;
 
-	//if(changes.DepthStencilState && fs.DepthStencilState)
-	//	context->OMSetDepthStencilState(fs.DepthStencilState->GetState(), 0);
+	if(!shaders[0])
+		return 0;
 
-	if(changes.SamplerState && fs.SamplerState)
-	{
-		// TODO: Create actual sampler state object
-		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT ); 
-		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT );
-		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR ); 
-
-		GLfloat aniso = 0.0f;
-		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &aniso);
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, aniso); 
-	}
+	GLuint shaderProgram = shaders[0]->LinkShaderObjectAPI(shaders.data(), EShaderType::ST_NUM_SHADER_TYPES);
+	CheckGlError();
 
-	
-	if(changes.VertexBuffers[0])
+	return shaderProgram;
+}
+
+/**
+* Binds the textures of the given shader stage
+*/
+void RGLDevice::BindTexturesGL(EShaderType stage, const std::array<RTexture*, RAPI_MAX_NUM_SHADER_RESOURCES>& textures)
+{
+	// TODO: Do this for all shader stages
+	// TODO: Structured buffers use the same registers as textures. A change of them will
+	// not affect the changed state of the textures.
+	if(stage != EShaderType::ST_PIXEL)
+		return;
+
+	for(unsigned int i = 0; i < textures.size(); i++)
 	{
-		if(fs.VertexBuffers[0])
+		GLuint tx = textures[i] ? 
+			textures[i]->GetTextureObjectAPI()
+			: GL_INVALID_INDEX;
+
+		// Sampling-parameters are set when the texture is created
+		if(tx != GL_INVALID_INDEX)
 		{
-			// Need to update the VAO of this to get the vertexlayout into the buffer
-			GLuint vao = fs.VertexBuffers[0]->GetVertexArrayObjectAPI();
+			StateCache.BindTexture(i, tx);
+			CheckGlError();
+		}
+	}
+}
 
-			// Create vao, if needed
-			if(!vao)
-			{
-				fs.VertexBuffers[0]->UpdateVAO(fs.InputLayout, fs.VertexBuffers[1]);
-				vao = fs.VertexBuffers[0]->GetVertexArrayObjectAPI();
-			}
+/**
+* Binds the constantbuffers of the given shader stage
+*/
+void RGLDevice::BindConstantBuffersGL(EShaderType stage, const std::array<RBuffer*, RAPI_MAX_NUM_SHADER_RESOURCES>& buffers)
+{
+	// TODO: Pixelshader-buffers need their own binding points, they currently share them with the vertexshader
+	if(stage != EShaderType::ST_VERTEX)
+		return;
 
-			glBindVertexArray(fs.VertexBuffers[0]->GetVertexArrayObjectAPI());
+	BoundConstantBuffers = buffers;
+
+	for(unsigned int j=0;j<buffers.size();j++)
+	{
+		if(buffers[j])
+		{
+			// Dynamic buffers only use a region of their buffer object
+			GLuint ubo = buffers[j]->GetBufferObjectAPI();
+			StateCache.BindBufferRange(GL_UNIFORM_BUFFER, j, ubo, buffers[j]->GetBindOffsetAPI(), buffers[j]->GetSizeInBytes());
+			
 			CheckGlError();
 		}
 	}
+}
 
+/**
+* Issues the drawcall described by the given parameters
+*/
+void RGLDevice::DrawGL(const RCmdDraw& draw)
+{
+	// Indices of dynamic buffers don't start at the beginning of the buffer object
+	GLintptr indexOffset = BoundIndexBuffer ? BoundIndexBuffer->GetBindOffsetAPI() : 0;
 
-	if(changes.IndexBuffer && fs.IndexBuffer)
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, fs.IndexBuffer->GetBufferObjectAPI());
+	switch(draw.DrawFunctionID)
+	{
+	case EDrawCallType::DCT_Draw:
+		glDrawArrays(draw.PrimitiveType, draw.StartVertexOffset, draw.NumDrawElements);
+		break;
+
+	case EDrawCallType::DCT_DrawIndexed:
+		glDrawElements(draw.PrimitiveType, draw.NumDrawElements, GL_UNSIGNED_INT, (void*)(indexOffset + draw.StartIndexOffset * sizeof(uint32_t))); // TODO: Support GL_UNSIGNED_SHORT
+		break;
+
+	case EDrawCallType::DCT_DrawIndexedInstanced:
+		glDrawElementsInstancedBaseInstance(draw.PrimitiveType, draw.NumDrawElements, GL_UNSIGNED_INT, (void*)(indexOffset + draw.StartIndexOffset * sizeof(uint32_t)), draw.NumInstances, draw.StartInstanceOffset);
+		//glDrawElementsInstanced(state.IDs.PrimitiveType, state.NumInstances, GL_UNSIGNED_INT, 0, state.NumDrawElements);
+		//context->DrawIndexedInstanced(state.NumDrawElements, state.NumInstances, state.StartIndexOffset, state.StartVertexOffset, state.StartInstanceOffset);
+		break;
+	}
 
-	/*if(changes.PixelShader && fs.PixelShader)
-		shaders.push_back(fs.PixelShader);
+	CheckGlError();
+}
 
-	if(changes.VertexShader && fs.VertexShader)
-		shaders.push_back(fs.VertexShader);*/
+bool RGLDevice::DrawPipelineStateAPI(const struct RPipelineState &state,
+                                     const RStateMachine::ChangesStruct &changes, RStateMachine &stateMachine)
+{
+	// Bind everything
+	if(DoDrawcalls)
+	{
+		BindPipelineState(state, changes, stateMachine);
+		CheckGlError();
 
-	if(fs.PixelShader)
-		shaders[EShaderType::ST_PIXEL] = fs.PixelShader;
+		// Perform drawcall
+		DrawGL(RCmdDraw::FromPipelineState(state));
+	}
+    return true;
+}
 
-	if(fs.VertexShader)
-		shaders[EShaderType::ST_VERTEX] = fs.VertexShader;
+/**
+* Links the programs of the given pipeline-states, or loads them from the program cache
+*/
+bool RGLDevice::PrecompileProgramsAPI(const struct RPipelineState *const *stateArray, unsigned int numStates)
+{
+	RResourceCache* cache = REngine::ResourceCache;
 
-	// Link shaders/get a program from cache
-	GLuint shaderProgram = 0;
-	if(!shaders.empty())
+	for(unsigned int i = 0; i < numStates; i++)
 	{
-		shaderProgram = shaders[0]->LinkShaderObjectAPI(shaders.data(), EShaderType::ST_NUM_SHADER_TYPES);
-		glUseProgram(shaderProgram);
-		CheckGlError();
+		RPipelineState& state = (RPipelineState&)*stateArray[i];
+		if(state._APIProgram)
+			continue;
+
+		state._APIProgram = LinkShadersGL(cache->GetFromID<RVertexShader>(state.IDs.VertexShader),
+			cache->GetFromID<RPixelShader>(state.IDs.PixelShader));
 	}
 
-	// TODO: Do this for all shader stages
-	// TODO: Structured buffers use the same registers as textures. A change of them will
-	// not affect the changed state of the textures.
-	if(changes.MainTexture)
+	return true;
+}
+
+/**
+* Walks through a commandbuffer recorded on a worker-thread and does the actual GL-Calls.
+* Must be called from the thread owning the GL-Context.
+*/
+bool RGLDevice::ReplayCommandBuffer(const RCommandBuffer& commands)
+{
+	if(!DoDrawcalls)
+		return true;
+
+	for(const RCommandHeader* cmd = commands.Begin(); cmd != commands.End(); cmd = RCommandBuffer::Next(cmd))
 	{
-		for(unsigned int i = 0; i < fs.Textures[EShaderType::ST_PIXEL].size(); i++)
-		{
-			GLuint tx = fs.Textures[EShaderType::ST_PIXEL][i] ? 
-				fs.Textures[EShaderType::ST_PIXEL][i]->GetTextureObjectAPI()
-				: GL_INVALID_INDEX;
+		// Draws following each other directly share all bindings and are collected
+		if(cmd->Op != CO_Draw)
+			FlushDrawsGL();
 
-			if(tx != GL_INVALID_INDEX)
-			{
-				glActiveTexture(GL_TEXTURE0 + i);
-				glBindTexture(GL_TEXTURE_2D, tx);
+		switch(cmd->Op)
+		{
+		case CO_SetRasterizerState:
+			BindRasterizerStateGL((RRasterizerState*)RCommandBuffer::GetPayload<RCmdSetObject>(cmd).Object);
+			break;
 
-				GLuint maxMip = std::max(1u, fs.Textures[EShaderType::ST_PIXEL][i]->GetNumMipLevels()) - 1;
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, maxMip); 
+		case CO_SetBlendState:
+			BindBlendStateGL((RBlendState*)RCommandBuffer::GetPayload<RCmdSetObject>(cmd).Object);
+			break;
 
-				glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT ); 
-				glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT );
-				glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-				glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR ); 
+		case CO_SetDepthStencilState:
+			BindDepthStencilStateGL((RDepthStencilState*)RCommandBuffer::GetPayload<RCmdSetObject>(cmd).Object);
+			break;
 
-				GLfloat aniso = 0.0f;
-				glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &aniso);
-				glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, aniso / 2); 
+		case CO_SetSamplerState:
+			BindSamplerStateGL((RSamplerState*)RCommandBuffer::GetPayload<RCmdSetObject>(cmd).Object);
+			break;
 
-				CheckGlError();
+		case CO_SetVertexBuffers:
+			{
+				const RCmdSetVertexBuffers& vb = RCommandBuffer::GetPayload<RCmdSetVertexBuffers>(cmd);
+				BindVertexBuffersGL(vb.VertexBuffers[0], vb.VertexBuffers[1], vb.InputLayout);
 			}
-		}
-	}
+			break;
 
+		case CO_SetIndexBuffer:
+			BindIndexBufferGL((RBuffer*)RCommandBuffer::GetPayload<RCmdSetObject>(cmd).Object);
+			break;
 
-	if(changes.ConstantBuffers[EShaderType::ST_VERTEX])
-	{
-		for(unsigned int j=0;j<fs.ConstantBuffers[EShaderType::ST_VERTEX].size();j++)
-		{
-			if(fs.VertexShader && fs.ConstantBuffers[EShaderType::ST_VERTEX][j])
+		case CO_SetShaders:
 			{
-				GLuint ubo = fs.ConstantBuffers[EShaderType::ST_VERTEX][j]->GetBufferObjectAPI();
-				glBindBufferBase(GL_UNIFORM_BUFFER, j, ubo);
-				
-				CheckGlError();
+				const RCmdSetShaders& s = RCommandBuffer::GetPayload<RCmdSetShaders>(cmd);
+				BindShadersGL(*s.State, s.VertexShader, s.PixelShader);
 			}
+			break;
+
+		case CO_SetTextures:
+			BindTexturesGL((EShaderType)cmd->Stage, RCommandBuffer::GetPayload<RCmdSetTextures>(cmd).Textures);
+			break;
+
+		case CO_SetConstantBuffers:
+			BindConstantBuffersGL((EShaderType)cmd->Stage, RCommandBuffer::GetPayload<RCmdSetBuffers>(cmd).Buffers);
+			break;
+
+		case CO_SetViewport:
+			BindViewportGL((RViewport*)RCommandBuffer::GetPayload<RCmdSetObject>(cmd).Object);
+			break;
+
+		case CO_Draw:
+			QueueDrawGL(RCommandBuffer::GetPayload<RCmdDraw>(cmd));
+			break;
+
+		default:
+			// Structured buffers aren't done for GL yet
+			break;
 		}
 	}
 
-	/*if(changes.ConstantBuffers[EShaderType::ST_PIXEL])
+	FlushDrawsGL();
+
+	return true;
+}
+
+/**
+* Renders an array of pipeline-states. Runs of states sharing all of their bindings are only bound once
+* and drawn with a single multi-draw-indirect call, if they are long enough.
+*/
+bool RGLDevice::DrawPipelineStatesAPI(const struct RPipelineState *const *stateArray, unsigned int numStates)
+{
+	for(unsigned int i = 0; i < numStates; i++)
 	{
-		for(unsigned int j=0;j<fs.ConstantBuffers[EShaderType::ST_PIXEL].size();j++)
+		const RPipelineState& state = *stateArray[i];
+
+		if(i == 0 || !HasSameBindings(state, *stateArray[i - 1]))
 		{
-			if(fs.PixelShader && fs.ConstantBuffers[EShaderType::ST_PIXEL][j])
-			{
-				// TODO: Cache the call from LinkShaderObjectAPI above somewhere
-				GLuint ubo = fs.ConstantBuffers[EShaderType::ST_PIXEL][j]->GetBufferObjectAPI();
-				glBindBuffer(GL_UNIFORM_BUFFER, ubo);
-				glBindBufferBase( GL_UNIFORM_BUFFER, j, ubo );
-				// TODO: Cache the call from LinkShaderObjectAPI above somewhere
-				//glBindBuffer(GL_UNIFORM_BUFFER, fs.ConstantBuffers[EShaderType::ST_PIXEL][j]->GetBufferObjectAPI());
-				//glUniformBlockBinding(fs.VertexShader->LinkShaderObjectAPI(shaders), j, 0);
-				//CheckGlError();
-			}
+			FlushDrawsGL();
+
+			ContextStateMachine.SetFromPipelineState(&state);
+
+			if(DoDrawcalls)
+				BindPipelineState(state, ContextStateMachine.GetChanges(), ContextStateMachine);
+
+			ContextStateMachine.ResetChanges();
 		}
+
+		if(DoDrawcalls)
+			QueueDrawGL(RCmdDraw::FromPipelineState(state));
 	}
-	*/
-	//if(changes.StructuredBuffers[EShaderType::ST_VERTEX])
-	//{
-	//	for(unsigned int j=0;j<fs.StructuredBuffers[EShaderType::ST_VERTEX].size();j++)
-	//	{
-	//		if(fs.StructuredBuffers[EShaderType::ST_VERTEX][j])
-	//		{
-	//			context->VSSetShaderResources(j, 1, fs.StructuredBuffers[EShaderType::ST_VERTEX][j]->GetBufferSRVPtr());
-	//		}
-	//	}
-	//}
 
-	//if(changes.Viewport && fs.Viewport)
-	//{
-	//	context->RSSetViewports(1, (D3D11_VIEWPORT*)&fs.Viewport->GetViewportInfo());
-	//}
+	FlushDrawsGL();
 
 	return true;
 }
 
-bool RGLDevice::DrawPipelineStateAPI(const struct RPipelineState &state,
-                                     const RStateMachine::ChangesStruct &changes, RStateMachine &stateMachine)
+/**
+* Collects draws done with the same bindings, so they can go out as one multi-draw
+*/
+void RGLDevice::QueueDrawGL(const RCmdDraw& draw)
 {
-	// Bind everything
-	if(DoDrawcalls)
+	// One multi-draw only takes one kind of drawcall
+	if(!PendingDraws.empty()
+		&& (PendingDraws.back().DrawFunctionID != draw.DrawFunctionID || PendingDraws.back().PrimitiveType != draw.PrimitiveType))
+		FlushDrawsGL();
+
+	PendingDraws.push_back(draw);
+}
+
+/**
+* Issues the collected draws. Runs long enough go into a single multi-draw-indirect call.
+*/
+void RGLDevice::FlushDrawsGL()
+{
+	if(PendingDraws.empty())
+		return;
+
+	BindVertexArrayGL();
+
+	if(PendingDraws.size() < GL_MIN_MULTIDRAW_RUN || !MultiDrawIndirectGL(PendingDraws.data(), (unsigned int)PendingDraws.size()))
 	{
-		BindPipelineState(state, changes, stateMachine);
-		CheckGlError();
+		for(const RCmdDraw& d : PendingDraws)
+			DrawGL(d);
+	}
 
-		// Perform drawcall
-		switch(state.IDs.DrawFunctionID)
+	PendingDraws.clear();
+}
+
+/**
+* Writes the given draws into the indirect buffer and issues them with a single call.
+* Returns false if that isn't supported or there is no room left this frame.
+*/
+bool RGLDevice::MultiDrawIndirectGL(const RCmdDraw* draws, unsigned int numDraws)
+{
+	if(!GLEW_ARB_multi_draw_indirect || !GLEW_ARB_buffer_storage)
+		return false;
+
+	uint32_t drawFunction = draws[0].DrawFunctionID;
+	if(drawFunction != EDrawCallType::DCT_Draw && drawFunction != EDrawCallType::DCT_DrawIndexed
+		&& drawFunction != EDrawCallType::DCT_DrawIndexedInstanced)
+		return false;
+
+	if(!IndirectBuffer)
+		CreateIndirectBufferGL();
+
+	if(!IndirectMapped)
+		return false;
+
+	// Move on to the part of this frame. The GPU has to be done with the frame which used it before.
+	if(IndirectFrame != FrameCounter)
+	{
+		IndirectFrame = FrameCounter;
+		IndirectUsed = 0;
+
+		if(FrameCounter >= (unsigned int)GL_NUM_FRAME_FENCES)
+			WaitForFrameGL(FrameCounter - GL_NUM_FRAME_FENCES);
+	}
+
+	if(IndirectUsed + numDraws > GL_INDIRECT_COMMANDS_PER_FRAME)
+		return false;
+
+	unsigned int first = (FrameCounter % GL_NUM_FRAME_FENCES) * GL_INDIRECT_COMMANDS_PER_FRAME + IndirectUsed;
+	GLDrawElementsIndirectCommand* commands = (GLDrawElementsIndirectCommand*)IndirectMapped + first;
+	IndirectUsed += numDraws;
+
+	StateCache.BindBuffer(GL_DRAW_INDIRECT_BUFFER, IndirectBuffer);
+	const void* offset = (const void*)(first * sizeof(GLDrawElementsIndirectCommand));
+
+	if(drawFunction == EDrawCallType::DCT_Draw)
+	{
+		for(unsigned int i = 0; i < numDraws; i++)
 		{
-		case EDrawCallType::DCT_Draw:
-			glDrawArrays(state.IDs.PrimitiveType, state.StartVertexOffset, state.NumDrawElements);
-			break;
+			GLDrawArraysIndirectCommand& c = *(GLDrawArraysIndirectCommand*)&commands[i];
+			c.Count = draws[i].NumDrawElements;
+			c.InstanceCount = 1;
+			c.First = draws[i].StartVertexOffset;
+			c.BaseInstance = 0;
+		}
 
-		case EDrawCallType::DCT_DrawIndexed:
-			glDrawElements(state.IDs.PrimitiveType, state.NumDrawElements, GL_UNSIGNED_INT, (void*)(state.StartIndexOffset * sizeof(uint32_t))); // TODO: Support GL_UNSIGNED_SHORT
-			break;
+		glMultiDrawArraysIndirect(draws[0].PrimitiveType, offset, numDraws, sizeof(GLDrawElementsIndirectCommand));
+	}
+	else
+	{
+		// Indices of dynamic buffers don't start at the beginning of the buffer object
+		GLuint indexBase = BoundIndexBuffer ? (GLuint)(BoundIndexBuffer->GetBindOffsetAPI() / sizeof(uint32_t)) : 0;
+		bool instanced = drawFunction == EDrawCallType::DCT_DrawIndexedInstanced;
 
-		case EDrawCallType::DCT_DrawIndexedInstanced:
-			glDrawElementsInstancedBaseInstance(state.IDs.PrimitiveType, state.NumDrawElements, GL_UNSIGNED_INT, (void*)(state.StartIndexOffset * sizeof(uint32_t)), state.NumInstances, state.StartInstanceOffset);
-			//glDrawElementsInstanced(state.IDs.PrimitiveType, state.NumInstances, GL_UNSIGNED_INT, 0, state.NumDrawElements);
-			//context->DrawIndexedInstanced(state.NumDrawElements, state.NumInstances, state.StartIndexOffset, state.StartVertexOffset, state.StartInstanceOffset);
-			break;
+		for(unsigned int i = 0; i < numDraws; i++)
+		{
+			GLDrawElementsIndirectCommand& c = commands[i];
+			c.Count = draws[i].NumDrawElements;
+			c.InstanceCount = instanced ? draws[i].NumInstances : 1;
+			c.FirstIndex = indexBase + draws[i].StartIndexOffset;
+			c.BaseVertex = 0;
+			c.BaseInstance = instanced ? draws[i].StartInstanceOffset : 0;
 		}
 
-		CheckGlError();
+		glMultiDrawElementsIndirect(draws[0].PrimitiveType, GL_UNSIGNED_INT, offset, numDraws, sizeof(GLDrawElementsIndirectCommand));
 	}
-    return true;
+
+	CheckGlError();
+
+	return true;
 }
 
-bool RGLDevice::DrawPipelineStatesAPI(struct RPipelineState *const *stateArray, unsigned int numStates)
+/**
+* Creates the persistently mapped buffer the indirect commands are written to
+*/
+bool RGLDevice::CreateIndirectBufferGL()
 {
-    return false;
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	GLsizeiptr size = sizeof(GLDrawElementsIndirectCommand) * GL_INDIRECT_COMMANDS_PER_FRAME * GL_NUM_FRAME_FENCES;
+
+	glGenBuffers(1, &IndirectBuffer);
+	StateCache.BindBuffer(GL_DRAW_INDIRECT_BUFFER, IndirectBuffer);
+
+	glBufferStorage(GL_DRAW_INDIRECT_BUFFER, size, nullptr, flags);
+	IndirectMapped = (uint8_t*)glMapBufferRange(GL_DRAW_INDIRECT_BUFFER, 0, size, flags);
+	CheckGlError();
+
+	// The buffer is kept around unmapped on failure, so this isn't tried again
+	if(!IndirectMapped)
+	{
+		LogWarn() << "Failed to map the indirect buffer, multi-draws are disabled";
+		return false;
+	}
+
+	return true;
 }
 
 bool RGLDevice::RegisterThreadAPI(uint32_t threadID)
 {
-    return false;
+	// Worker-threads only record into software commandlists, they don't need a context
+    return true;
 }
 
 bool RGLDevice::CreateCommandListForThreadAPI(uint32_t threadID)
@@ -310,7 +811,23 @@ bool RGLDevice::CreateCommandListForThreadAPI(uint32_t threadID)
 
 bool RGLDevice::PrepareContextAPI(unsigned int threadId)
 {
-    return false;
+	// Called from worker-threads as well, which must not touch GL
+    return true;
+}
+
+/**
+* Binds the API-Context to the calling thread, or releases it from there
+*/
+bool RGLDevice::MakeContextCurrentAPI()
+{
+	glfwMakeContextCurrent(OutputWindow);
+	return true;
+}
+
+bool RGLDevice::ReleaseContextAPI()
+{
+	glfwMakeContextCurrent(nullptr);
+	return true;
 }
 
 bool RGLDevice::GetDisplayModeListAPI(std::vector<DisplayModeInfo> &modeList, bool includeSuperSampling)
@@ -1,7 +1,19 @@
 #include "pch.h"
 #include "RGLInputLayout.h"
+#include "REngine.h"
+#include "RDevice.h"
+#include "RInputLayout.h"
 
+#ifdef RND_GL
 namespace RAPI
 {
-
-}
\ No newline at end of file
+	/**
+	* Drops the VAOs made with this layout
+	*/
+	RGLInputLayout::~RGLInputLayout()
+	{
+		if(REngine::RenderingDevice)
+			REngine::RenderingDevice->GetVertexArrayCache().OnInputLayoutDeleted((RInputLayout*)this);
+	}
+}
+#endif
@@ -0,0 +1,179 @@
+#include "pch.h"
+#include "RGLProgramCache.h"
+
+#ifdef RND_GL
+#include "Logger.h"
+#include <fstream>
+
+using namespace RAPI;
+
+// Marks the file, and changes whenever its layout does
+const uint32_t PROGRAM_CACHE_MAGIC = 0x43475052; // "RPGC"
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+RGLProgramCache::RGLProgramCache()
+{
+}
+
+/**
+ * Hash which stays the same between runs, for the keys and the driver (FNV-1a)
+ */
+uint64_t RGLProgramCache::HashString(const std::string &s, uint64_t hash)
+{
+	for(char c : s)
+	{
+		hash ^= (uint8_t)c;
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+/**
+ * Reads the binaries stored in the given file. Does nothing if the filename is empty.
+ */
+void RGLProgramCache::Open(const std::string &file, const std::string &driver)
+{
+	File = file;
+	Entries.clear();
+
+	if(File.empty())
+		return;
+
+	uint64_t driverHash = HashString(driver);
+
+	std::ifstream f(File, std::ios::binary | std::ios::ate);
+	uint64_t fileSize = f ? (uint64_t)f.tellg() : 0;
+	f.seekg(0);
+
+	uint32_t magic = 0, version = 0;
+	uint64_t fileDriver = 0;
+	f.read((char *)&magic, sizeof(magic));
+	f.read((char *)&version, sizeof(version));
+	f.read((char *)&fileDriver, sizeof(fileDriver));
+
+	if(!f || magic != PROGRAM_CACHE_MAGIC || version != PROGRAM_CACHE_VERSION || fileDriver != driverHash)
+	{
+		// Missing, broken or made by a different driver. Start over.
+		f.close();
+		StartOver(driverHash);
+		return;
+	}
+
+	// Entries were appended as they were linked
+	while(f)
+	{
+		uint64_t key;
+		uint32_t format, size;
+		f.read((char *)&key, sizeof(key));
+		f.read((char *)&format, sizeof(format));
+		f.read((char *)&size, sizeof(size));
+
+		if(!f)
+			break;
+
+		// Cut off or corrupt. Don't trust anything in there and don't allocate whatever the size says.
+		uint64_t remaining = fileSize - (uint64_t)f.tellg();
+		if(size > remaining)
+		{
+			LogWarn() << "Program cache is damaged, starting over: " << File;
+
+			f.close();
+			Entries.clear();
+			StartOver(driverHash);
+			return;
+		}
+
+		Entry e;
+		e.Format = format;
+		e.Binary.resize(size);
+		f.read((char *)e.Binary.data(), size);
+
+		if(!f)
+			break;
+
+		Entries[key] = std::move(e);
+	}
+
+	LogInfo() << "Program cache: " << Entries.size() << " binaries in " << File;
+}
+
+/**
+ * Truncates the file and writes a new header for the given driver
+ */
+void RGLProgramCache::StartOver(uint64_t driverHash)
+{
+	std::ofstream o(File, std::ios::binary | std::ios::trunc);
+	o.write((const char *)&PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC));
+	o.write((const char *)&PROGRAM_CACHE_VERSION, sizeof(PROGRAM_CACHE_VERSION));
+	o.write((const char *)&driverHash, sizeof(driverHash));
+
+	if(!o)
+	{
+		LogWarn() << "Can't write program cache: " << File;
+		File.clear();
+	}
+}
+
+/**
+ * Puts the binary stored under the given key into the program.
+ * Returns false if there is none, or the driver didn't take it.
+ */
+bool RGLProgramCache::LoadProgram(uint64_t key, GLuint program)
+{
+	auto it = Entries.find(key);
+	if(it == Entries.end())
+		return false;
+
+	const Entry &e = (*it).second;
+	glProgramBinary(program, e.Format, e.Binary.data(), (GLsizei)e.Binary.size());
+
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+
+	if(status != GL_TRUE)
+	{
+		// Driver got updated without its version changing, or similar. Will be linked and stored again.
+		Stats.NumRejected++;
+		Entries.erase(it);
+		return false;
+	}
+
+	Stats.NumLoaded++;
+	return true;
+}
+
+/**
+ * Gets the binary of the freshly linked program and adds it to the file
+ */
+void RGLProgramCache::StoreProgram(uint64_t key, GLuint program)
+{
+	Stats.NumLinked++;
+
+	if(File.empty())
+		return;
+
+	GLint size = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+
+	if(size <= 0)
+		return;
+
+	Entry e;
+	e.Binary.resize(size);
+	glGetProgramBinary(program, size, nullptr, &e.Format, e.Binary.data());
+	CheckGlError();
+
+	uint32_t format = e.Format;
+	uint32_t binarySize = (uint32_t)size;
+
+	std::ofstream o(File, std::ios::binary | std::ios::app);
+	o.write((const char *)&key, sizeof(key));
+	o.write((const char *)&format, sizeof(format));
+	o.write((const char *)&binarySize, sizeof(binarySize));
+	o.write((const char *)e.Binary.data(), binarySize);
+
+	Entries[key] = std::move(e);
+}
+
+#endif
@@ -3,4 +3,30 @@
 
 #ifdef RND_GL
 using namespace RAPI;
-#endif
\ No newline at end of file
+
+/**
+ * API-Version of CreateState
+ */
+bool RGLRasterizerState::CreateStateAPI()
+{
+	Record = MakeRecord(StateInfo);
+	return true;
+}
+
+/**
+ * Converts the given stateinfo to GL-Values. Like on D3D11, turning depth-clipping off clamps instead.
+ */
+RGLRasterizerRecord RGLRasterizerState::MakeRecord(const RRasterizerStateInfo &info)
+{
+	RGLRasterizerRecord r;
+	r.CullEnabled = info.CullMode != RRasterizerStateInfo::CM_CULL_NONE ? GL_TRUE : GL_FALSE;
+	r.CullFace = info.CullMode == RRasterizerStateInfo::CM_CULL_FRONT ? GL_FRONT : GL_BACK;
+	r.FrontFace = info.FrontCounterClockwise ? GL_CCW : GL_CW;
+	r.PolygonMode = info.Wireframe ? GL_LINE : GL_FILL;
+	r.DepthClamp = info.DepthClipEnable ? GL_FALSE : GL_TRUE;
+	r.DepthBias = (GLfloat)info.ZBias;
+
+	return r;
+}
+
+#endif
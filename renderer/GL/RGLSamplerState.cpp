@@ -2,5 +2,90 @@
 #include "RGLSamplerState.h"
 
 #ifdef RND_GL
+#include "REngine.h"
+#include "RDevice.h"
+#include "Logger.h"
+
 using namespace RAPI;
-#endif
\ No newline at end of file
+
+/**
+ * Converts the D3D11-Style address mode
+ */
+static GLenum GetGLAddressMode(ETextureAddress address)
+{
+	switch(address)
+	{
+	case TA_MIRROR: return GL_MIRRORED_REPEAT;
+	case TA_CLAMP: return GL_CLAMP_TO_EDGE;
+	case TA_BORDER: return GL_CLAMP_TO_BORDER;
+	case TA_MIRROR_ONCE: return GL_MIRROR_CLAMP_TO_EDGE;
+	case TA_WRAP:
+	default: return GL_REPEAT;
+	}
+}
+
+RGLSamplerState::RGLSamplerState()
+{
+	SamplerObject = 0;
+}
+
+RGLSamplerState::~RGLSamplerState()
+{
+	if(!SamplerObject)
+		return;
+
+	glDeleteSamplers(1, &SamplerObject);
+
+	if(REngine::RenderingDevice)
+		REngine::RenderingDevice->GetStateCache().OnSamplerDeleted(SamplerObject);
+}
+
+/**
+ * API-Version of CreateState. The filter is laid out like the D3D11-one: Bit 0 is a linear mip-filter,
+ * bit 2 a linear mag-filter, bit 4 a linear min-filter, 0x40 anisotropic and 0x80 comparison.
+ */
+bool RGLSamplerState::CreateStateAPI()
+{
+	if(!SamplerObject)
+		glGenSamplers(1, &SamplerObject);
+
+	unsigned int filter = StateInfo.Filter;
+	bool anisotropic = (filter & 0x40) != 0;
+	bool minLinear = anisotropic || (filter & 0x10) != 0;
+	bool magLinear = anisotropic || (filter & 0x04) != 0;
+	bool mipLinear = anisotropic || (filter & 0x01) != 0;
+
+	GLenum minFilter;
+	if(minLinear)
+		minFilter = mipLinear ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR_MIPMAP_NEAREST;
+	else
+		minFilter = mipLinear ? GL_NEAREST_MIPMAP_LINEAR : GL_NEAREST_MIPMAP_NEAREST;
+
+	glSamplerParameteri(SamplerObject, GL_TEXTURE_MIN_FILTER, minFilter);
+	glSamplerParameteri(SamplerObject, GL_TEXTURE_MAG_FILTER, magLinear ? GL_LINEAR : GL_NEAREST);
+
+	glSamplerParameteri(SamplerObject, GL_TEXTURE_WRAP_S, GetGLAddressMode(StateInfo.AddressU));
+	glSamplerParameteri(SamplerObject, GL_TEXTURE_WRAP_T, GetGLAddressMode(StateInfo.AddressV));
+	glSamplerParameteri(SamplerObject, GL_TEXTURE_WRAP_R, GL_REPEAT);
+
+	const GLfloat border[] = {1.0f, 1.0f, 1.0f, 1.0f};
+	glSamplerParameterfv(SamplerObject, GL_TEXTURE_BORDER_COLOR, border);
+
+	if((filter & 0x80) != 0)
+	{
+		glSamplerParameteri(SamplerObject, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glSamplerParameteri(SamplerObject, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	}
+
+	if(GLEW_EXT_texture_filter_anisotropic)
+	{
+		GLfloat aniso = anisotropic ? std::min((GLfloat)StateInfo.MaxAnisotropy, REngine::RenderingDevice->GetLimits().MaxAnisotropy) : 1.0f;
+		glSamplerParameterf(SamplerObject, GL_TEXTURE_MAX_ANISOTROPY_EXT, std::max(1.0f, aniso));
+	}
+
+	CheckGlError();
+
+	return true;
+}
+
+#endif
@@ -2,6 +2,9 @@
 #include "RGLShader.h"
 #include "Logger.h"
 #include "RTools.h"
+#include "REngine.h"
+#include "RDevice.h"
+#include "RGLProgramCache.h"
 
 #ifdef RND_GL
 using namespace RAPI;
@@ -16,6 +19,9 @@ std::map<EShaderType, GLenum> GLShaderTypeMap = { {EShaderType::ST_VERTEX, GL_VE
 RAPI::RGLShader::RGLShader()
 {
 	ShaderObject = 0;
+	CompileFinished = false;
+	ShaderType = EShaderType::ST_VERTEX;
+	SourceHash = 0;
 }
 
 RAPI::RGLShader::~RGLShader()
@@ -25,6 +31,9 @@ RAPI::RGLShader::~RGLShader()
 	for(auto s : ProgramMap)
 	{
 		glDeleteProgram(s.second);
+
+		if(REngine::RenderingDevice)
+			REngine::RenderingDevice->GetStateCache().OnProgramDeleted(s.second);
 	}
 }
 
@@ -67,13 +76,11 @@ void CheckShader(GLuint id, GLuint type, GLint *ret, const char *onfail)
 
 
 /**
-* Loads the given shader
+* Loads the given shader. Compiling only gets started here if the driver does it in the background,
+* finishing it is left to the first link which needs it.
 */
 bool RGLShader::CompileShaderAPI(EShaderType shaderType)
 {
-	GLuint s = glCreateShader(GLShaderTypeMap[shaderType]);
-	CheckGlError();
-
 	if(IsFromMemory)
 	{
 		ShaderSource = ShaderFile;
@@ -100,30 +107,72 @@ bool RGLShader::CompileShaderAPI(EShaderType shaderType)
 		fclose(f);
 	}
 
+	ShaderType = shaderType;
+	SourceHash = RGLProgramCache::HashString(ShaderSource, RGLProgramCache::HashString(std::to_string(shaderType)));
+
+	// TODO: Error logging and only replace old shader if new one successfully compiled!
+	if(ShaderObject)
+	{
+		glDeleteShader(ShaderObject);
+		ShaderObject = 0;
+	}
+
+	// With parallel compiling, only start it here so all shaders of a level compile at the same time.
+	// Without, compile right away so the first draw using this doesn't have to.
+	if(GLEW_ARB_parallel_shader_compile)
+		StartCompile();
+	else
+		FinishCompile();
+
+	return true;
+}
+
+/**
+* Hands the source to the driver and starts compiling it
+*/
+void RGLShader::StartCompile()
+{
+	ShaderObject = glCreateShader(GLShaderTypeMap[ShaderType]);
+	CheckGlError();
+
 	// Load the shadersource
 	const char* src = ShaderSource.c_str();
-	size_t n = 1;
-	glShaderSource(s, 1, &src, nullptr);
+	glShaderSource(ShaderObject, 1, &src, nullptr);
 	CheckGlError();
 
 	// Compile...
-	glCompileShader(s);
+	glCompileShader(ShaderObject);
 	CheckGlError();
 
-	GLint ret;
-	CheckShader(s, GL_COMPILE_STATUS, &ret, "unable to compile shader!");
+	CompileFinished = false;
+}
 
-	// TODO: Error logging and only replace old shader if new one successfully compiled!
-	if(ShaderObject)
-	{
-		glDeleteShader(ShaderObject);
-	}
+/**
+* Waits for the compiler and logs its errors
+*/
+bool RGLShader::FinishCompile()
+{
+	if(!ShaderObject)
+		StartCompile();
 
-	ShaderObject = s;
+	if(CompileFinished)
+		return true;
 
-	return true;
+	GLint ret;
+	CheckShader(ShaderObject, GL_COMPILE_STATUS, &ret, "unable to compile shader!");
+	CompileFinished = true;
+
+	return ret != GL_FALSE;
 }
 
+/**
+* Returns the unlinked shaderobject of this. Compiles it first, if that didn't happen yet.
+*/
+GLuint RGLShader::GetShaderObjectAPI()
+{
+	FinishCompile();
+	return ShaderObject;
+}
 
 /**
 * Links a program from the shaders this is used with or takes one from cache if this already happened
@@ -138,29 +187,47 @@ GLuint RGLShader::LinkShaderObjectAPI(RGLShader** shaders, size_t numShaders)
 	if(it != ProgramMap.end())
 		return (*it).second;
 
-	// If not, link a new program
+	// If not, get a new program
 	GLuint program = glCreateProgram();
 	CheckGlError();
 
-	// Attach all of our shaders
+	// The binary-cache knows programs by what they are made of, since the pointers change between runs
+	uint64_t key = RGLProgramCache::HashString("");
 	for(int i=0;i<numShaders;i++)
 	{
 		if(shaders[i])
-			glAttachShader(program, shaders[i]->GetShaderObjectAPI());
+			key = RGLProgramCache::HashString(std::to_string(shaders[i]->GetSourceHashAPI()), key);
 	}
 
-	// Now link everything together and add it to the map
-	glLinkProgram(program);
-	CheckGlError();
+	RGLProgramCache& programCache = REngine::RenderingDevice->GetProgramCache();
+	if(!programCache.LoadProgram(key, program))
+	{
+		// Attach all of our shaders
+		for(int i=0;i<numShaders;i++)
+		{
+			if(shaders[i])
+				glAttachShader(program, shaders[i]->GetShaderObjectAPI());
+		}
 
-	GLint ret;
-	CheckShader(program, GL_LINK_STATUS, &ret, "unable to link shader!");
+		if(programCache.IsEnabled())
+			glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+		// Now link everything together
+		glLinkProgram(program);
+		CheckGlError();
+
+		GLint ret;
+		CheckShader(program, GL_LINK_STATUS, &ret, "unable to link shader!");
+
+		if(ret)
+			programCache.StoreProgram(key, program);
+	}
 
 	ProgramMap[hash] = program;
 
-	glUseProgram(program);
+	REngine::RenderingDevice->GetStateCache().UseProgram(program);
 
-	// Setup binding points
+	// Setup binding points. Not part of the stored binaries, so this has to be done for cached programs as well.
 	for(int i=0;;i++)
 	{
 		GLuint sd = glGetUniformBlockIndex(program, ("buffer" + std::to_string(i)).c_str());
@@ -0,0 +1,463 @@
+#include "pch.h"
+#include "RGLStateCache.h"
+
+#ifdef RND_GL
+#include <algorithm>
+#include <cmath>
+
+using namespace RAPI;
+
+// Marks a shadowed value as not known, so the next call goes through for sure
+const GLuint GL_STATE_UNKNOWN = 0xFFFFFFFF;
+
+RGLStateCache::RGLStateCache()
+{
+	Invalidate();
+}
+
+/**
+ * Sizes the per-unit tables for the given limits and forgets everything known about the context
+ */
+void RGLStateCache::Init(const RGLLimits &limits)
+{
+	UniformBuffers.resize(std::max(0, limits.MaxUniformBufferBindings));
+	UniformBufferOffsets.resize(UniformBuffers.size());
+	Textures.resize(std::max(0, limits.MaxTextureUnits));
+	Samplers.resize(std::max(0, limits.MaxTextureUnits));
+
+	Invalidate();
+}
+
+/**
+ * Forgets everything known about the context
+ */
+void RGLStateCache::Invalidate()
+{
+	Program = GL_STATE_UNKNOWN;
+	VertexArray = GL_STATE_UNKNOWN;
+	ActiveTextureUnit = GL_STATE_UNKNOWN;
+
+	std::fill(std::begin(Buffers), std::end(Buffers), GL_STATE_UNKNOWN);
+	std::fill(UniformBuffers.begin(), UniformBuffers.end(), GL_STATE_UNKNOWN);
+	std::fill(UniformBufferOffsets.begin(), UniformBufferOffsets.end(), -1);
+	std::fill(Textures.begin(), Textures.end(), GL_STATE_UNKNOWN);
+	std::fill(Samplers.begin(), Samplers.end(), GL_STATE_UNKNOWN);
+	std::fill(std::begin(Caps), std::end(Caps), GL_STATE_UNKNOWN);
+
+	DepthFuncValue = GL_STATE_UNKNOWN;
+	CullFaceValue = GL_STATE_UNKNOWN;
+	FrontFaceValue = GL_STATE_UNKNOWN;
+	std::fill(std::begin(ViewportValue), std::end(ViewportValue), -1);
+	std::fill(std::begin(DepthRangeValue), std::end(DepthRangeValue), -1.0f);
+	DepthMaskValue = GL_STATE_UNKNOWN;
+	ColorMaskValue = GL_STATE_UNKNOWN;
+	std::fill(std::begin(BlendFuncValue), std::end(BlendFuncValue), GL_STATE_UNKNOWN);
+	std::fill(std::begin(BlendEquationValue), std::end(BlendEquationValue), GL_STATE_UNKNOWN);
+	PolygonModeValue = GL_STATE_UNKNOWN;
+	PolygonOffsetValue = NAN;
+}
+
+/**
+ * Starts counting the calls of a new frame
+ */
+void RGLStateCache::OnFrameStart()
+{
+	LastFrameStats = FrameStats;
+	FrameStats = RGLStateCacheStats();
+}
+
+void RGLStateCache::UseProgram(GLuint program)
+{
+	if(Check(Program == program))
+		return;
+
+	glUseProgram(program);
+	Program = program;
+}
+
+void RGLStateCache::BindVertexArray(GLuint vao)
+{
+	if(Check(VertexArray == vao))
+		return;
+
+	glBindVertexArray(vao);
+	VertexArray = vao;
+
+	// The indexbuffer-binding belongs to the VAO
+	Buffers[GetBufferTargetIndex(GL_ELEMENT_ARRAY_BUFFER)] = GL_STATE_UNKNOWN;
+}
+
+void RGLStateCache::BindBuffer(GLenum target, GLuint buffer)
+{
+	int t = GetBufferTargetIndex(target);
+
+	if(Check(t >= 0 && Buffers[t] == buffer))
+		return;
+
+	glBindBuffer(target, buffer);
+
+	if(t >= 0)
+		Buffers[t] = buffer;
+}
+
+void RGLStateCache::BindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	bool shadowed = target == GL_UNIFORM_BUFFER && index < UniformBuffers.size();
+
+	if(Check(shadowed && UniformBuffers[index] == buffer && UniformBufferOffsets[index] == -1))
+		return;
+
+	glBindBufferBase(target, index, buffer);
+
+	if(shadowed)
+	{
+		UniformBuffers[index] = buffer;
+		UniformBufferOffsets[index] = -1;
+	}
+
+	// Binding to an indexed target also binds to the generic one
+	int t = GetBufferTargetIndex(target);
+	if(t >= 0)
+		Buffers[t] = buffer;
+}
+
+/**
+ * Binds a part of the buffer. Sizes of the same buffer are expected to stay the same for an offset.
+ */
+void RGLStateCache::BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	bool shadowed = target == GL_UNIFORM_BUFFER && index < UniformBuffers.size();
+
+	if(Check(shadowed && UniformBuffers[index] == buffer && UniformBufferOffsets[index] == offset))
+		return;
+
+	glBindBufferRange(target, index, buffer, offset, size);
+
+	if(shadowed)
+	{
+		UniformBuffers[index] = buffer;
+		UniformBufferOffsets[index] = offset;
+	}
+
+	int t = GetBufferTargetIndex(target);
+	if(t >= 0)
+		Buffers[t] = buffer;
+}
+
+/**
+ * Binds the 2D-Texture to the given unit
+ */
+void RGLStateCache::BindTexture(GLuint unit, GLuint texture)
+{
+	bool shadowed = unit < Textures.size();
+
+	if(Check(shadowed && Textures[unit] == texture))
+		return;
+
+	ActiveTexture(unit);
+	glBindTexture(GL_TEXTURE_2D, texture);
+
+	if(shadowed)
+		Textures[unit] = texture;
+}
+
+/**
+ * Binds the 2D-Texture to the active unit, for uploading data to it
+ */
+void RGLStateCache::BindTextureForEdit(GLuint texture)
+{
+	// Don't know which unit is active, so just use the first one
+	if(ActiveTextureUnit == GL_STATE_UNKNOWN)
+		ActiveTexture(0);
+
+	BindTexture(ActiveTextureUnit, texture);
+}
+
+/**
+ * Binds the sampler-object to the given unit
+ */
+void RGLStateCache::BindSampler(GLuint unit, GLuint sampler)
+{
+	bool shadowed = unit < Samplers.size();
+
+	if(Check(shadowed && Samplers[unit] == sampler))
+		return;
+
+	glBindSampler(unit, sampler);
+
+	if(shadowed)
+		Samplers[unit] = sampler;
+}
+
+/**
+ * Switches the active texture unit
+ */
+void RGLStateCache::ActiveTexture(GLuint unit)
+{
+	if(Check(ActiveTextureUnit == unit))
+		return;
+
+	glActiveTexture(GL_TEXTURE0 + unit);
+	ActiveTextureUnit = unit;
+}
+
+void RGLStateCache::Enable(GLenum cap)
+{
+	int c = GetCapIndex(cap);
+
+	if(Check(c >= 0 && Caps[c] == 1))
+		return;
+
+	glEnable(cap);
+
+	if(c >= 0)
+		Caps[c] = 1;
+}
+
+void RGLStateCache::Disable(GLenum cap)
+{
+	int c = GetCapIndex(cap);
+
+	if(Check(c >= 0 && Caps[c] == 0))
+		return;
+
+	glDisable(cap);
+
+	if(c >= 0)
+		Caps[c] = 0;
+}
+
+void RGLStateCache::SetEnabled(GLenum cap, bool enabled)
+{
+	if(enabled)
+		Enable(cap);
+	else
+		Disable(cap);
+}
+
+void RGLStateCache::DepthFunc(GLenum func)
+{
+	if(Check(DepthFuncValue == func))
+		return;
+
+	glDepthFunc(func);
+	DepthFuncValue = func;
+}
+
+void RGLStateCache::CullFace(GLenum mode)
+{
+	if(Check(CullFaceValue == mode))
+		return;
+
+	glCullFace(mode);
+	CullFaceValue = mode;
+}
+
+void RGLStateCache::FrontFace(GLenum mode)
+{
+	if(Check(FrontFaceValue == mode))
+		return;
+
+	glFrontFace(mode);
+	FrontFaceValue = mode;
+}
+
+void RGLStateCache::Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	if(Check(ViewportValue[0] == x && ViewportValue[1] == y && ViewportValue[2] == width && ViewportValue[3] == height))
+		return;
+
+	glViewport(x, y, width, height);
+	ViewportValue[0] = x;
+	ViewportValue[1] = y;
+	ViewportValue[2] = width;
+	ViewportValue[3] = height;
+}
+
+void RGLStateCache::DepthRange(GLfloat nearVal, GLfloat farVal)
+{
+	if(Check(DepthRangeValue[0] == nearVal && DepthRangeValue[1] == farVal))
+		return;
+
+	glDepthRange(nearVal, farVal);
+	DepthRangeValue[0] = nearVal;
+	DepthRangeValue[1] = farVal;
+}
+
+void RGLStateCache::DepthMask(GLboolean enabled)
+{
+	GLuint v = enabled ? 1 : 0;
+	if(Check(DepthMaskValue == v))
+		return;
+
+	glDepthMask(enabled);
+	DepthMaskValue = v;
+}
+
+void RGLStateCache::ColorMask(GLboolean enabled)
+{
+	GLuint v = enabled ? 1 : 0;
+	if(Check(ColorMaskValue == v))
+		return;
+
+	glColorMask(enabled, enabled, enabled, enabled);
+	ColorMaskValue = v;
+}
+
+void RGLStateCache::BlendFunc(GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha)
+{
+	if(Check(BlendFuncValue[0] == srcRGB && BlendFuncValue[1] == dstRGB && BlendFuncValue[2] == srcAlpha && BlendFuncValue[3] == dstAlpha))
+		return;
+
+	glBlendFuncSeparate(srcRGB, dstRGB, srcAlpha, dstAlpha);
+	BlendFuncValue[0] = srcRGB;
+	BlendFuncValue[1] = dstRGB;
+	BlendFuncValue[2] = srcAlpha;
+	BlendFuncValue[3] = dstAlpha;
+}
+
+void RGLStateCache::BlendEquation(GLenum modeRGB, GLenum modeAlpha)
+{
+	if(Check(BlendEquationValue[0] == modeRGB && BlendEquationValue[1] == modeAlpha))
+		return;
+
+	glBlendEquationSeparate(modeRGB, modeAlpha);
+	BlendEquationValue[0] = modeRGB;
+	BlendEquationValue[1] = modeAlpha;
+}
+
+void RGLStateCache::PolygonMode(GLenum mode)
+{
+	if(Check(PolygonModeValue == mode))
+		return;
+
+	glPolygonMode(GL_FRONT_AND_BACK, mode);
+	PolygonModeValue = mode;
+}
+
+/**
+ * Sets the constant depth-offset. The slope-factor is always 0, like the D3D11-States are made.
+ */
+void RGLStateCache::PolygonOffset(GLfloat units)
+{
+	// Unknown is NaN, which never compares equal
+	if(Check(PolygonOffsetValue == units))
+		return;
+
+	glPolygonOffset(0.0f, units);
+	PolygonOffsetValue = units;
+}
+
+void RGLStateCache::ApplyBlendState(const RGLBlendRecord &blend)
+{
+	SetEnabled(GL_BLEND, blend.Enabled != GL_FALSE);
+	SetEnabled(GL_SAMPLE_ALPHA_TO_COVERAGE, blend.AlphaToCoverage != GL_FALSE);
+	ColorMask(blend.ColorWrites);
+
+	// Factors don't matter while blending is off, leave them for the next state which uses them
+	if(blend.Enabled)
+	{
+		BlendFunc(blend.SrcRGB, blend.DstRGB, blend.SrcAlpha, blend.DstAlpha);
+		BlendEquation(blend.EquationRGB, blend.EquationAlpha);
+	}
+}
+
+void RGLStateCache::ApplyRasterizerState(const RGLRasterizerRecord &rasterizer)
+{
+	SetEnabled(GL_CULL_FACE, rasterizer.CullEnabled != GL_FALSE);
+	if(rasterizer.CullEnabled)
+		CullFace(rasterizer.CullFace);
+
+	FrontFace(rasterizer.FrontFace);
+	PolygonMode(rasterizer.PolygonMode);
+	SetEnabled(GL_DEPTH_CLAMP, rasterizer.DepthClamp != GL_FALSE);
+
+	bool offset = rasterizer.DepthBias != 0.0f;
+	SetEnabled(GL_POLYGON_OFFSET_FILL, offset);
+	SetEnabled(GL_POLYGON_OFFSET_LINE, offset);
+	if(offset)
+		PolygonOffset(rasterizer.DepthBias);
+}
+
+void RGLStateCache::ApplyDepthStencilState(const RGLDepthStencilRecord &depthStencil)
+{
+	SetEnabled(GL_DEPTH_TEST, depthStencil.DepthTest != GL_FALSE);
+
+	// With the test off GL doesn't write depth either, so mask and function can stay as they are
+	if(depthStencil.DepthTest)
+	{
+		DepthMask(depthStencil.DepthWrites);
+		DepthFunc(depthStencil.DepthFunc);
+	}
+}
+
+/**
+ * Deleted objects are unbound by GL. Their names may be given out again right away.
+ */
+void RGLStateCache::OnProgramDeleted(GLuint program)
+{
+	if(Program == program)
+		Program = GL_STATE_UNKNOWN;
+}
+
+void RGLStateCache::OnVertexArrayDeleted(GLuint vao)
+{
+	if(VertexArray == vao)
+		VertexArray = GL_STATE_UNKNOWN;
+}
+
+void RGLStateCache::OnBufferDeleted(GLuint buffer)
+{
+	std::replace(std::begin(Buffers), std::end(Buffers), buffer, GL_STATE_UNKNOWN);
+	std::replace(UniformBuffers.begin(), UniformBuffers.end(), buffer, GL_STATE_UNKNOWN);
+}
+
+void RGLStateCache::OnTextureDeleted(GLuint texture)
+{
+	std::replace(Textures.begin(), Textures.end(), texture, GL_STATE_UNKNOWN);
+}
+
+void RGLStateCache::OnSamplerDeleted(GLuint sampler)
+{
+	std::replace(Samplers.begin(), Samplers.end(), sampler, GL_STATE_UNKNOWN);
+}
+
+/**
+ * Index of the given target in the buffer table
+ */
+int RGLStateCache::GetBufferTargetIndex(GLenum target)
+{
+	switch(target)
+	{
+	case GL_ARRAY_BUFFER: return 0;
+	case GL_ELEMENT_ARRAY_BUFFER: return 1;
+	case GL_UNIFORM_BUFFER: return 2;
+	case GL_COPY_READ_BUFFER: return 3;
+	case GL_COPY_WRITE_BUFFER: return 4;
+	case GL_PIXEL_UNPACK_BUFFER: return 5;
+	case GL_DRAW_INDIRECT_BUFFER: return 6;
+	default: return -1;
+	}
+}
+
+/**
+ * Index of the given capability in the enabled-table
+ */
+int RGLStateCache::GetCapIndex(GLenum cap)
+{
+	switch(cap)
+	{
+	case GL_DEPTH_TEST: return 0;
+	case GL_CULL_FACE: return 1;
+	case GL_BLEND: return 2;
+	case GL_SCISSOR_TEST: return 3;
+	case GL_STENCIL_TEST: return 4;
+	case GL_POLYGON_OFFSET_FILL: return 5;
+	case GL_POLYGON_OFFSET_LINE: return 6;
+	case GL_SAMPLE_ALPHA_TO_COVERAGE: return 7;
+	case GL_DEPTH_CLAMP: return 8;
+	default: return -1;
+	}
+}
+
+#endif
@@ -3,6 +3,7 @@
 
 #ifdef RND_GL
 #include "REngine.h"
+#include "RDevice.h"
 #include "Logger.h"
 #include "lib/nv_dds/nv_dds.h"
 #include <sstream>
@@ -13,6 +14,10 @@ using namespace RAPI;
 RGLTexture::RGLTexture()
 {
 	TextureObject = 0;
+	GLTextureFormat = 0;
+	IsCompressed = false;
+	PendingUploads = 0;
+	MappedSubresource = 0;
 }
 
 
@@ -35,44 +40,7 @@ bool RGLTexture::CreateFromFileAPI(const std::string& file)
 
 	GLTextureFormat = image.get_format();
 
-	// Create texture object
-	glGenTextures(1, &TextureObject);
-	glBindTexture(GL_TEXTURE_2D, TextureObject);
-
-	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT ); 
-	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT );
-	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR ); 
-
-	if(image.is_compressed())
-	{
-		glCompressedTexImage2DARB(GL_TEXTURE_2D, 0, image.get_format(),
-			image.get_width(), image.get_height(), 0, image.get_size(),
-			image);
-
-		for(int i = 0; i < image.get_num_mipmaps(); i++)
-		{
-			nv_dds::CSurface mipmap = image.get_mipmap(i);
-
-			glCompressedTexImage2DARB(GL_TEXTURE_2D, i + 1, image.get_format(),
-				mipmap.get_width(), mipmap.get_height(), 0, mipmap.get_size(),
-				mipmap);
-		}
-	}
-	else
-	{
-		glTexImage2D(GL_TEXTURE_2D, 0, image.get_components(), image.get_width(),
-		    image.get_height(), 0, image.get_format(), GL_UNSIGNED_BYTE, image);
-		
-		for (int i = 0; i < image.get_num_mipmaps(); i++)
-		{
-		    glTexImage2D(GL_TEXTURE_2D, i+1, image.get_components(),
-		        image.get_mipmap(i).get_width(), image.get_mipmap(i).get_height(),
-		        0, image.get_format(), GL_UNSIGNED_BYTE, image.get_mipmap(i));
-		}
-	}
-
-	return true;
+	return CreateFromImageGL(image);
 }
 
 /**
@@ -124,25 +92,65 @@ bool RGLTexture::CreateTextureAPI(const void* textureData,
 		return false;
 
 	GLTextureFormat = image.get_format();
-	GLTextureType = image.get_type();
 
+	// Optional dds-header skip
+	uint32_t skip = 0;
+	if(MemoryContainsDDSHeader)
+		skip = sizeof(uint32_t) + sizeof(DDSURFACEDESC2);
+
+	return CreateFromImageGL(image);
+}
+
+/**
+* Creates the texture-object and puts all levels of the given image into it. The levels are staged in the
+* upload-ring if there is one, the texture is ready once the GPU took them from there.
+*/
+bool RGLTexture::CreateFromImageGL(nv_dds::CDDSImage& image)
+{
+	IsCompressed = image.is_compressed();
+	Resolution = RInt2(image.get_width(), image.get_height());
+	NumMipLevels = image.get_num_mipmaps() + 1;
+
+	bool created = REngine::RenderingDevice->GetLimits().DirectStateAccess ? 
+		CreateStorageDSA(image) 
+		: CreateStorageGL(image);
+
+	if(!created)
+		return false;
+
+	WriteLevelGL(0, image.get_data(), image.get_size());
+
+	for(int i = 0; i < image.get_num_mipmaps(); i++)
+	{
+		nv_dds::CSurface mipmap = image.get_mipmap(i);
+		WriteLevelGL(i + 1, mipmap, mipmap.get_size());
+	}
+
+	IsFullyInitialized = PendingUploads == 0;
+
+	return true;
+}
+
+/**
+* Creates the texture-object and reserves the memory of all levels of the image, without filling them
+*/
+bool RGLTexture::CreateStorageGL(nv_dds::CDDSImage& image)
+{
 	// Create texture object
 	glGenTextures(1, &TextureObject);
 	CheckGlError();
 
-	glBindTexture(GL_TEXTURE_2D, TextureObject);
+	REngine::RenderingDevice->GetStateCache().BindTextureForEdit(TextureObject);
 	CheckGlError();
 
-	// Optional dds-header skip
-	uint32_t skip = 0;
-	if(MemoryContainsDDSHeader)
-		skip = sizeof(uint32_t) + sizeof(DDSURFACEDESC2);
+	SetSamplingParametersGL();
+	CheckGlError();
 
 	if(image.is_compressed())
 	{
 		glCompressedTexImage2DARB(GL_TEXTURE_2D, 0, image.get_format(),
 			image.get_width(), image.get_height(), 0, image.get_size(),
-			image.get_data());
+			nullptr);
 		CheckGlError();
 
 		for(int i = 0; i < image.get_num_mipmaps(); i++)
@@ -151,62 +159,205 @@ bool RGLTexture::CreateTextureAPI(const void* textureData,
 
 			glCompressedTexImage2DARB(GL_TEXTURE_2D, i + 1, image.get_format(),
 				mipmap.get_width(), mipmap.get_height(), 0, mipmap.get_size(),
-				mipmap);
+				nullptr);
 			CheckGlError();
 		}
 	}
 	else
 	{
 		glTexImage2D(GL_TEXTURE_2D, 0, image.get_components(), image.get_width(),
-			image.get_height(), 0, image.get_format(), GL_UNSIGNED_BYTE, image);
+			image.get_height(), 0, image.get_format(), GL_UNSIGNED_BYTE, nullptr);
 		CheckGlError();
 
 		for (int i = 0; i < image.get_num_mipmaps(); i++)
 		{
 			glTexImage2D(GL_TEXTURE_2D, i+1, image.get_components(),
 				image.get_mipmap(i).get_width(), image.get_mipmap(i).get_height(),
-				0, image.get_format(), GL_UNSIGNED_BYTE, image.get_mipmap(i));
+				0, image.get_format(), GL_UNSIGNED_BYTE, nullptr);
 			CheckGlError();
+		}
+	}
+
+	return true;
+}
+
+/**
+* Same as CreateStorageGL, but without binding the texture. Gets immutable storage for all levels.
+*/
+bool RGLTexture::CreateStorageDSA(nv_dds::CDDSImage& image)
+{
+	GLenum internalFormat = image.get_format();
+	if(!image.is_compressed())
+	{
+		switch(image.get_components())
+		{
+		case 1: internalFormat = GL_R8; break;
+		case 3: internalFormat = GL_RGB8; break;
+		case 4: internalFormat = GL_RGBA8; break;
 
+		default:
+			LogWarn() << "Unsupported number of texture-components: " << image.get_components();
+			return false;
 		}
 	}
 
-	IsFullyInitialized = true;
+	glCreateTextures(GL_TEXTURE_2D, 1, &TextureObject);
+	glTextureStorage2D(TextureObject, image.get_num_mipmaps() + 1, internalFormat, image.get_width(), image.get_height());
+	CheckGlError();
+
+	SetSamplingParametersGL();
+	CheckGlError();
 
 	return true;
 }
 
 /**
-* Updates a subresource with default usage
+* Fills the given level. Goes through the upload-ring if possible, directly from the given memory otherwise.
 */
-bool RGLTexture::UpdateSubresourceAPI(void* data, int mipLevel, int arrayIndex)
+void RGLTexture::WriteLevelGL(int level, const void* data, size_t size)
 {
-	glBindTexture(GL_TEXTURE_2D, TextureObject);
-	CheckGlError();
+	RGLUploadAllocation allocation;
+	if(!REngine::RenderingDevice->GetTextureUploader().Allocate(size, allocation))
+	{
+		UploadLevelGL(level, data, size);
+		return;
+	}
+
+	memcpy(allocation.Mapped, data, size);
+	UploadFromRingGL(level, allocation);
+}
+
+/**
+* Issues the upload of an allocation of the upload-ring into the given level
+*/
+void RGLTexture::UploadFromRingGL(int level, const RGLUploadAllocation& allocation)
+{
+	RGLTextureUploader& uploader = REngine::RenderingDevice->GetTextureUploader();
+
+	// With the ring bound, the data-pointer is taken as offset into it
+	uploader.BindForUpload();
+	UploadLevelGL(level, (const void*)allocation.Offset, allocation.Size);
+	uploader.UnbindForUpload();
+
+	uploader.Submit(allocation, this);
+
+	PendingUploads++;
+	IsFullyInitialized = false;
+}
+
+/**
+* Copies the texels of a whole level into the texture. The data is an offset into the pixel-unpack-buffer if one is bound.
+*/
+void RGLTexture::UploadLevelGL(int level, const void* data, size_t size)
+{
+	GLsizei width = std::max(1, Resolution.x >> level);
+	GLsizei height = std::max(1, Resolution.y >> level);
+
+	if(REngine::RenderingDevice->GetLimits().DirectStateAccess)
+	{
+		if(IsCompressed)
+			glCompressedTextureSubImage2D(TextureObject, level, 0, 0, width, height, GLTextureFormat, (GLsizei)size, data);
+		else
+			glTextureSubImage2D(TextureObject, level, 0, 0, width, height, GLTextureFormat, GL_UNSIGNED_BYTE, data);
+	}
+	else
+	{
+		REngine::RenderingDevice->GetStateCache().BindTextureForEdit(TextureObject);
+
+		if(IsCompressed)
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, GLTextureFormat, (GLsizei)size, data);
+		else
+			glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, GLTextureFormat, GL_UNSIGNED_BYTE, data);
+	}
 
-	glTexSubImage2D(GL_TEXTURE_2D, mipLevel, 0, 0, Resolution.x, Resolution.y, GLTextureFormat,
-		GLTextureType, data);
 	CheckGlError();
+}
+
+/**
+* Called by the upload-ring when the GPU is done with an upload of this
+*/
+void RGLTexture::OnUploadFinishedGL()
+{
+	if(PendingUploads > 0)
+		PendingUploads--;
+
+	if(PendingUploads == 0 && TextureObject)
+		IsFullyInitialized = true;
+}
+
+/**
+* Updates a subresource with default usage. The texture isn't ready again until the upload is done.
+*/
+bool RGLTexture::UpdateSubresourceAPI(void* data, int mipLevel, int arrayIndex)
+{
+	WriteLevelGL(mipLevel, data, ComputeSizeInBytes(mipLevel));
 	return true;
 }
 
 /**
-* Maps the texture for update. Only possible with the right CPU-Acces and usage-flags.
+* Maps the texture for update. Hands out space in the upload-ring, which may be written from any thread until
+* the texture is unmapped. Map and Unmap themselves have to be called from the thread owning the GL-Context.
 */
 bool RGLTexture::MapAPI(void ** dataOut, int subresource)
 {
-	// TODO: Implement
 	*dataOut = nullptr;
-	return false;
+
+	if(MappedUpload.Mapped)
+	{
+		LogWarn() << "Texture is already mapped";
+		return false;
+	}
+
+	if(!REngine::RenderingDevice->GetTextureUploader().Allocate(ComputeSizeInBytes(subresource), MappedUpload))
+		return false;
+
+	MappedSubresource = subresource;
+	*dataOut = MappedUpload.Mapped;
+	return true;
 }
 
 /**
-* Unmaps the texture
+* Unmaps the texture and starts uploading what was written
 */
 bool RGLTexture::UnmapAPI(int subresource)
 {
-	// TODO: Implement
-	return false;
+	if(!MappedUpload.Mapped || MappedSubresource != subresource)
+		return false;
+
+	UploadFromRingGL(subresource, MappedUpload);
+
+	MappedUpload = RGLUploadAllocation();
+	return true;
+}
+
+/**
+* Sets how the bound texture is sampled. Only done once, as these are stored with the texture-object.
+* A bound sampler-object replaces all of these, except the mip-range.
+*/
+void RGLTexture::SetSamplingParametersGL()
+{
+	bool dsa = REngine::RenderingDevice->GetLimits().DirectStateAccess;
+	auto parameteri = [&](GLenum name, GLint value)
+	{
+		if(dsa)
+			glTextureParameteri(TextureObject, name, value);
+		else
+			glTexParameteri(GL_TEXTURE_2D, name, value);
+	};
+
+	GLuint maxMip = std::max(1u, GetNumMipLevels()) - 1;
+	parameteri(GL_TEXTURE_MAX_LEVEL, maxMip);
+
+	parameteri(GL_TEXTURE_WRAP_S, GL_REPEAT);
+	parameteri(GL_TEXTURE_WRAP_T, GL_REPEAT);
+	parameteri(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	parameteri(GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+	GLfloat anisotropy = REngine::RenderingDevice->GetLimits().MaxAnisotropy / 2;
+	if(dsa)
+		glTextureParameterf(TextureObject, GL_TEXTURE_MAX_ANISOTROPY_EXT, anisotropy);
+	else
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, anisotropy);
 }
 
 /**
@@ -218,6 +369,20 @@ void RGLTexture::CleanAPI()
 
 	glDeleteTextures(1, &TextureObject);
 
+	if(REngine::RenderingDevice)
+	{
+		// Space still handed out would block the upload-ring forever
+		if(MappedUpload.Mapped)
+			REngine::RenderingDevice->GetTextureUploader().Submit(MappedUpload, nullptr);
+
+		REngine::RenderingDevice->GetStateCache().OnTextureDeleted(TextureObject);
+		REngine::RenderingDevice->GetTextureUploader().OnTextureDeleted(this);
+	}
+
+	TextureObject = 0;
+	PendingUploads = 0;
+	MappedUpload = RGLUploadAllocation();
+
 	// Reset this so we know this texture isn't valid anymore
 	SizeInBytes = 0;
 }
@@ -0,0 +1,227 @@
+#include "pch.h"
+#include "RGLTextureUploader.h"
+
+#ifdef RND_GL
+#include "Logger.h"
+#include "REngine.h"
+#include "RDevice.h"
+#include "RGLTexture.h"
+
+using namespace RAPI;
+
+// Allocations start at multiples of this, which is enough for every texel-format
+const size_t GL_TEXTURE_UPLOAD_ALIGNMENT = 256;
+
+RGLTextureUploader::RGLTextureUploader()
+{
+	Buffer = 0;
+	Mapped = nullptr;
+	Head = 0;
+}
+
+/**
+ * Creates the ring. Needs ARB_buffer_storage, uploads go directly from client memory without it.
+ */
+bool RGLTextureUploader::Init()
+{
+	if(!GLEW_ARB_buffer_storage)
+		return false;
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	RGLStateCache &stateCache = REngine::RenderingDevice->GetStateCache();
+
+	glGenBuffers(1, &Buffer);
+	stateCache.BindBuffer(GL_PIXEL_UNPACK_BUFFER, Buffer);
+	glBufferStorage(GL_PIXEL_UNPACK_BUFFER, GL_TEXTURE_UPLOAD_RING_SIZE, nullptr, flags);
+	Mapped = (uint8_t *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, GL_TEXTURE_UPLOAD_RING_SIZE, flags);
+	stateCache.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	CheckGlError();
+
+	if(!Mapped)
+	{
+		LogWarn() << "Failed to map the texture upload-ring, uploading from client memory";
+
+		glDeleteBuffers(1, &Buffer);
+		stateCache.OnBufferDeleted(Buffer);
+		Buffer = 0;
+		return false;
+	}
+
+	Head = 0;
+	return true;
+}
+
+/**
+ * Deletes the ring, after waiting for all uploads still in flight
+ */
+void RGLTextureUploader::Clear()
+{
+	while(!Uploads.empty())
+	{
+		if(Uploads.front().Fence)
+			RetireOldest(true);
+		else
+			Uploads.pop_front();
+	}
+
+	if(Buffer)
+	{
+		// Deleting the buffer unmaps it as well
+		glDeleteBuffers(1, &Buffer);
+
+		if(REngine::RenderingDevice)
+			REngine::RenderingDevice->GetStateCache().OnBufferDeleted(Buffer);
+	}
+
+	Buffer = 0;
+	Mapped = nullptr;
+	Head = 0;
+}
+
+/**
+ * Hands out ring-space for the given number of bytes. Waits for earlier uploads if the ring is full.
+ */
+bool RGLTextureUploader::Allocate(size_t size, RGLUploadAllocation &allocation)
+{
+	GLintptr alignedSize = (GLintptr)((size + GL_TEXTURE_UPLOAD_ALIGNMENT - 1) / GL_TEXTURE_UPLOAD_ALIGNMENT * GL_TEXTURE_UPLOAD_ALIGNMENT);
+	const GLintptr ringSize = (GLintptr)GL_TEXTURE_UPLOAD_RING_SIZE;
+
+	if(!IsEnabled() || alignedSize > ringSize)
+		return false;
+
+	GLintptr offset = -1;
+	while(offset < 0)
+	{
+		if(Uploads.empty())
+		{
+			offset = 0;
+			break;
+		}
+
+		// Free space is everything from the head up to the oldest upload. Never let the head catch up
+		// with it, as the ring would look empty then.
+		GLintptr tail = Uploads.front().Begin;
+		if(Head > tail)
+		{
+			if(Head + alignedSize <= ringSize)
+				offset = Head;
+			else if(alignedSize < tail)
+				offset = 0;
+		}
+		else if(Head + alignedSize < tail)
+		{
+			offset = Head;
+		}
+
+		// Only waits if the GPU is behind by a whole ring
+		if(offset < 0 && !RetireOldest(true))
+			return false;
+	}
+
+	Upload u;
+	u.Begin = offset;
+	u.End = offset + alignedSize;
+	u.Fence = nullptr;
+	u.Texture = nullptr;
+	Uploads.push_back(u);
+
+	Head = u.End;
+
+	allocation.Mapped = Mapped + offset;
+	allocation.Offset = offset;
+	allocation.Size = size;
+	return true;
+}
+
+/**
+ * Binds the ring as pixel-unpack-buffer, so the offset of an allocation can be used as data-pointer
+ */
+void RGLTextureUploader::BindForUpload()
+{
+	REngine::RenderingDevice->GetStateCache().BindBuffer(GL_PIXEL_UNPACK_BUFFER, Buffer);
+}
+
+/**
+ * Unbinds the ring again. Uploads from client memory would read from the ring otherwise.
+ */
+void RGLTextureUploader::UnbindForUpload()
+{
+	REngine::RenderingDevice->GetStateCache().BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+/**
+ * Must be called after the upload-calls reading the allocation were issued
+ */
+void RGLTextureUploader::Submit(const RGLUploadAllocation &allocation, RGLTexture *texture)
+{
+	// Usually the newest one
+	for(auto it = Uploads.rbegin(); it != Uploads.rend(); ++it)
+	{
+		if((*it).Begin != allocation.Offset || (*it).Fence)
+			continue;
+
+		(*it).Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		(*it).Texture = texture;
+		return;
+	}
+
+	LogWarn() << "Submitted texture upload which wasn't allocated";
+}
+
+/**
+ * Checks the fences of the uploads in flight, without waiting
+ */
+void RGLTextureUploader::Update()
+{
+	while(!Uploads.empty() && Uploads.front().Fence && RetireOldest(false));
+}
+
+/**
+ * Forgets about uploads of the given texture
+ */
+void RGLTextureUploader::OnTextureDeleted(RGLTexture *texture)
+{
+	for(Upload &u : Uploads)
+	{
+		if(u.Texture == texture)
+			u.Texture = nullptr;
+	}
+}
+
+/**
+ * Finishes the oldest upload, waiting for it if needed.
+ * Returns false if it wasn't submitted or done yet.
+ */
+bool RGLTextureUploader::RetireOldest(bool wait)
+{
+	Upload &u = Uploads.front();
+	if(!u.Fence)
+		return false;
+
+	GLenum r;
+	do
+	{
+		r = glClientWaitSync(u.Fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000 : 0);
+	} while(wait && r == GL_TIMEOUT_EXPIRED);
+
+	if(r == GL_TIMEOUT_EXPIRED)
+		return false;
+
+	if(r == GL_WAIT_FAILED)
+		LogWarn() << "Waiting for texture upload failed";
+
+	glDeleteSync(u.Fence);
+
+	if(u.Texture)
+		u.Texture->OnUploadFinishedGL();
+
+	Uploads.pop_front();
+
+	if(Uploads.empty())
+		Head = 0;
+
+	return true;
+}
+
+#endif
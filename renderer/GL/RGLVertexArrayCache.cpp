@@ -0,0 +1,195 @@
+#include "pch.h"
+#include "RGLVertexArrayCache.h"
+
+#ifdef RND_GL
+#include "Logger.h"
+#include "RTools.h"
+#include "REngine.h"
+#include "RDevice.h"
+#include "RBuffer.h"
+#include "RInputLayout.h"
+
+using namespace RAPI;
+
+size_t RGLVertexArrayKeyHash::operator()(const RGLVertexArrayKey &key) const
+{
+	return RTools::HashObject(key);
+}
+
+/**
+ * Returns the VAO for the given buffers and layout, creating it if needed.
+ * Leaves it bound in the state cache.
+ */
+GLuint RGLVertexArrayCache::BindVertexArray(const RInputLayout *inputLayout, RBuffer *vertexBuffer0, RBuffer *vertexBuffer1, RBuffer *indexBuffer)
+{
+	RGLStateCache &stateCache = REngine::RenderingDevice->GetStateCache();
+
+	RGLVertexArrayKey key;
+	key.InputLayout = inputLayout;
+
+	RBuffer *vertexBuffers[] = {vertexBuffer0, vertexBuffer1};
+	for(int i = 0; i < 2; i++)
+	{
+		if(!vertexBuffers[i])
+			continue;
+
+		key.VertexBuffers[i] = vertexBuffers[i]->GetBufferObjectAPI();
+		key.VertexBufferOffsets[i] = vertexBuffers[i]->GetBindOffsetAPI();
+		key.VertexBufferStrides[i] = (GLsizei)vertexBuffers[i]->GetStructuredByteSize();
+	}
+
+	if(indexBuffer)
+		key.IndexBuffer = indexBuffer->GetBufferObjectAPI();
+
+	auto it = VertexArrays.find(key);
+	if(it != VertexArrays.end())
+	{
+		stateCache.BindVertexArray((*it).second);
+		return (*it).second;
+	}
+
+	GLuint vao;
+	glGenVertexArrays(1, &vao);
+	CheckGlError();
+
+	stateCache.BindVertexArray(vao);
+
+	// The indexbuffer-binding is part of the VAO
+	stateCache.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, key.IndexBuffer);
+
+	if(inputLayout && key.VertexBuffers[0])
+		SpecifyAttributes(key);
+
+	VertexArrays[key] = vao;
+	return vao;
+}
+
+/**
+ * Points the attributes of the bound VAO to the buffers of the key
+ */
+bool RGLVertexArrayCache::SpecifyAttributes(const RGLVertexArrayKey &key)
+{
+	RGLStateCache &stateCache = REngine::RenderingDevice->GetStateCache();
+
+	// Get input element desc
+	const INPUT_ELEMENT_DESC *desc = key.InputLayout->GetInputElementDesc();
+
+	size_t offset = 0;
+	for(unsigned int i = 0; i < key.InputLayout->GetNumInputDescElements(); i++)
+	{
+		const INPUT_ELEMENT_DESC &d = desc[i];
+
+		// Bind main vertex-buffer or instance buffer depending on the slot
+		// TODO: Allow for multiple buffers
+		int slot = d.InputSlot == 0 ? 0 : 1;
+
+		// Restart offset in case we are at a new buffer
+		if(i > 0 && offset != 0 && d.InputSlot != 0 && desc[i - 1].InputSlot == 0)
+			offset = 0;
+
+		// Instance-data without an instancebuffer is left at the default attribute-values
+		if(!key.VertexBuffers[slot])
+			continue;
+
+		glEnableVertexAttribArray(i);
+		CheckGlError();
+
+		stateCache.BindBuffer(GL_ARRAY_BUFFER, key.VertexBuffers[slot]);
+		GLsizei stride = key.VertexBufferStrides[slot];
+		GLintptr base = key.VertexBufferOffsets[slot];
+
+		// Use instancing if we got a slot more than 1
+		// FIXME: Need to give an option for these for multiple vertex buffers...
+		glVertexAttribDivisor(i, d.InputSlot > 0 ? 1 : 0);
+
+		// Unpack the formats
+		switch(d.Format)
+		{
+		case FORMAT_R32G32B32A32_FLOAT:
+			glVertexAttribPointer(i, 4, GL_FLOAT, GL_FALSE, stride, (void *)(base + offset));
+			offset += sizeof(float) * 4;
+			break;
+
+		case FORMAT_R32G32B32_FLOAT:
+			glVertexAttribPointer(i, 3, GL_FLOAT, GL_FALSE, stride, (void *)(base + offset));
+			offset += sizeof(float) * 3;
+			break;
+
+		case FORMAT_R32G32_FLOAT:
+			glVertexAttribPointer(i, 2, GL_FLOAT, GL_FALSE, stride, (void *)(base + offset));
+			offset += sizeof(float) * 2;
+			break;
+
+		case FORMAT_R8G8B8A8_UNORM:
+			glVertexAttribPointer(i, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void *)(base + offset));
+			offset += sizeof(uint32_t);
+			break;
+
+		default:
+			LogWarnBox() << "Unknown INPUT_ELEMENT_DESC-Format: " << d.Format;
+			return false;
+		}
+
+		CheckGlError();
+	}
+
+	return true;
+}
+
+/**
+ * Deletes all VAOs the given function returns true for
+ */
+template<typename Fn>
+void RGLVertexArrayCache::DeleteWhere(Fn fn)
+{
+	for(auto it = VertexArrays.begin(); it != VertexArrays.end();)
+	{
+		if(!fn((*it).first))
+		{
+			++it;
+			continue;
+		}
+
+		glDeleteVertexArrays(1, &(*it).second);
+
+		if(REngine::RenderingDevice)
+			REngine::RenderingDevice->GetStateCache().OnVertexArrayDeleted((*it).second);
+
+		it = VertexArrays.erase(it);
+	}
+}
+
+/**
+ * Must be called when deleting objects, to drop the VAOs using them. GL reuses the names.
+ */
+void RGLVertexArrayCache::OnBufferDeleted(GLuint buffer)
+{
+	if(VertexArrays.empty())
+		return;
+
+	DeleteWhere([buffer](const RGLVertexArrayKey &key)
+				{
+					return key.VertexBuffers[0] == buffer || key.VertexBuffers[1] == buffer || key.IndexBuffer == buffer;
+				});
+}
+
+void RGLVertexArrayCache::OnInputLayoutDeleted(const RInputLayout *inputLayout)
+{
+	DeleteWhere([inputLayout](const RGLVertexArrayKey &key)
+				{
+					return key.InputLayout == inputLayout;
+				});
+}
+
+/**
+ * Deletes all VAOs
+ */
+void RGLVertexArrayCache::Clear()
+{
+	DeleteWhere([](const RGLVertexArrayKey &)
+				{
+					return true;
+				});
+}
+
+#endif
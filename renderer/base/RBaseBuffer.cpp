@@ -5,6 +5,11 @@ using namespace RAPI;
 
 RBaseBuffer::RBaseBuffer()
 {
+	SizeInBytes = 0;
+	StructuredByteSize = 0;
+	BindFlags = EBindFlags::B_VERTEXBUFFER;
+	Usage = EUsageFlags::U_DEFAULT;
+	CpuAccess = ECPUAccessFlags::CA_NONE;
 }
 
 
@@ -6,9 +6,16 @@ using namespace RAPI;
 RBaseDevice::RBaseDevice()
 {
     FrameCounter = 0;
+    ApplicationFrameCounter = 0;
     QueuedDrawCallCounter = 0;
     QueueCounter = 0;
     DoDrawcalls = true;
+    FrameInFlight = false;
+    FrameDataHandedOff = false;
+    StopRenderThread = false;
+    QueueSequenceCounter = 0;
+    PendingCapture = nullptr;
+    ActiveCapture = nullptr;
 
     SetMainClearValues(RFloat4(0.2f, 0.2f, 0.2f, 0), 1.0f);
 }
@@ -18,3 +25,23 @@ RBaseDevice::~RBaseDevice()
 {
 }
 
+RRenderQueue::RRenderQueue()
+{
+    SortQueue = false;
+    InUse = false;
+    Persistent = false;
+    Priority = 0;
+    Sequence = 0;
+    SortTimeMS = 0.0;
+    ProcessTimeMS = 0.0;
+    StatsPending = false;
+    UsesCommandLists = false;
+    ProcessState = RQS_NotProcessed;
+}
+
+RRenderQueue::~RRenderQueue()
+{
+    for(RRenderQueueAppendBuffer *b : ThreadQueues)
+        delete b;
+}
+
@@ -13,6 +13,8 @@ RBaseTexture::RBaseTexture()
 	UsageFlags = EUsageFlags::U_DEFAULT;
 	IsFullyInitialized = false;
 	MemoryContainsDDSHeader = false;
+	ArraySize = 1;
+	Resolution = RInt2(0, 0);
 }
 
 
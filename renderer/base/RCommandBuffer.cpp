@@ -0,0 +1,125 @@
+#include "pch.h"
+#include "RCommandBuffer.h"
+#include "RDrawPackets.h"
+#include "RBuffer.h"
+#include <assert.h>
+
+using namespace RAPI;
+
+RCommandBuffer::RCommandBuffer()
+{
+	NumCommands = 0;
+}
+
+/**
+ * Returns true if any of the given resources is set
+ */
+template<typename T>
+static bool HasAnyResource(const std::array<T *, RAPI_MAX_NUM_SHADER_RESOURCES> &resources)
+{
+	for(T *r : resources)
+	{
+		if(r)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * Returns true if any of the given changes is set
+ */
+static bool HasAnyChange(const RStateMachine::ChangesStruct &c)
+{
+	bool any = c.PrimitiveType || c.RasterizerState || c.BlendState || c.DepthStencilState || c.SamplerState
+			   || c.IndexBuffer || c.PixelShader || c.VertexShader || c.InputLayout || c.MainTexture || c.Viewport
+			   || c.VertexBuffers[0] || c.VertexBuffers[1];
+
+	for(int i = 0; i < EShaderType::ST_NUM_SHADER_TYPES; i++)
+		any = any || c.ConstantBuffers[i] || c.StructuredBuffers[i];
+
+	return any;
+}
+
+/**
+ * Records the state-changes and the drawcall for the packet at the given index.
+ * Different buffers can be recorded from different threads at the same time.
+ */
+void RCommandBuffer::RecordDrawPacket(const RDrawPackets &packets, size_t index,
+									  const RStateMachine::ChangesStruct &changes, RStateMachine &stateMachine)
+{
+	const RCmdDraw &draw = packets.DrawParams[index];
+
+	// Only look into the state if something has to be bound from it
+	if(HasAnyChange(changes))
+		stateMachine.SetFromPipelineState(packets.States[index], changes);
+
+	const RPipelineStateFull &fs = stateMachine.GetCurrentState();
+
+#ifndef PUBLIC_RELEASE
+	// Do the safety checks here, so they don't cost anything on the thread doing the API-Calls
+	if(fs.VertexBuffers[0] && fs.VertexBuffers[0]->GetStructuredByteSize())
+	{
+		size_t numBufferElements = fs.VertexBuffers[0]->GetSizeInBytes() / fs.VertexBuffers[0]->GetStructuredByteSize();
+		assert(numBufferElements >= draw.NumDrawElements + draw.StartVertexOffset);
+	}
+#endif
+
+	if(changes.RasterizerState)
+		Push<RCmdSetObject>(CO_SetRasterizerState).Object = fs.RasterizerState;
+
+	if(changes.BlendState)
+		Push<RCmdSetObject>(CO_SetBlendState).Object = fs.BlendState;
+
+	if(changes.DepthStencilState)
+		Push<RCmdSetObject>(CO_SetDepthStencilState).Object = fs.DepthStencilState;
+
+	if(changes.SamplerState)
+		Push<RCmdSetObject>(CO_SetSamplerState).Object = fs.SamplerState;
+
+	if(changes.Viewport)
+		Push<RCmdSetObject>(CO_SetViewport).Object = fs.Viewport;
+
+	if(changes.VertexBuffers[0] || changes.VertexBuffers[1] || changes.InputLayout)
+	{
+		RCmdSetVertexBuffers &vb = Push<RCmdSetVertexBuffers>(CO_SetVertexBuffers);
+		vb.VertexBuffers[0] = fs.VertexBuffers[0];
+		vb.VertexBuffers[1] = fs.VertexBuffers[1];
+		vb.InputLayout = fs.InputLayout;
+	}
+
+	if(changes.IndexBuffer)
+		Push<RCmdSetObject>(CO_SetIndexBuffer).Object = fs.IndexBuffer;
+
+	if(changes.VertexShader || changes.PixelShader)
+	{
+		RCmdSetShaders &s = Push<RCmdSetShaders>(CO_SetShaders);
+		s.State = (RPipelineState *)packets.States[index];
+		s.VertexShader = fs.VertexShader;
+		s.PixelShader = fs.PixelShader;
+	}
+
+	for(uint8_t i = 0; i < EShaderType::ST_NUM_SHADER_TYPES; i++)
+	{
+		// Textures only have a single change-flag for all stages, so skip the empty ones
+		if(changes.MainTexture && HasAnyResource(fs.Textures[i]))
+			Push<RCmdSetTextures>(CO_SetTextures, i).Textures = fs.Textures[i];
+
+		if(changes.ConstantBuffers[i])
+			Push<RCmdSetBuffers>(CO_SetConstantBuffers, i).Buffers = fs.ConstantBuffers[i];
+
+		if(changes.StructuredBuffers[i])
+			Push<RCmdSetBuffers>(CO_SetStructuredBuffers, i).Buffers = fs.StructuredBuffers[i];
+	}
+
+	Push<RCmdDraw>(CO_Draw) = draw;
+}
+
+/**
+ * Throws away all recorded commands, but keeps the memory
+ */
+void RCommandBuffer::Reset()
+{
+	Data.clear();
+	NumCommands = 0;
+}
@@ -0,0 +1,129 @@
+#include "pch.h"
+#include "RDrawPackets.h"
+#include <algorithm>
+
+using namespace RAPI;
+
+/**
+ * Appends all packets of the other list
+ */
+void RDrawPackets::Append(const RDrawPackets &other)
+{
+	SortKeys.insert(SortKeys.end(), other.SortKeys.begin(), other.SortKeys.end());
+	Keys.insert(Keys.end(), other.Keys.begin(), other.Keys.end());
+	ResourceTableHashes.insert(ResourceTableHashes.end(), other.ResourceTableHashes.begin(), other.ResourceTableHashes.end());
+	DrawParams.insert(DrawParams.end(), other.DrawParams.begin(), other.DrawParams.end());
+	States.insert(States.end(), other.States.begin(), other.States.end());
+}
+
+/**
+ * Throws away all packets, but keeps the memory
+ */
+void RDrawPackets::Clear()
+{
+	SortKeys.clear();
+	Keys.clear();
+	ResourceTableHashes.clear();
+	DrawParams.clear();
+	States.clear();
+}
+
+/**
+ * Moves the elements of v into the given order
+ */
+template<typename T>
+static void Permute(std::vector<T> &v, const std::vector<uint64_t> &order)
+{
+	std::vector<T> sorted(v.size());
+	for(size_t i = 0; i < order.size(); i++)
+		sorted[i] = v[(uint32_t)order[i]];
+
+	v.swap(sorted);
+}
+
+/**
+ * Sorts the packets by their sort-key. Packets with the same key keep their order.
+ */
+void RDrawPackets::Sort()
+{
+	// Sort key in the upper half, original index in the lower one. Makes the sort
+	// stable and only moves plain integers around.
+	std::vector<uint64_t> order(SortKeys.size());
+	for(size_t i = 0; i < SortKeys.size(); i++)
+		order[i] = ((uint64_t)SortKeys[i] << 32) | (uint64_t)i;
+
+	std::sort(order.begin(), order.end());
+
+	for(size_t i = 0; i < order.size(); i++)
+		SortKeys[i] = (uint32_t)(order[i] >> 32);
+
+	Permute(Keys, order);
+	Permute(ResourceTableHashes, order);
+	Permute(DrawParams, order);
+	Permute(States, order);
+}
+
+/**
+ * Computes the changes needed to go from the previous packet to the given one.
+ * The first packet gets everything it uses set.
+ */
+void RDrawPackets::ComputeChanges(size_t index, RStateMachine::ChangesStruct &changes) const
+{
+	memset(&changes, 0, sizeof(changes));
+
+	const RPipelineState::IDStruct &k = Keys[index];
+	const RPipelineState *s = States[index];
+
+	if(index == 0) {
+		changes.PrimitiveType = true;
+		changes.RasterizerState = true;
+		changes.BlendState = true;
+		changes.DepthStencilState = true;
+		changes.SamplerState = true;
+		changes.IndexBuffer = true;
+		changes.VertexBuffers[0] = true;
+		changes.VertexBuffers[1] = true;
+		changes.VertexShader = true;
+		changes.PixelShader = true;
+		changes.InputLayout = true;
+		changes.Viewport = true;
+
+		for(int i = 0; i < EShaderType::ST_NUM_SHADER_TYPES; i++) {
+			changes.ConstantBuffers[i] = s->_NumConstantBuffers[i] != 0;
+			changes.StructuredBuffers[i] = s->_NumStructuredBuffers[i] != 0;
+			changes.MainTexture = changes.MainTexture || s->_NumTextures[i] != 0;
+		}
+
+		return;
+	}
+
+	const RPipelineState::IDStruct &p = Keys[index - 1];
+
+	changes.PrimitiveType = k.PrimitiveType != p.PrimitiveType;
+	changes.RasterizerState = k.RasterizerState != p.RasterizerState;
+	changes.BlendState = k.BlendState != p.BlendState;
+	changes.DepthStencilState = k.DepthStencilState != p.DepthStencilState;
+	changes.SamplerState = k.SamplerState != p.SamplerState;
+	changes.IndexBuffer = k.IndexBuffer != p.IndexBuffer;
+	changes.VertexBuffers[0] = k.VertexBuffer0 != p.VertexBuffer0;
+	changes.VertexBuffers[1] = k.VertexBuffer1 != p.VertexBuffer1;
+	changes.VertexShader = k.VertexShader != p.VertexShader;
+	changes.PixelShader = k.PixelShader != p.PixelShader;
+	changes.InputLayout = k.InputLayout != p.InputLayout;
+	changes.Viewport = k.ViewportID != p.ViewportID;
+
+	// Only go to the states themselves if any of the tables changed. Tables which are empty
+	// on the new state keep whatever was bound before.
+	if(ResourceTableHashes[index] == ResourceTableHashes[index - 1])
+		return;
+
+	const RPipelineState *ps = States[index - 1];
+	for(int i = 0; i < EShaderType::ST_NUM_SHADER_TYPES; i++) {
+		changes.ConstantBuffers[i] = s->_NumConstantBuffers[i]
+									 && s->_ConstantBuffersHash[i] != ps->_ConstantBuffersHash[i];
+		changes.StructuredBuffers[i] = s->_NumStructuredBuffers[i]
+									   && s->_StructuredBuffersHash[i] != ps->_StructuredBuffersHash[i];
+		changes.MainTexture = changes.MainTexture
+							  || (s->_NumTextures[i] && s->_TexturesHash[i] != ps->_TexturesHash[i]);
+	}
+}
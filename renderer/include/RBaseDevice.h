@@ -3,19 +3,117 @@
 #include "RResourceCache.h"
 #include "RStateMachine.h"
 #include "RProfiler.h"
+#include "RDrawPackets.h"
+#include <atomic>
+#include <condition_variable>
 
 namespace RAPI {
+	typedef unsigned int RRenderQueueID;
+
+/**
+ * Where a renderqueue is in its processing on the threadpool
+ */
+	enum ERenderQueueState {
+		RQS_NotProcessed,
+		RQS_WaitingForDependencies,
+		RQS_Processing,
+		RQS_Processed
+	};
+
+/**
+ * States a single thread has put into a renderqueue. Only that thread touches it until the queue gets merged.
+ */
+	struct RRenderQueueAppendBuffer {
+		RRenderQueueAppendBuffer() : NumQueued(0) {}
+
+		// States queued by the thread
+		RDrawPackets Packets;
+
+		// Number of packets, readable by other threads for the statistics
+		std::atomic<unsigned int> NumQueued;
+
+		// Keep the buffers of different threads on different cachelines
+		char Padding[64];
+	};
+
+/**
+ * How recording a single commandlist of a queue went
+ */
+	struct RCommandListStats {
+		RCommandListStats() : NumStates(0), EstimatedCost(0), RecordingTimeMS(0.0) {}
+
+		// Number of states recorded into the commandlist
+		unsigned int NumStates;
+
+		// Sum of the estimated costs the slice was picked by
+		uint64_t EstimatedCost;
+
+		// Time the worker needed to record it
+		double RecordingTimeMS;
+	};
+
+/**
+ * Counts and timings of a renderqueue: The values of its last flush, plus totals over all flushes.
+ * Registered queues keep these for the whole program, acquired ones start over when acquired.
+ */
+	struct RRenderQueueStats {
+		RRenderQueueStats() : NumDraws(0), SortTimeMS(0.0), ProcessTimeMS(0.0), FlushTimeMS(0.0),
+							  NumFlushes(0), TotalDraws(0), TotalSortTimeMS(0.0), TotalProcessTimeMS(0.0),
+							  TotalFlushTimeMS(0.0) {}
+
+		// Last flush
+		unsigned int NumDraws;
+		double SortTimeMS;
+		double ProcessTimeMS;
+		double FlushTimeMS;
+
+		// Summed up over all flushes
+		unsigned int NumFlushes;
+		uint64_t TotalDraws;
+		double TotalSortTimeMS;
+		double TotalProcessTimeMS;
+		double TotalFlushTimeMS;
+
+		/**
+		 * Makes the last-flush values of the given stats the ones of these and adds them to the totals
+		 */
+		void AddFlush(const RRenderQueueStats &flush) {
+			NumDraws = flush.NumDraws;
+			SortTimeMS = flush.SortTimeMS;
+			ProcessTimeMS = flush.ProcessTimeMS;
+			FlushTimeMS = flush.FlushTimeMS;
+
+			NumFlushes++;
+			TotalDraws += NumDraws;
+			TotalSortTimeMS += SortTimeMS;
+			TotalProcessTimeMS += ProcessTimeMS;
+			TotalFlushTimeMS += FlushTimeMS;
+		}
+	};
+
 /**
  * Simple renderqueue to hold states for a stage 
  */
 	struct RRenderQueue {
-		// Vector holding the pipeline states to draw
-		std::vector<const RPipelineState *> Queue;
+		RRenderQueue();
+
+		~RRenderQueue();
 
-		// This will have the same size as the Queue after processing this renderqueue is done
+		// The pipeline states to draw, split up into the parts sorting, diffing and drawing need
+		RDrawPackets Packets;
+
+		// One buffer per worker of the threadpool, the last one belongs to the thread owning the device.
+		// Their contents get moved into Packets when the queue is processed or flushed.
+		std::vector<RRenderQueueAppendBuffer *> ThreadQueues;
+
+		// This will have the same size as Packets after processing this renderqueue is done
 		// and contain the changes from the i-1'th pipeline-state to the i'th.
 		std::vector<RStateMachine::ChangesStruct> Changes;
 
+		// Estimated cost of recording each of the states, filled together with Changes.
+		// Used to give every thread about the same amount of work.
+		std::vector<unsigned int> StateCosts;
+
 #ifndef PUBLIC_RELASE
 		// TODO: Debug, take out!
 		std::vector<class GBaseDrawable *> Sources;
@@ -27,20 +125,54 @@ namespace RAPI {
 		// Flag if this queue is free
 		bool InUse;
 
-		// Same size as threads in the thread pool. Will contain the finished commandlists
-		// for this queue after processing.
+		// Set for queues made by RegisterRenderQueue. These stay in use and keep their slot until unregistered.
+		bool Persistent;
+
+		// Queues get submitted by ascending priority. Equal ones in the order they were acquired or registered.
+		int Priority;
+		uint64_t Sequence;
+
+		// Statistics, and the timings of the current use which go into them when flushing.
+		// Registered queues also add each flush to the device's stats of their slot, StatsPending is set until then.
+		RRenderQueueStats Stats;
+		bool StatsPending;
+		double SortTimeMS;
+		double ProcessTimeMS;
+
+		// Views the queue gets drawn into, one after another. Empty draws it once with the states own resources.
+		// Cleared when the queue is flushed.
+		std::vector<RViewOverrides> Views;
+
+		// Same size as threads in the thread pool, times the number of views. Will contain the finished commandlists
+		// for this queue after processing, view by view. The lists are kept around and reused every frame.
 		std::vector<class RCommandList *> QueueCommandLists;
+
+		// Whether the commandlists were recorded for this frame
+		bool UsesCommandLists;
 		std::vector<std::future<void>> QueueCommandListFutures;
 
+		// Statistics for each of the commandlists, valid once they are finished
+		std::vector<RCommandListStats> CommandListStats;
+
 		// Generation of changes and commandlists can be multithreaded. Use this to determine if the process was completed.
+		std::promise<void> ProcessedPromise;
 		std::future<void> ProcessedFuture;
 
+		// Queues which have to be processed and submitted before this one. Cleared when the queue is flushed.
+		std::vector<RRenderQueueID> Dependencies;
+
+		// Queues which depend on this one
+		std::vector<RRenderQueue *> Dependents;
+
+		// Processing state and the dependencies which still need to finish processing.
+		// Both are guarded by the devices QueueScheduleMutex.
+		ERenderQueueState ProcessState;
+		std::vector<RRenderQueue *> PendingDependencies;
+
 		// Name of this queue
 		std::string Name;
 	};
 
-	typedef unsigned int RRenderQueueID;
-
 	class RBaseDevice {
 	public:
 		RBaseDevice();
@@ -53,7 +185,8 @@ namespace RAPI {
 		const RInt2 &GetOutputResolution() { return OutputResolution; }
 
 		/**
-         * Access to the underlaying state machine
+         * Access to the state machine to build pipeline-states with. Belongs to the application, the device
+         * itself draws with a state machine of its own.
          */
 		RStateMachine &GetStateMachine() { return StateMachine; }
 
@@ -77,21 +210,60 @@ namespace RAPI {
 		// Output resolution of backbuffer
 		RInt2 OutputResolution;
 
-		// State machine for the device. Helps to reduce unneeded statechanges.
+		// State machine handed out to build pipeline-states with
 		RStateMachine StateMachine;
 
-		// Counter of how many frames since the start of the program have been rendered
-		unsigned int FrameCounter;
+		// Mirrors what is bound on the API-Context, to reduce unneeded statechanges. Only touched by the thread
+		// drawing the frame, which is the render thread while frames are pipelined.
+		RStateMachine ContextStateMachine;
+
+		// Contexts to build draws on, one per worker of the threadpool plus one for the other threads
+		std::vector<class RDrawContext *> DrawContexts;
+
+		// Counter of how many frames since the start of the program have been presented. Written by the
+		// thread presenting, read from all of them.
+		std::atomic<unsigned int> FrameCounter;
+
+		// Counter of how many frames the application has finished building. Only used by the application thread.
+		unsigned int ApplicationFrameCounter;
 
-		// Counter of drawcalls queued
-		unsigned int QueuedDrawCallCounter;
+		// Counter of drawcalls queued. States still sitting in the per-thread buffers of the queues aren't included.
+		std::atomic<unsigned int> QueuedDrawCallCounter;
 
 		// Counter of active queues
-		unsigned int QueueCounter;
+		std::atomic<unsigned int> QueueCounter;
 
 		// Queued drawcalls
 		std::vector<RRenderQueue *> RenderQueue;
 
+		// Set of queues the render thread is working on, when frames are pipelined
+		std::vector<RRenderQueue *> SubmittedRenderQueue;
+
+		// Statistics of the registered queues by slot. Both queues of a slot add their flushes to these, always
+		// on the application thread, so they count every frame even when the sets get swapped.
+		std::vector<RRenderQueueStats> RegisteredQueueStats;
+
+		// Slots in RenderQueue which can be acquired
+		std::vector<RRenderQueueID> FreeRenderQueues;
+
+		// Counts up with every acquired or registered queue, to order queues of the same priority
+		uint64_t QueueSequenceCounter;
+
+		// Guards the processing states of the queues
+		std::mutex QueueScheduleMutex;
+
+		// Thread flushing and presenting frames, when they are pipelined. The flags are guarded by the mutex.
+		std::thread RenderThread;
+		std::mutex RenderThreadMutex;
+		std::condition_variable RenderThreadCV;
+		bool FrameInFlight;
+		bool FrameDataHandedOff;
+		bool StopRenderThread;
+
+		// Capture requested for the next frame and the one recording the frame currently being flushed
+		std::atomic<class RFrameCapture *> PendingCapture;
+		class RFrameCapture *ActiveCapture;
+
 		// Values to clear the main buffers with when a new frame is started
 		RFloat4 MainColorBufferClearColor;
 		float MainDepthBufferClearZ;
@@ -11,6 +11,18 @@ namespace RAPI
 
 		virtual ~RBaseShader();
 
+		/**
+		 * Getters
+		 */
+		const std::string &GetShaderFile() const
+		{ return ShaderFile; }
+
+		const std::vector<std::vector<std::string>> &GetDefinitions() const
+		{ return Definitions; }
+
+		bool IsLoadedFromMemory() const
+		{ return IsFromMemory; }
+
 	protected:
 		// Path to the shaderfile this holds or sourcecode, if this was loaded from memory
 		std::string ShaderFile;
@@ -56,6 +56,9 @@ namespace RAPI
 		EUsageFlags GetUsageFlags()
 		{ return UsageFlags; }
 
+		unsigned int GetArraySize()
+		{ return ArraySize; }
+
 	protected:
 		// Size of the whole texture in bytes
 		uint32_t SizeInBytes;
@@ -51,6 +51,11 @@ namespace RAPI
 		 */
 		bool UpdateData(const void *data, size_t dataSize = 0);
 
+		/**
+		 * Copies the contents of this buffer back to the CPU. Stalls until the GPU is done with it,
+		 * so this is only meant for tools like the frame-capture.
+		 */
+		bool ReadBack(std::vector<uint8_t> &data);
 
 		/**
 		 * Deletes all resources this holds but keeps the object around.
@@ -0,0 +1,177 @@
+#pragma once
+#include "pch.h"
+#include "RStateMachine.h"
+
+namespace RAPI
+{
+	struct RDrawPackets;
+
+	/**
+	 * Operations a software commandbuffer can hold
+	 */
+	enum ECommandOp : uint8_t
+	{
+		CO_SetRasterizerState,
+		CO_SetBlendState,
+		CO_SetDepthStencilState,
+		CO_SetSamplerState,
+		CO_SetViewport,
+		CO_SetVertexBuffers,
+		CO_SetIndexBuffer,
+		CO_SetShaders,
+		CO_SetTextures,
+		CO_SetConstantBuffers,
+		CO_SetStructuredBuffers,
+		CO_Draw
+	};
+
+	/**
+	 * Header in front of every command. Size is the total size of the command
+	 * including this header, in multiples of the header size.
+	 */
+	struct RCommandHeader
+	{
+		ECommandOp Op;
+		uint8_t Stage;
+		uint16_t Size;
+		uint32_t Padding;
+	};
+
+	/** Payload of the state-ops which only bind a single object (Rasterizer-, Blend-, Sampler-State, ...) */
+	struct RCmdSetObject
+	{
+		void *Object;
+	};
+
+	/** Payload of CO_SetVertexBuffers. The layout is in here since some APIs combine all three. */
+	struct RCmdSetVertexBuffers
+	{
+		class RBuffer *VertexBuffers[2];
+		class RInputLayout *InputLayout;
+	};
+
+	/** Payload of CO_SetShaders. The state is there for APIs keeping the linked program in it. */
+	struct RCmdSetShaders
+	{
+		struct RPipelineState *State;
+		class RVertexShader *VertexShader;
+		class RPixelShader *PixelShader;
+	};
+
+	/** Payload of CO_SetTextures. Stage is stored in the header. */
+	struct RCmdSetTextures
+	{
+		std::array<class RTexture *, RAPI_MAX_NUM_SHADER_RESOURCES> Textures;
+	};
+
+	/** Payload of CO_SetConstantBuffers and CO_SetStructuredBuffers. Stage is stored in the header. */
+	struct RCmdSetBuffers
+	{
+		std::array<class RBuffer *, RAPI_MAX_NUM_SHADER_RESOURCES> Buffers;
+	};
+
+	/** Payload of CO_Draw */
+	struct RCmdDraw
+	{
+		/** Takes the draw-parameters out of the given pipeline-state */
+		static RCmdDraw FromPipelineState(const RPipelineState &state)
+		{
+			RCmdDraw d;
+			d.DrawFunctionID = state.IDs.DrawFunctionID;
+			d.PrimitiveType = state.IDs.PrimitiveType;
+			d.NumDrawElements = state.NumDrawElements;
+			d.StartVertexOffset = state.StartVertexOffset;
+			d.StartIndexOffset = state.StartIndexOffset;
+			d.StartInstanceOffset = state.StartInstanceOffset;
+			d.NumInstances = state.NumInstances;
+			return d;
+		}
+
+		uint32_t DrawFunctionID;
+		uint32_t PrimitiveType;
+		unsigned int NumDrawElements;
+		unsigned int StartVertexOffset;
+		unsigned int StartIndexOffset;
+		unsigned int StartInstanceOffset;
+		unsigned int NumInstances;
+	};
+
+	/**
+	 * Backend-agnostic commandbuffer. Worker-threads resolve the states of a renderqueue into a linear
+	 * stream of bind- and draw-ops, which the thread owning the API-Context then only has to walk through.
+	 * Memory is kept between frames, so recording doesn't allocate once the buffer has grown large enough.
+	 */
+	class RCommandBuffer
+	{
+	public:
+		RCommandBuffer();
+
+		/**
+		 * Records the state-changes and the drawcall for the packet at the given index.
+		 * Different buffers can be recorded from different threads at the same time.
+		 */
+		void RecordDrawPacket(const RDrawPackets &packets, size_t index, const RStateMachine::ChangesStruct &changes,
+							  RStateMachine &stateMachine);
+
+		/**
+		 * Throws away all recorded commands, but keeps the memory
+		 */
+		void Reset();
+
+		/**
+		 * Iteration over the recorded commands
+		 */
+		const RCommandHeader *Begin() const
+		{ return reinterpret_cast<const RCommandHeader *>(Data.data()); }
+
+		const RCommandHeader *End() const
+		{ return reinterpret_cast<const RCommandHeader *>(Data.data() + Data.size()); }
+
+		static const RCommandHeader *Next(const RCommandHeader *cmd)
+		{ return cmd + cmd->Size; }
+
+		template<typename T>
+		static const T &GetPayload(const RCommandHeader *cmd)
+		{ return *reinterpret_cast<const T *>(cmd + 1); }
+
+		/**
+		 * Getters
+		 */
+		bool IsEmpty() const
+		{ return Data.empty(); }
+
+		unsigned int GetNumCommands() const
+		{ return NumCommands; }
+
+		size_t GetSizeInBytes() const
+		{ return Data.size() * sizeof(RCommandHeader); }
+
+	private:
+		/**
+		 * Appends a command and returns its payload to be filled
+		 */
+		template<typename T>
+		T &Push(ECommandOp op, uint8_t stage = 0)
+		{
+			const size_t size = 1 + (sizeof(T) + sizeof(RCommandHeader) - 1) / sizeof(RCommandHeader);
+			size_t pos = Data.size();
+			Data.resize(pos + size);
+
+			RCommandHeader *cmd = &Data[pos];
+			cmd->Op = op;
+			cmd->Stage = stage;
+			cmd->Size = (uint16_t)size;
+
+			NumCommands++;
+			return *reinterpret_cast<T *>(cmd + 1);
+		}
+
+		// Recorded commands. Every payload starts on a header-sized boundary.
+		std::vector<RCommandHeader> Data;
+
+		// Number of commands in Data
+		unsigned int NumCommands;
+	};
+
+	static_assert(sizeof(RCommandHeader) == 8, "Payloads must stay pointer-aligned");
+}
@@ -27,6 +27,11 @@ namespace RAPI
 		/** Initializes a commandlist for the given Thread ID */
 		bool Init();
 
+		/** Records the packet at the given index of a renderqueue into this commandlist.
+			Must be called from the thread which will finalize the commandlist. */
+		bool RecordDrawPacket(const RDrawPackets &packets, size_t index, const RStateMachine::ChangesStruct &changes,
+							  RStateMachine &stateMachine);
+
 		/** Creates the commandlist and makes it ready to be played back.
 			This must be called from an other thread than the main-thread! */
 		bool FinalizeCommandList();
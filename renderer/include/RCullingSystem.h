@@ -0,0 +1,107 @@
+#pragma once
+#include "pch.h"
+#include "Types.h"
+#include "RBaseDevice.h"
+
+namespace RAPI
+{
+	struct RPipelineState;
+
+	typedef unsigned int RCullingHandle;
+
+	/**
+	 * Frustum culling in front of the renderqueues. Holds bounding volumes for drawables in structure-of-arrays form,
+	 * tests them against the 6 planes of a frustum on the threadpool and queues the pipeline-states of everything visible.
+	 *
+	 * Spheres and boxes are stored the same way: a center, half-extents along the axes and a radius. Boxes have a
+	 * radius of 0, spheres have extents of 0, so both go through the same test.
+	 */
+	class RCullingSystem
+	{
+	public:
+		RCullingSystem();
+
+		~RCullingSystem();
+
+		/**
+		 * Adds a drawable bounded by the given sphere or box. The state gets queued whenever the volume is visible.
+		 */
+		RCullingHandle AddSphere(const RFloat3 &center, float radius, const RPipelineState *state);
+
+		RCullingHandle AddAABB(const RFloat3 &min, const RFloat3 &max, const RPipelineState *state);
+
+		/**
+		 * Moves the bounding volume of the given drawable
+		 */
+		void UpdateSphere(RCullingHandle handle, const RFloat3 &center, float radius);
+
+		void UpdateAABB(RCullingHandle handle, const RFloat3 &min, const RFloat3 &max);
+
+		/**
+		 * Changes the state queued for the given drawable
+		 */
+		void SetPipelineState(RCullingHandle handle, const RPipelineState *state);
+
+		/**
+		 * Removes the drawable. The handle may be given out again afterwards.
+		 */
+		void Remove(RCullingHandle handle);
+
+		/**
+		 * Removes all drawables
+		 */
+		void Clear();
+
+		/**
+		 * Culls all drawables against the frustum of the given view-projection matrix and puts the visible ones
+		 * into the queue. The queue must be acquired already. Visible states are queued from the worker-threads,
+		 * so they only keep their order in sortable queues. Returns the number of visible drawables.
+		 */
+		unsigned int CullAndQueue(const RMatrix &viewProj, RRenderQueueID queue);
+
+		/**
+		 * Same as above, but with the planes already set up. Planes are (normal, distance) and point inwards.
+		 */
+		unsigned int CullAndQueue(const RFloat4 *planes, RRenderQueueID queue);
+
+		/**
+		 * Pulls the 6 normalized frustum planes out of a view-projection matrix. The matrix is expected the way the
+		 * shaders get it: transforming column-vectors, stored column by column.
+		 */
+		static void ExtractFrustumPlanes(const RMatrix &viewProj, RFloat4 *planes);
+
+		/**
+		 * Returns the number of drawables in the system
+		 */
+		unsigned int GetNumDrawables() const
+		{ return (unsigned int)States.size(); }
+
+	private:
+		/**
+		 * Tests the drawables in [start, end) and queues the visible ones. Returns how many were visible.
+		 */
+		unsigned int CullRange(size_t start, size_t end, const RFloat4 *planes, RRenderQueueID queue) const;
+
+		/**
+		 * Returns a free handle, pointing to a new slot at the end of the arrays
+		 */
+		RCullingHandle AllocateHandle();
+
+		// Bounding volumes, one entry per drawable
+		std::vector<float> CenterX;
+		std::vector<float> CenterY;
+		std::vector<float> CenterZ;
+		std::vector<float> ExtentX;
+		std::vector<float> ExtentY;
+		std::vector<float> ExtentZ;
+		std::vector<float> Radius;
+
+		// States to queue when visible. Same index as the volumes.
+		std::vector<const RPipelineState *> States;
+
+		// Drawables get moved around when others are removed, so handles go through these
+		std::vector<unsigned int> HandleToIndex;
+		std::vector<RCullingHandle> IndexToHandle;
+		std::vector<RCullingHandle> FreeHandles;
+	};
+}
@@ -36,6 +36,11 @@ namespace RAPI
 		 */
 		bool UpdateDataAPI(const void* data, size_t dataSize = 0);
 
+		/**
+		 * Copies the contents of this buffer into the given memory, which must be GetSizeInBytes() large
+		 */
+		bool ReadBackAPI(void* data);
+
 		/**
 		 * Getters, doublebuffered for dynamic buffers!
 		 */
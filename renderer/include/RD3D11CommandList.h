@@ -1,5 +1,7 @@
 #pragma once
 #include "RBaseCommandList.h"
+#include "RStateMachine.h"
+#include "RDrawPackets.h"
 
 namespace RAPI
 {
@@ -15,6 +17,10 @@ namespace RAPI
         /** Initializes a commandlist for the given Thread ID */
         bool InitAPI();
 
+        /** Records the given packet of a renderqueue into the deferred context of this thread */
+        bool RecordDrawPacketAPI(const RDrawPackets &packets, size_t index, const RStateMachine::ChangesStruct &changes,
+                                 RStateMachine &stateMachine);
+
         /** Creates the commandlist and makes it ready to be played back */
         bool FinalizeCommandListAPI();
 
@@ -59,7 +59,12 @@ namespace RAPI
 		/**
          * Renders an array of pipeline-states
          */
-		bool DrawPipelineStatesAPI(struct RPipelineState *const *stateArray, unsigned int numStates);
+		bool DrawPipelineStatesAPI(const struct RPipelineState *const *stateArray, unsigned int numStates);
+
+		/**
+         * Nothing to link here, shaders are complete once they are created
+         */
+		bool PrecompileProgramsAPI(const struct RPipelineState *const *stateArray, unsigned int numStates){return true;}
 
 		/**
          * Registers a thread in the renderer. Creates a resources like a deferred context.
@@ -96,6 +101,12 @@ namespace RAPI
         */
 		bool PrepareContextAPI(unsigned int threadId);
 
+		/**
+		* Binds the API-Context to the calling thread, or releases it from there
+		*/
+		bool MakeContextCurrentAPI();
+		bool ReleaseContextAPI();
+
 	private:
 
 
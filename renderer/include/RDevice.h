@@ -17,8 +17,11 @@
 // If no name is present, the queue won't be profiled. If enabled, multithreading will not be used
 //#define R_PROFILE_QUEUES
 
-// Whether to use multithreading to draw the queues
+// Whether to use multithreading to draw the queues. GL and NULL record into software commandlists,
+// D3D11 still draws everything on the immediate context.
+#ifdef RND_D3D11
 #define NO_MULTITHREADED_RENDERING
+#endif
 
 namespace RAPI {
 
@@ -69,6 +72,39 @@ namespace RAPI {
          */
 		bool Present();
 
+		/**
+         * Enables or disables pipelined frames. When enabled, a render thread flushes and presents the frame
+         * handed over by SubmitFrame, while the application already fills the queues of the next one.
+         * The API-Context belongs to the render thread then. Create resources before enabling this and
+         * put data changing every frame into transient allocations. On GL, mapping or updating dynamic
+         * buffers makes API-Calls as well, so that must not happen on the application thread meanwhile.
+         */
+		bool SetPipelinedFrames(bool enable);
+
+		/**
+         * Hands the queues filled this frame over to the render thread. Waits for the previous frame to be
+         * presented first, so the application is never more than one frame ahead.
+         * Replaces OnFrameStart, OnFrameEnd and Present when frames are pipelined.
+         */
+		bool SubmitFrame();
+
+		/**
+         * Blocks until the render thread has presented the last submitted frame
+         */
+		void WaitForSubmittedFrame();
+
+		/**
+         * Returns whether frames are currently pipelined
+         */
+		bool IsPipeliningFrames() { return RenderThread.joinable(); }
+
+		/**
+         * Writes the queues flushed at the end of the next frame, together with the resources they use,
+         * into the given file. Replay it with RFrameReplay or the rapi_replay tool.
+         * Buffer contents are only stored if asked for, reading them back stalls the GPU.
+         */
+		void CaptureNextFrame(const std::string &file, bool withBufferContents = false);
+
 		/**
          * Renders the given pipeline-state
          */
@@ -80,10 +116,26 @@ namespace RAPI {
 		/**
          * Renders an array of pipeline-states
          */
-		bool DrawPipelineStates(struct RPipelineState *const *stateArray, unsigned int numStates);
+		bool DrawPipelineStates(const struct RPipelineState *const *stateArray, unsigned int numStates);
+
+		/**
+         * Gets everything the shaders of the given pipeline-states need ready ahead, so the first draws don't
+         * have to wait for it. Meant to be called at load-time, from the thread owning the API-Context.
+         * Only does something on APIs which link shaders into programs.
+         */
+		bool PrecompilePrograms(const struct RPipelineState *const *stateArray, unsigned int numStates);
 
 		/**
-         * Puts the given pipeline-state into the renderingqueue, which is flushed at the end of the frame
+         * Returns the draw-context of the calling thread, to set resources on and make draws with while
+         * other threads do the same. Every worker of the threadpool has its own. All other threads share
+         * a single one, so only one of them may use it at a time.
+         */
+		class RDrawContext &GetThreadDrawContext();
+
+		/**
+         * Puts the given pipeline-state into the renderingqueue, which is flushed at the end of the frame.
+         * Can be called from the workers of the threadpool and the thread owning the device at the same time.
+         * All of them must be done queueing before the queue is processed or flushed.
          */
 		bool QueuePipelineState(const struct RPipelineState *state, RRenderQueueID queue);
 
@@ -99,16 +151,58 @@ namespace RAPI {
 
 		/**
          * Registers a renderingqueue in the device. Registration will be cleared every frame, so you have to
-         * get one every frame you want to use it.  */
-		RRenderQueueID AcquireRenderQueue(bool sortable = false, const std::string &name = "");
+         * get one every frame you want to use it. Queues are submitted by ascending priority, queues of
+         * the same priority in the order they were acquired.  */
+		RRenderQueueID AcquireRenderQueue(bool sortable = false, const std::string &name = "", int priority = 0);
+
+		/**
+         * Creates a queue which stays valid until it is unregistered. It doesn't need to be acquired and can
+         * be filled every frame right away. Registered queues come before acquired ones of the same priority.
+         */
+		RRenderQueueID RegisterRenderQueue(const std::string &name, int priority = 0, bool sortable = false);
 
 		/**
-         * Returns the Counter of how many frames since the start of the program have been rendered
+         * Frees a queue made by RegisterRenderQueue. It must be empty.
+         */
+		void UnregisterRenderQueue(RRenderQueueID queue);
+
+		/**
+         * Returns the counts and timings of the given queue. Registered queues count every flush, with pipelined
+         * frames one shows up once the frame after it was submitted. Acquired queues only have the values
+         * of their last use, which is the frame before the last one when pipelined.
+         */
+		const RRenderQueueStats &GetRenderQueueStats(RRenderQueueID queue);
+
+		/**
+         * Returns the Counter of how many frames since the start of the program have been rendered.
+         * Counts up on the render thread while frames are pipelined.
          */
 		unsigned int GetFrameCounter();
 
 		/**
-         * Fills the "changes"-vector of the given queue with values
+         * Returns how many frames the application has handed to the device. Counts up in OnFrameEnd or
+         * SubmitFrame, so it stays on the frame being built while frames are pipelined.
+         */
+		unsigned int GetApplicationFrameCounter();
+
+		/**
+         * Makes the given queue wait for an other one: It will only be processed once the dependency
+         * was processed and gets submitted after it. Must be called before processing the queue.
+         * Returns false if this would create a cycle.
+         */
+		bool AddRenderQueueDependency(RRenderQueueID queue, RRenderQueueID dependency);
+
+		/**
+         * Makes the queue get drawn once for each of the given views, with the views constant buffers and viewport
+         * in place of the ones of its states. Sorting and computing the changes happens only once for all of them.
+         * Useful for shadow-cascades, cubemap-faces or split-screen. Must be called before processing the queue,
+         * the views are reset when it is flushed.
+         */
+		bool SetRenderQueueViews(RRenderQueueID queue, const RViewOverrides *views, unsigned int numViews);
+
+		/**
+         * Fills the "changes"-vector of the given queue with values and records its commandlists.
+         * This happens on the threadpool as soon as all dependencies of the queue were processed.
          */
 		void ProcessRenderQueue(RRenderQueueID queue);
 
@@ -124,6 +218,12 @@ namespace RAPI {
 
 
 
+		/**
+         * Returns how recording the commandlists of the given queue went the last time it was processed.
+         * Only valid after the queue was flushed.
+         */
+		const std::vector<RCommandListStats> &GetCommandListStats(RRenderQueueID queue);
+
 		/**
          * Returns the current main output window
          */
@@ -155,17 +255,75 @@ namespace RAPI {
 		/**
          * Prepares the renderqueues for rendering. Does the actual drawcalls.
          */
-		bool PrepareCommandlists(RRenderQueueID queue);
+		bool PrepareCommandlists(RRenderQueue &q);
+
+		/**
+         * Sorts the queue and computes the changes between its states, in parallel chunks
+         */
+		void ComputeQueueChanges(RRenderQueue &q);
+
+		/**
+         * Task processing a single queue. Starts the processing of waiting dependents when done.
+         */
+		void ProcessRenderQueueTask(RRenderQueue &q);
+
+		/**
+         * Creates an empty queue with a buffer for every thread which can fill it
+         */
+		RRenderQueue *CreateRenderQueue();
+
+		/**
+         * Returns true if the given queue depends on the other one, directly or indirectly
+         */
+		bool DependsOnRenderQueue(RRenderQueueID queue, RRenderQueueID dependency);
+
+		/**
+         * Puts the in-use queues of the given set into the order they get submitted in. Goes by priority,
+         * unless a queue has to wait for a dependency.
+         */
+		void GetSubmissionOrder(const std::vector<RRenderQueue *> &queues, std::vector<RRenderQueueID> &order);
+
+		/**
+         * Adds the flushes of the registered queues in the given set to the stats of their slots.
+         * Only for sets the render thread isn't working on.
+         */
+		void CollectRegisteredQueueStats(std::vector<RRenderQueue *> &queues);
+
+		/**
+         * Moves the states queued by the different threads into the main queue
+         */
+		void MergeQueuedStates(RRenderQueue &q);
+
+		/**
+         * Renders everything in the given queue
+         */
+		bool FlushRenderQueue(RRenderQueue &q);
+
+		/**
+         * Flushes all queues of the given set in submission order and ends the frame on the API
+         */
+		bool FlushRenderQueues(std::vector<RRenderQueue *> &queues);
 
 		/**
          * Draws the whole given queue on the main thread
          */
-		bool FlushQueueImmediate(RRenderQueueID queue);
+		bool FlushQueueImmediate(RRenderQueue &q);
 
 		/**
          * Uses the generated commandlists of the given queue and draws them
          */
-		bool FlushQueueCmdLists(RRenderQueueID queue);
+		bool FlushQueueCmdLists(RRenderQueue &q);
+
+		/**
+         * Uploads what the threads wrote into the transient regions and moves the dynamic buffers on to
+         * the next frame. The application can write the data of the next frame after this.
+         */
+		void HandOffFrameData();
+
+		/**
+         * Loop of the render thread used for pipelined frames
+         */
+		void RenderThreadFunc();
 	};
 
 }
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+#include "pch.h"
+#include "RStateMachine.h"
+
+namespace RAPI
+{
+	/**
+	 * Lightweight state machine for building draws away from the device. Has its own current state to set
+	 * resources on and takes its pipeline-states from a small reserve, which is refilled from the resource-cache
+	 * in batches, so threads building draws don't have to wait on each other for every one of them.
+	 *
+	 * The device has one of these for every worker of the threadpool, see RDevice::GetThreadDrawContext.
+	 * The states made here can be queued from any thread and are deleted through the resource-cache as usual.
+	 */
+	class RDrawContext : public RStateMachine
+	{
+	public:
+		RDrawContext();
+
+		~RDrawContext();
+
+		/**
+		 * Puts the current state back to how a new context starts out
+		 */
+		void Reset();
+
+		/**
+		 * Takes over the current state of the given state machine, for example the one of the device,
+		 * to build draws on top of what is set there
+		 */
+		void CopyStateFrom(const RStateMachine &other);
+
+	protected:
+		/**
+		 * Returns a pipeline-state from the reserve, refilling it first if needed
+		 */
+		RPipelineState *AllocatePipelineState() override;
+
+	private:
+		// Pipeline-states created ahead, handed out by the MakeDrawCall-functions
+		std::vector<RPipelineState *> Reserve;
+	};
+}
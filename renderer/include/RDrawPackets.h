@@ -0,0 +1,74 @@
+#pragma once
+#include "pch.h"
+#include "RPipelineState.h"
+#include "RStateMachine.h"
+#include "RCommandBuffer.h"
+
+namespace RAPI
+{
+	/**
+	 * Structure-of-arrays view of the pipeline-states in a renderqueue. Everything the queue needs per draw
+	 * is copied out of the states when they are queued, so sorting and diffing only walk small, linear arrays.
+	 * The states themselves are only looked at again when their resource-tables actually changed.
+	 */
+	struct RDrawPackets
+	{
+		/**
+		 * Copies the hot data out of the given state and appends it
+		 */
+		void Push(const RPipelineState *state)
+		{
+			SortKeys.push_back(MakeSortKey(*state));
+			Keys.push_back(state->IDs);
+			ResourceTableHashes.push_back(state->_ResourceTablesHash);
+			DrawParams.push_back(RCmdDraw::FromPipelineState(*state));
+			States.push_back(state);
+		}
+
+		/**
+		 * Appends all packets of the other list
+		 */
+		void Append(const RDrawPackets &other);
+
+		/**
+		 * Throws away all packets, but keeps the memory
+		 */
+		void Clear();
+
+		/**
+		 * Sorts the packets by their sort-key. Packets with the same key keep their order.
+		 */
+		void Sort();
+
+		/**
+		 * Computes the changes needed to go from the previous packet to the given one.
+		 * The first packet gets everything it uses set.
+		 */
+		void ComputeChanges(size_t index, RStateMachine::ChangesStruct &changes) const;
+
+		/**
+		 * Value the queues are sorted by. Keeps the draw-order and groups by texture.
+		 */
+		static uint32_t MakeSortKey(const RPipelineState &state)
+		{
+			return state.IDs.MainTexture + state.IDs.DrawOrder * 1000000;
+		}
+
+		size_t Size() const
+		{ return States.size(); }
+
+		bool Empty() const
+		{ return States.empty(); }
+
+		// Hot data, used for sorting and computing changes
+		std::vector<uint32_t> SortKeys;
+		std::vector<RPipelineState::IDStruct> Keys;
+		std::vector<uint32_t> ResourceTableHashes;
+
+		// Vertex-counts and offsets, used for every drawcall
+		std::vector<RCmdDraw> DrawParams;
+
+		// Cold data: The states holding the actual texture- and buffer-tables
+		std::vector<const RPipelineState *> States;
+	};
+}
@@ -1,8 +1,10 @@
 #pragma once
 #include "pch.h"
+#include "RTransientAllocator.h"
 
-// Numbers of frames should have buffers to prepare for
-const unsigned int NUM_BUFFERCACHE_FRAME_STORAGES = 1;
+// Numbers of frames should have buffers to prepare for. With pipelined frames the cache moves on when a frame
+// is handed to the render thread, so buffers done with in one frame must only come back after the next one.
+const unsigned int NUM_BUFFERCACHE_FRAME_STORAGES = 2;
 
 namespace RAPI
 {
@@ -45,12 +47,21 @@ namespace RAPI
 			Returns the current frame-number and the buffer. */
 		RCachedDynamicBuffer GetDataBuffer(EBindFlags bindFlags, unsigned int size, unsigned int stride);
 
+		/** Allocates memory from the transient upload region of the given type. Lock-free and safe to
+			call from any thread. The data gets uploaded at the end of the frame, before the queues are
+			flushed, and is only valid for that frame. */
+		RTransientAllocation AllocateTransient(EBindFlags bindFlags, unsigned int size, unsigned int alignment = 16);
+
+		/** Uploads all transient allocations of this frame. Called by the Device before flushing the queues */
+		void FlushTransientAllocations();
+
 		/** Signals the cache that we're done with a buffer */
 		void DoneWith(RBuffer *buffer, unsigned int bufferFrame, EBindFlags bindFlags);
 
 		void DoneWith(RCachedDynamicBuffer &buffer);
 
-		/** Called by the Device when the frame ended */
+		/** Called by the Device when the frame ended. Buffers done with in the frame before this one are
+			free again afterwards, as that one was presented already. */
 		void OnFrameEnded();
 
 		/** Clears unused buffers from the cache */
@@ -80,6 +91,9 @@ namespace RAPI
 		unsigned int Frame;
 
 		std::set<RBuffer *> AllocatedBuffers;
+
+		// Shared upload regions for the transient allocators, one per supported bindflag
+		std::vector<RTransientUploadRegion *> TransientRegions;
 	};
 
 }
\ No newline at end of file
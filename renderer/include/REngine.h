@@ -18,9 +18,9 @@ namespace RAPI
 	namespace REngine
 	{
 		/**
-		 * Initializes these objects
+		 * Initializes these objects. Uses one worker-thread per core if numThreads is 0.
 		 */
-		bool InitializeEngine();
+		bool InitializeEngine(unsigned int numThreads = 0);
 
 		/**
 		 * Destroys these objects
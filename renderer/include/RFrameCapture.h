@@ -0,0 +1,246 @@
+#pragma once
+#include "pch.h"
+#include "Types.h"
+#include "RPipelineState.h"
+#include "RBaseBlendState.h"
+#include "RBaseRasterizerState.h"
+#include "RBaseDepthStencilState.h"
+#include "RBaseSamplerState.h"
+#include "RBaseInputLayout.h"
+#include <iosfwd>
+#include <map>
+#include <unordered_map>
+
+namespace RAPI
+{
+	struct RRenderQueue;
+	class RBuffer;
+	class RTexture;
+	class RVertexShader;
+	class RPixelShader;
+	class RInputLayout;
+	class RBlendState;
+	class RRasterizerState;
+	class RDepthStencilState;
+	class RSamplerState;
+	class RViewport;
+
+	// Marks an unused slot in a captured state
+	const uint32_t RCAPTURE_NO_RESOURCE = 0xFFFFFFFF;
+
+	/**
+	 * A single pipeline-state as it is stored in a capture. Resources are referenced by the ID
+	 * they had in the captured program, so the replay can map them to the ones it created.
+	 */
+	struct RCapturedState
+	{
+		uint32_t PrimitiveType;
+		uint32_t DrawFunctionID;
+
+		uint32_t NumDrawElements;
+		uint32_t StartVertexOffset;
+		uint32_t StartIndexOffset;
+		uint32_t StartInstanceOffset;
+		uint32_t NumInstances;
+
+		uint32_t VertexShader;
+		uint32_t PixelShader;
+		uint32_t InputLayout;
+		uint32_t BlendState;
+		uint32_t RasterizerState;
+		uint32_t DepthStencilState;
+		uint32_t SamplerState;
+		uint32_t Viewport;
+		uint32_t VertexBuffers[2];
+		uint32_t IndexBuffer;
+
+		uint32_t Textures[EShaderType::ST_NUM_SHADER_TYPES][RAPI_MAX_NUM_SHADER_RESOURCES];
+		uint32_t ConstantBuffers[EShaderType::ST_NUM_SHADER_TYPES][RAPI_MAX_NUM_SHADER_RESOURCES];
+		uint32_t StructuredBuffers[EShaderType::ST_NUM_SHADER_TYPES][RAPI_MAX_NUM_SHADER_RESOURCES];
+	};
+
+	/**
+	 * A renderqueue as it was submitted in the captured frame
+	 */
+	struct RCapturedQueue
+	{
+		std::string Name;
+		bool SortQueue;
+		std::vector<RCapturedState> States;
+	};
+
+	/**
+	 * Records the queues submitted during a frame, together with the descriptions of every resource they
+	 * use, into a binary file. Replaying the file with RFrameReplay gives the exact same submission
+	 * workload without the application, which makes it useful for profiling the renderer on its own.
+	 *
+	 * Texture contents are not captured, the replay creates empty textures of the same size and format.
+	 * Buffer contents are read back from the API if asked for, which costs a full stall.
+	 */
+	class RFrameCapture
+	{
+	public:
+		RFrameCapture(const std::string &file, bool withBufferContents = false);
+
+		~RFrameCapture();
+
+		/**
+		 * Adds the states of the given queue. Must be called with the merged and processed queue,
+		 * in the order the queues get submitted.
+		 */
+		void AddQueue(const RRenderQueue &queue);
+
+		/**
+		 * Writes everything captured so far into the file
+		 */
+		bool WriteToFile();
+
+		/**
+		 * Returns the file this capture is written to
+		 */
+		const std::string &GetFile() const
+		{ return File; }
+
+	private:
+		/**
+		 * Converts a single pipeline-state and remembers the resources it uses
+		 */
+		void CaptureState(const RPipelineState &state, RCapturedState &out);
+
+		// File to write to
+		std::string File;
+
+		// Whether to read back and store the contents of the buffers
+		bool WithBufferContents;
+
+		// Captured queues, in submission order
+		std::vector<RCapturedQueue> Queues;
+
+		// Resources used by the captured states, by their ID
+		std::map<uint32_t, RBuffer *> Buffers;
+		std::map<uint32_t, RTexture *> Textures;
+		std::map<uint32_t, RVertexShader *> VertexShaders;
+		std::map<uint32_t, RPixelShader *> PixelShaders;
+		std::map<uint32_t, RInputLayout *> InputLayouts;
+		std::map<uint32_t, RBlendState *> BlendStates;
+		std::map<uint32_t, RRasterizerState *> RasterizerStates;
+		std::map<uint32_t, RDepthStencilState *> DepthStencilStates;
+		std::map<uint32_t, RSamplerState *> SamplerStates;
+		std::map<uint32_t, RViewport *> Viewports;
+
+		// Vertexshader each inputlayout was first used with. D3D11 needs one to create the layout.
+		std::map<uint32_t, uint32_t> InputLayoutShaders;
+	};
+
+	/**
+	 * Loads a file written by RFrameCapture and replays the captured frame. Creates its own copies of all
+	 * resources, so it can run without anything else set up but the device.
+	 */
+	class RFrameReplay
+	{
+	public:
+		RFrameReplay();
+
+		~RFrameReplay();
+
+		/**
+		 * Reads the given capture. Returns false if the file is missing, or was written by an incompatible build.
+		 */
+		bool LoadFromFile(const std::string &file);
+
+		/**
+		 * Creates the resources and pipeline-states of the loaded capture. The device must be created.
+		 */
+		bool CreateResources();
+
+		/**
+		 * Acquires the captured queues, fills them and processes them. Finish the frame with
+		 * OnFrameEnd and Present as usual.
+		 */
+		void QueueFrame();
+
+		/**
+		 * Returns the number of queues and draws in a single replayed frame
+		 */
+		unsigned int GetNumQueues() const
+		{ return (unsigned int)Queues.size(); }
+
+		unsigned int GetNumDrawCalls() const;
+
+	private:
+		/**
+		 * Reads everything following the header
+		 */
+		bool ReadSections(std::istream &f);
+
+		/**
+		 * Creates the pipeline-state for a single captured one
+		 */
+		RPipelineState *CreatePipelineState(const RCapturedState &s);
+
+		// Descriptions of the resources, as read from the file
+		struct BufferDesc
+		{
+			uint32_t SizeInBytes;
+			uint32_t StructuredByteSize;
+			uint32_t BindFlags;
+			uint32_t Usage;
+			uint32_t CpuAccess;
+			std::vector<uint8_t> Contents;
+		};
+
+		struct TextureDesc
+		{
+			bool Initialized;
+			RInt2 Resolution;
+			uint32_t Format;
+			uint32_t NumMipLevels;
+			uint32_t BindFlags;
+			uint32_t Usage;
+			uint32_t ArraySize;
+		};
+
+		struct ShaderDesc
+		{
+			bool FromMemory;
+			std::string Source;
+			std::vector<std::vector<std::string>> Definitions;
+		};
+
+		struct InputLayoutDesc
+		{
+			std::vector<INPUT_ELEMENT_DESC> Elements;
+			std::vector<std::string> Semantics;
+			uint32_t TemplateShader;
+		};
+
+		std::map<uint32_t, BufferDesc> BufferDescs;
+		std::map<uint32_t, TextureDesc> TextureDescs;
+		std::map<uint32_t, ShaderDesc> VertexShaderDescs;
+		std::map<uint32_t, ShaderDesc> PixelShaderDescs;
+		std::map<uint32_t, InputLayoutDesc> InputLayoutDescs;
+		std::map<uint32_t, RBlendStateInfo> BlendStateDescs;
+		std::map<uint32_t, RRasterizerStateInfo> RasterizerStateDescs;
+		std::map<uint32_t, RDepthStencilStateInfo> DepthStencilStateDescs;
+		std::map<uint32_t, RSamplerStateInfo> SamplerStateDescs;
+		std::map<uint32_t, ViewportInfo> ViewportDescs;
+
+		// Captured queues, in submission order
+		std::vector<RCapturedQueue> Queues;
+
+		// Created objects, by the ID they had in the capture
+		std::unordered_map<uint32_t, RBuffer *> Buffers;
+		std::unordered_map<uint32_t, RTexture *> Textures;
+		std::unordered_map<uint32_t, RVertexShader *> VertexShaders;
+		std::unordered_map<uint32_t, RPixelShader *> PixelShaders;
+		std::unordered_map<uint32_t, RInputLayout *> InputLayouts;
+		std::unordered_map<uint32_t, RBlendState *> BlendStates;
+		std::unordered_map<uint32_t, RRasterizerState *> RasterizerStates;
+		std::unordered_map<uint32_t, RDepthStencilState *> DepthStencilStates;
+		std::unordered_map<uint32_t, RSamplerState *> SamplerStates;
+		std::unordered_map<uint32_t, RViewport *> Viewports;
+
+		// Pipeline-states of the replayed frame, one list per queue
+		std::vector<std::vector<RPipelineState *>> States;
+	};
+}
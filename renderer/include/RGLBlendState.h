@@ -1,6 +1,7 @@
 #pragma once
 
 #include "RBaseBlendState.h"
+#include "RGLStateCache.h"
 
 #ifdef RND_GL
 namespace RAPI
@@ -11,8 +12,20 @@ namespace RAPI
         /**
          * API-Version of CreateState
          */
-        bool CreateStateAPI(){return true;}
+        bool CreateStateAPI();
 
+        /**
+         * Returns the GL-Values this state was converted to
+         */
+        const RGLBlendRecord &GetRecordAPI() const { return Record; }
+
+        /**
+         * Converts the given stateinfo to GL-Values
+         */
+        static RGLBlendRecord MakeRecord(const RBlendStateInfo &info);
+
+    private:
+        RGLBlendRecord Record;
     };
 }
-#endif
\ No newline at end of file
+#endif
@@ -6,11 +6,25 @@
 
 namespace RAPI
 {
-	// Numbers of frames should have buffers to prepare for
-	const int NUM_BUFFERSTASH_FRAME_STORAGES = 3;
+	// Number of regions a persistently mapped dynamic buffer is split into when created.
+	// The CPU writes one of them while the GPU may still read the others.
+	const int NUM_DYNAMIC_BUFFER_REGIONS = 3;
+
+	/**
+	 * Part of the persistently mapped storage of a dynamic buffer. Every map moves on to the next one.
+	 */
+	struct RGLBufferRegion
+	{
+		// Storage this lies in and where
+		GLuint Buffer;
+		GLintptr Offset;
+		uint8_t *Mapped;
+
+		// Last frame the GPU may read this on. Only valid if Used is set.
+		unsigned int LastFrameUsed;
+		bool Used;
+	};
 
-	class RBuffer;
-	class RInputLayout;
     class RGLBuffer : public RBaseBuffer
     {
     public:
@@ -25,6 +39,7 @@ namespace RAPI
 
         /**
         * Maps the texture for update. Only possible with the right CPU-Acces and usage-flags.
+        * Makes GL-Calls, so while frames are pipelined this must happen on the render thread.
         */
         bool MapAPI(void **dataOut);
 
@@ -35,10 +50,15 @@ namespace RAPI
 
         /**
          * Updates the data of this buffer. If this isn't a dynamic resource, it will still try to update
-         * the resource, but using a slower path
+         * the resource, but using a slower path. Same as mapping, only on the render thread while frames are pipelined.
          */
         bool UpdateDataAPI(const void *data, size_t dataSize = 0);
 
+        /**
+         * Copies the contents of this buffer into the given memory, which must be GetSizeInBytes() large
+         */
+        bool ReadBackAPI(void *data);
+
         /**
          * Deletes all resources this holds but keeps the object around.
          * Recreate the buffer by calling Init
@@ -46,40 +66,62 @@ namespace RAPI
         void DeallocateAPI();
 
 		/**
-		 * Updates the VAO-Info of this buffer, if this is used as a vertexbuffer 
-		 */
-		void UpdateVAO(const RInputLayout* inputLayout, RBuffer* instanceBuffer);
+		* Returns the buffer object 
+		*/
+		GLuint GetBufferObjectAPI(){return VertexBufferObject;}
+
+		/**
+		* Returns where the current data starts inside the buffer object. Only dynamic buffers have this
+		* set to something other than 0.
+		*/
+		GLintptr GetBindOffsetAPI(){return BindOffset;}
+
+	private:
 
 		/**
-		* Returns the vertex array object 
+		* True if this is a dynamic buffer living in persistently mapped storage
 		*/
-		GLuint GetVertexArrayObjectAPI(){return VertexArrayObject;}
+		bool IsPersistentlyMapped(){return !Regions.empty();}
 
 		/**
-		* Returns the vertex array object 
+		* Creates storage for NUM_DYNAMIC_BUFFER_REGIONS more regions and puts them into the chain after
+		* the current one
 		*/
-		GLuint GetBufferObjectAPI(){return VertexBufferObject;}
-	private:
+		bool AddStorage();
 
-		/** Switches to the next buffer in the stash, if we're doing maps on the same frame 
-			Returns true if switched. */
-		bool TrySwitchBuffers();
+		/**
+		* Moves on to a region the GPU is done with. Chains new storage if the next one was used by one of the
+		* last frames the CPU may be ahead by, only waits for the GPU on regions older than that.
+		*/
+		bool SwitchRegion();
+
+		/**
+		* Makes the given region the current one
+		*/
+		void SetCurrentRegion(unsigned int region);
+
+		/**
+		* Deletes the storage of the region chain
+		*/
+		void DeleteRegions();
+
+		/**
+		* Tells the caches of the device that the given buffer object is gone
+		*/
+		static void OnBufferObjectDeleted(GLuint buffer);
 
 		// The created VBO
 		GLuint VertexBufferObject;
 
-		// The used VAO
-		GLuint VertexArrayObject;
-
-		// Multiple allocated buffers for a dynamic type to reduce
-		// GPU-Sync points. Only active with the usage is set to DYNAMIC
-		std::pair<GLuint, GLuint> BufferStash[NUM_BUFFERSTASH_FRAME_STORAGES];
+		// Start of the current data inside VertexBufferObject
+		GLintptr BindOffset;
 
-		// Last frame this buffer was updated on
-		unsigned int LastFrameUpdated;
+		// Regions of dynamic buffers, in the order they are cycled through
+		std::vector<RGLBufferRegion> Regions;
+		unsigned int CurrentRegion;
 
-		// Current slot of the BufferStash we are using
-		unsigned int StashBufferRotation;
+		// Size of every region. Can be bigger than SizeInBytes, to have room for the buffer to grow.
+		GLsizeiptr RegionSize;
     };
 }
 
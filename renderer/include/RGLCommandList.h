@@ -1,21 +1,35 @@
 #pragma once
 #include "RBaseCommandList.h"
+#include "RCommandBuffer.h"
+#include "RDrawPackets.h"
 
 #ifdef RND_GL
 
 namespace RAPI
 {
+	/**
+	 * GL has no deferred contexts, so drawcalls are recorded into a software commandbuffer
+	 * and replayed on the thread owning the GL-Context.
+	 */
 	class RGLCommandList : public RBaseCommandList
 	{
 	public:
 		/** Initializes a commandlist for the given Thread ID */
 		bool InitAPI(){return true;}
 
+		/** Records the given packet of a renderqueue into this commandlist */
+		bool RecordDrawPacketAPI(const RDrawPackets &packets, size_t index, const RStateMachine::ChangesStruct &changes,
+								 RStateMachine &stateMachine);
+
 		/** Creates the commandlist and makes it ready to be played back */
 		bool FinalizeCommandListAPI(){return true;}
 
 		/** Plays the generated commandlist back on the main-thread */
-		bool ExecuteCommandListAPI(){return true;}
+		bool ExecuteCommandListAPI();
+
+	protected:
+		// Recorded commands
+		RCommandBuffer Commands;
 	};
 }
-#endif
\ No newline at end of file
+#endif
@@ -1,12 +1,33 @@
 #pragma once
 #include "RBaseDevice.h"
+#include "RCommandBuffer.h"
+#include "RGLStateCache.h"
+#include "RGLProgramCache.h"
+#include "RGLVertexArrayCache.h"
+#include "RGLTextureUploader.h"
 
 #ifdef RND_GL
 namespace RAPI
 {
+	// Number of frames the CPU may get ahead of the GPU, which is also the number of frame-fences kept around
+	const int GL_NUM_FRAME_FENCES = 3;
+
+	// Smallest number of draws sharing all bindings which are put into one multi-draw-indirect call
+	const unsigned int GL_MIN_MULTIDRAW_RUN = 8;
+
+	// Number of indirect commands a single frame can write
+	const unsigned int GL_INDIRECT_COMMANDS_PER_FRAME = 64 * 1024;
+
+	// File the binaries of linked programs are kept in, unless set otherwise
+	const char* const GL_DEFAULT_PROGRAM_CACHE_FILE = "ProgramCache.bin";
+
 	class RGLDevice : public RBaseDevice
 	{
 	public:
+		RGLDevice();
+
+		~RGLDevice();
+
 		/**
          * Creates the renderingdevice for the set API
          */
@@ -51,7 +72,12 @@ namespace RAPI
 		/**
          * Renders an array of pipeline-states
          */
-		bool DrawPipelineStatesAPI(struct RPipelineState *const *stateArray, unsigned int numStates);
+		bool DrawPipelineStatesAPI(const struct RPipelineState *const *stateArray, unsigned int numStates);
+
+		/**
+		* Links the programs of the given pipeline-states, or loads them from the program cache
+		*/
+		bool PrecompileProgramsAPI(const struct RPipelineState *const *stateArray, unsigned int numStates);
 
 		/**
          * Registers a thread in the renderer. Creates a resources like a deferred context.
@@ -78,6 +104,69 @@ namespace RAPI
         */
 		bool PrepareContextAPI(unsigned int threadId);
 
+		/**
+		* Binds the API-Context to the calling thread, or releases it from there
+		*/
+		bool MakeContextCurrentAPI();
+		bool ReleaseContextAPI();
+
+		/**
+		* Walks through a commandbuffer recorded on a worker-thread and does the actual GL-Calls.
+		* Must be called from the thread owning the GL-Context.
+		*/
+		bool ReplayCommandBuffer(const RCommandBuffer& commands);
+
+		/**
+		* Shadowed GL-State. Everything binding objects or changing fixed-function state goes through here.
+		*/
+		RGLStateCache& GetStateCache() { return StateCache; }
+
+		/**
+		* VAOs of the combinations of vertexbuffers and layouts drawn with
+		*/
+		RGLVertexArrayCache& GetVertexArrayCache() { return VertexArrayCache; }
+
+		/**
+		* Ring texel-data is staged in before it is uploaded
+		*/
+		RGLTextureUploader& GetTextureUploader() { return TextureUploader; }
+
+		/**
+		* Returns the limits of the device, valid once the window was set
+		*/
+		const RGLLimits& GetLimits() { return Limits; }
+
+		/**
+		* Returns how many GL-Calls the state cache got asked for during the last frame, and how many it skipped
+		*/
+		const RGLStateCacheStats& GetStateCacheStats() { return StateCache.GetLastFrameStats(); }
+
+		/**
+		* Binaries of linked programs, kept between runs
+		*/
+		RGLProgramCache& GetProgramCache() { return ProgramCache; }
+
+		/**
+		* Sets the file the program binaries are kept in. Must be called before the window is set.
+		* An empty name turns the cache off.
+		*/
+		void SetProgramCacheFileGL(const std::string& file) { ProgramCacheFile = file; }
+
+		/**
+		* Blocks until the GPU is done with the given frame. Frames which weren't presented yet can't be waited on.
+		*/
+		void WaitForFrameGL(unsigned int frame);
+
+		/**
+		* Called by dynamic buffers when their data moved to another region. Rebinds them, if currently bound.
+		*/
+		void OnBufferRegionChangedGL(class RBuffer* buffer);
+
+		/**
+		* Called by buffers after deleting one of their buffer objects. Drops everything still using it.
+		*/
+		void OnBufferObjectDeletedGL(GLuint buffer);
+
 	private:
 
 		/**
@@ -85,9 +174,96 @@ namespace RAPI
 		*/
 		bool BindPipelineState(const RPipelineState& state, const RStateMachine::ChangesStruct& changes, RStateMachine& stateMachine);
 
+		/**
+		* Single steps of binding a pipeline state. Shared by the immediate path and the commandbuffer replay.
+		*/
+		void BindRasterizerStateGL(class RRasterizerState* rasterizerState);
+		void BindBlendStateGL(class RBlendState* blendState);
+		void BindDepthStencilStateGL(class RDepthStencilState* depthStencilState);
+		void BindSamplerStateGL(class RSamplerState* samplerState);
+		void BindVertexBuffersGL(class RBuffer* vertexBuffer0, class RBuffer* vertexBuffer1, class RInputLayout* inputLayout);
+		void BindIndexBufferGL(class RBuffer* indexBuffer);
+		void BindShadersGL(struct RPipelineState& state, class RVertexShader* vertexShader, class RPixelShader* pixelShader);
+		void BindTexturesGL(EShaderType stage, const std::array<class RTexture*, RAPI_MAX_NUM_SHADER_RESOURCES>& textures);
+		void BindConstantBuffersGL(EShaderType stage, const std::array<class RBuffer*, RAPI_MAX_NUM_SHADER_RESOURCES>& buffers);
+		void BindViewportGL(class RViewport* viewport);
+
+		/**
+		* Links the given shaders or gets a program from cache. Returns 0 without a vertexshader.
+		*/
+		GLuint LinkShadersGL(class RVertexShader* vertexShader, class RPixelShader* pixelShader);
+
+		/**
+		* Binds the VAO of the last set vertexbuffers, layout and indexbuffer, if they changed. Done right
+		* before drawing, so setting the buffers one after another doesn't make VAOs for the steps between.
+		*/
+		void BindVertexArrayGL();
+
+		/**
+		* Issues the drawcall described by the given parameters
+		*/
+		void DrawGL(const RCmdDraw& draw);
+
+		/**
+		* Collects draws done with the same bindings, so they can go out as one multi-draw
+		*/
+		void QueueDrawGL(const RCmdDraw& draw);
+
+		/**
+		* Issues the collected draws. Runs long enough go into a single multi-draw-indirect call.
+		*/
+		void FlushDrawsGL();
+
+		/**
+		* Writes the given draws into the indirect buffer and issues them with a single call.
+		* Returns false if that isn't supported or there is no room left this frame.
+		*/
+		bool MultiDrawIndirectGL(const RCmdDraw* draws, unsigned int numDraws);
+
+		/**
+		* Creates the persistently mapped buffer the indirect commands are written to
+		*/
+		bool CreateIndirectBufferGL();
+
 		// Current contexts
 		void* DeviceContext;
 		void* RenderContext;
+
+		// Shadowed state of the context and the limits of the device
+		RGLStateCache StateCache;
+		RGLLimits Limits;
+
+		// VAOs made so far
+		RGLVertexArrayCache VertexArrayCache;
+
+		// Texture uploads in flight
+		RGLTextureUploader TextureUploader;
+
+		// Linked programs kept on disk
+		RGLProgramCache ProgramCache;
+		std::string ProgramCacheFile;
+
+		// Buffers last bound, to bind them again when their data moves
+		class RBuffer* BoundVertexBuffers[2];
+		class RInputLayout* BoundInputLayout;
+		class RBuffer* BoundIndexBuffer;
+
+		// Set when the VAO has to be looked up again before the next draw
+		bool VertexArrayDirty;
+		std::array<class RBuffer*, RAPI_MAX_NUM_SHADER_RESOURCES> BoundConstantBuffers;
+
+		// Fences put in after every frame, and the frames they belong to
+		GLsync FrameFences[GL_NUM_FRAME_FENCES];
+		unsigned int FenceFrames[GL_NUM_FRAME_FENCES];
+
+		// Draws waiting to be issued together
+		std::vector<RCmdDraw> PendingDraws;
+
+		// Indirect commands, one part of the buffer per fenced frame
+		GLuint IndirectBuffer;
+		uint8_t* IndirectMapped;
+		unsigned int IndirectFrame;
+		unsigned int IndirectUsed;
 	};
 }
 #endif
\ No newline at end of file
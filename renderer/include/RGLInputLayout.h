@@ -8,6 +8,11 @@ namespace RAPI
     class RGLInputLayout : public RBaseInputLayout
     {
     public:
+        /**
+        * Drops the VAOs made with this layout
+        */
+        ~RGLInputLayout();
+
         /**
         * Creates the inputlayout using the given input decleration
         */
@@ -0,0 +1,81 @@
+#pragma once
+#include "pch.h"
+
+#ifdef RND_GL
+namespace RAPI
+{
+	/**
+	 * Counts of the programs which went through the cache
+	 */
+	struct RGLProgramCacheStats
+	{
+		RGLProgramCacheStats() : NumLoaded(0), NumLinked(0), NumRejected(0) {}
+
+		// Programs taken from the file
+		unsigned int NumLoaded;
+
+		// Programs which had to be linked from their shaders
+		unsigned int NumLinked;
+
+		// Stored binaries the driver didn't take anymore
+		unsigned int NumRejected;
+	};
+
+	/**
+	 * Keeps the binaries of linked programs in a file, so they don't have to be compiled and linked again
+	 * on the next start. The file is only valid for the driver it was written with, it is started over when
+	 * a different one is found.
+	 */
+	class RGLProgramCache
+	{
+	public:
+		RGLProgramCache();
+
+		/**
+		 * Reads the binaries stored in the given file. Does nothing if the filename is empty.
+		 */
+		void Open(const std::string &file, const std::string &driver);
+
+		/**
+		 * Puts the binary stored under the given key into the program.
+		 * Returns false if there is none, or the driver didn't take it.
+		 */
+		bool LoadProgram(uint64_t key, GLuint program);
+
+		/**
+		 * Gets the binary of the freshly linked program and adds it to the file
+		 */
+		void StoreProgram(uint64_t key, GLuint program);
+
+		/**
+		 * Returns true if a file is used
+		 */
+		bool IsEnabled() const
+		{ return !File.empty(); }
+
+		const RGLProgramCacheStats &GetStats() const
+		{ return Stats; }
+
+		/**
+		 * Hash which stays the same between runs, for the keys and the driver
+		 */
+		static uint64_t HashString(const std::string &s, uint64_t hash = 14695981039346656037ULL);
+
+	private:
+		/**
+		 * Truncates the file and writes a new header for the given driver
+		 */
+		void StartOver(uint64_t driverHash);
+
+		struct Entry
+		{
+			GLenum Format;
+			std::vector<uint8_t> Binary;
+		};
+
+		std::unordered_map<uint64_t, Entry> Entries;
+		std::string File;
+		RGLProgramCacheStats Stats;
+	};
+}
+#endif
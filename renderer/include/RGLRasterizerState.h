@@ -1,5 +1,6 @@
 #pragma once
 #include "RBaseRasterizerState.h"
+#include "RGLStateCache.h"
 
 #ifdef RND_GL
 namespace RAPI
@@ -10,8 +11,21 @@ namespace RAPI
 		/**
 		 * API-Version of CreateState
 		 */
-		bool CreateStateAPI(){return true;}
+		bool CreateStateAPI();
+
+		/**
+		 * Returns the GL-Values this state was converted to
+		 */
+		const RGLRasterizerRecord &GetRecordAPI() const { return Record; }
+
+		/**
+		 * Converts the given stateinfo to GL-Values
+		 */
+		static RGLRasterizerRecord MakeRecord(const RRasterizerStateInfo &info);
+
+	private:
+		RGLRasterizerRecord Record;
 	};
 
 }
-#endif
\ No newline at end of file
+#endif
@@ -7,10 +7,23 @@ namespace RAPI
 	class RGLSamplerState : public RBaseSamplerState
 	{
 	public:
+		RGLSamplerState();
+
+		~RGLSamplerState();
+
 		/**
 		 * API-Version of CreateState
 		 */
-		bool CreateStateAPI(){return true;}
+		bool CreateStateAPI();
+
+		/**
+		 * Returns the sampler-object of this state
+		 */
+		GLuint GetSamplerObjectAPI() const { return SamplerObject; }
+
+	private:
+		// Sampler-object made from the stateinfo
+		GLuint SamplerObject;
 	};
 }
-#endif
\ No newline at end of file
+#endif
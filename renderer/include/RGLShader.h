@@ -11,7 +11,8 @@ namespace RAPI
 		~RGLShader();
 
 		/**
-		* Loads the given shader
+		* Loads the given shader. Compiling only gets started here if the driver does it in the background,
+		* finishing it is left to the first link which needs it.
 		*/
 		bool CompileShaderAPI(EShaderType shaderType);
 
@@ -21,16 +22,36 @@ namespace RAPI
 		GLuint LinkShaderObjectAPI(RGLShader** shaders, size_t numShaders);
 
 		/**
-		 * Returns the unlinked shaderobject of this 
+		 * Returns the unlinked shaderobject of this. Compiles it first, if that didn't happen yet.
 		 */
-		GLuint GetShaderObjectAPI(){return ShaderObject;}
+		GLuint GetShaderObjectAPI();
+
+		/**
+		 * Hash of the type and source of this, which stays the same between runs
+		 */
+		uint64_t GetSourceHashAPI(){return SourceHash;}
 
 	protected:
+		/**
+		 * Hands the source to the driver and starts compiling it
+		 */
+		void StartCompile();
+
+		/**
+		 * Waits for the compiler and logs its errors
+		 */
+		bool FinishCompile();
+
 		// Unlinked Shader-object
 		GLuint ShaderObject;
 
-		// Source which created the shader
+		// Whether the result of compiling ShaderObject was checked already
+		bool CompileFinished;
+
+		// Source which created the shader, its type and a hash of both
 		std::string ShaderSource;
+		EShaderType ShaderType;
+		uint64_t SourceHash;
 
 		// Map of shader programs this is used with
 		std::unordered_map<size_t, GLuint> ProgramMap;
@@ -0,0 +1,257 @@
+#pragma once
+#include "pch.h"
+
+#ifdef RND_GL
+namespace RAPI
+{
+	/**
+	 * Limits of the GL-Device, queried once when the context is set up
+	 */
+	struct RGLLimits
+	{
+		RGLLimits()
+		{
+			MaxTextureUnits = 0;
+			MaxUniformBufferBindings = 0;
+			MaxVertexAttribs = 0;
+			UniformBufferOffsetAlignment = 0;
+			MaxAnisotropy = 1.0f;
+			DirectStateAccess = false;
+		}
+
+		GLint MaxTextureUnits;
+		GLint MaxUniformBufferBindings;
+		GLint MaxVertexAttribs;
+		GLint UniformBufferOffsetAlignment;
+		GLfloat MaxAnisotropy;
+
+		// Whether objects are created and edited without binding them, through ARB_direct_state_access
+		bool DirectStateAccess;
+	};
+
+	/**
+	 * Compact GL-Version of a blendstate, made once when the state is created
+	 */
+	struct RGLBlendRecord
+	{
+		GLboolean Enabled;
+		GLboolean AlphaToCoverage;
+		GLboolean ColorWrites;
+		GLenum SrcRGB;
+		GLenum DstRGB;
+		GLenum EquationRGB;
+		GLenum SrcAlpha;
+		GLenum DstAlpha;
+		GLenum EquationAlpha;
+	};
+
+	/**
+	 * Compact GL-Version of a rasterizerstate
+	 */
+	struct RGLRasterizerRecord
+	{
+		GLboolean CullEnabled;
+		GLenum CullFace;
+		GLenum FrontFace;
+		GLenum PolygonMode;
+		GLboolean DepthClamp;
+		GLfloat DepthBias;
+	};
+
+	/**
+	 * Compact GL-Version of a depthstencilstate
+	 */
+	struct RGLDepthStencilRecord
+	{
+		GLboolean DepthTest;
+		GLboolean DepthWrites;
+		GLenum DepthFunc;
+	};
+
+	/**
+	 * Counts of the calls going through the state cache
+	 */
+	struct RGLStateCacheStats
+	{
+		RGLStateCacheStats() : NumCalls(0), NumAvoided(0) {}
+
+		// Calls asked for
+		unsigned int NumCalls;
+
+		// Calls which were skipped, because the value was already set
+		unsigned int NumAvoided;
+	};
+
+	/**
+	 * Shadows the GL-State of the context and skips calls which wouldn't change anything. Everything binding
+	 * a program, VAO, buffer, texture or fixed-function state must go through this, or the shadowed values
+	 * will be wrong. Objects have to be reported when deleted, as GL unbinds them and reuses their names.
+	 */
+	class RGLStateCache
+	{
+	public:
+		RGLStateCache();
+
+		/**
+		 * Sizes the per-unit tables for the given limits and forgets everything known about the context
+		 */
+		void Init(const RGLLimits &limits);
+
+		/**
+		 * Forgets everything known about the context, so all following calls go through
+		 */
+		void Invalidate();
+
+		/**
+		 * Starts counting the calls of a new frame
+		 */
+		void OnFrameStart();
+
+		/**
+		 * Binding of objects
+		 */
+		void UseProgram(GLuint program);
+
+		void BindVertexArray(GLuint vao);
+
+		void BindBuffer(GLenum target, GLuint buffer);
+
+		void BindBufferBase(GLenum target, GLuint index, GLuint buffer);
+
+		void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+		/**
+		 * Binds the 2D-Texture to the given unit
+		 */
+		void BindTexture(GLuint unit, GLuint texture);
+
+		/**
+		 * Binds the 2D-Texture to the active unit, for uploading data to it
+		 */
+		void BindTextureForEdit(GLuint texture);
+
+		/**
+		 * Binds the sampler-object to the given unit
+		 */
+		void BindSampler(GLuint unit, GLuint sampler);
+
+		/**
+		 * Fixed-function state
+		 */
+		void Enable(GLenum cap);
+
+		void Disable(GLenum cap);
+
+		void SetEnabled(GLenum cap, bool enabled);
+
+		void DepthFunc(GLenum func);
+
+		void CullFace(GLenum mode);
+
+		void FrontFace(GLenum mode);
+
+		void Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+		void DepthRange(GLfloat nearVal, GLfloat farVal);
+
+		void DepthMask(GLboolean enabled);
+
+		void ColorMask(GLboolean enabled);
+
+		void BlendFunc(GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha);
+
+		void BlendEquation(GLenum modeRGB, GLenum modeAlpha);
+
+		void PolygonMode(GLenum mode);
+
+		void PolygonOffset(GLfloat units);
+
+		/**
+		 * Applies the precomputed states, only touching what differs from the current GL-State
+		 */
+		void ApplyBlendState(const RGLBlendRecord &blend);
+
+		void ApplyRasterizerState(const RGLRasterizerRecord &rasterizer);
+
+		void ApplyDepthStencilState(const RGLDepthStencilRecord &depthStencil);
+
+		/**
+		 * Must be called when deleting objects, GL unbinds them everywhere
+		 */
+		void OnProgramDeleted(GLuint program);
+
+		void OnVertexArrayDeleted(GLuint vao);
+
+		void OnBufferDeleted(GLuint buffer);
+
+		void OnTextureDeleted(GLuint texture);
+
+		void OnSamplerDeleted(GLuint sampler);
+
+		/**
+		 * Returns the counts of the last finished frame
+		 */
+		const RGLStateCacheStats &GetLastFrameStats() const
+		{ return LastFrameStats; }
+
+	private:
+		/**
+		 * Counts a call and returns true if it has to be done
+		 */
+		bool Check(bool unchanged)
+		{
+			FrameStats.NumCalls++;
+			if(unchanged)
+				FrameStats.NumAvoided++;
+
+			return !unchanged;
+		}
+
+		/**
+		 * Index of the given target in the buffer table. -1 for targets which aren't shadowed.
+		 */
+		static int GetBufferTargetIndex(GLenum target);
+
+		/**
+		 * Index of the given capability in the enabled-table. -1 for ones which aren't shadowed.
+		 */
+		static int GetCapIndex(GLenum cap);
+
+		/**
+		 * Switches the active texture unit
+		 */
+		void ActiveTexture(GLuint unit);
+
+		// Number of buffer targets and capabilities which are shadowed
+		static const int NUM_BUFFER_TARGETS = 7;
+		static const int NUM_CAPS = 9;
+
+		// Bound objects
+		GLuint Program;
+		GLuint VertexArray;
+		GLuint Buffers[NUM_BUFFER_TARGETS];
+		std::vector<GLuint> UniformBuffers;
+		std::vector<GLintptr> UniformBufferOffsets;
+		std::vector<GLuint> Textures;
+		std::vector<GLuint> Samplers;
+		GLuint ActiveTextureUnit;
+
+		// Fixed-function state. Enabled-flags are 0, 1 or unknown.
+		GLuint Caps[NUM_CAPS];
+		GLenum DepthFuncValue;
+		GLenum CullFaceValue;
+		GLenum FrontFaceValue;
+		GLint ViewportValue[4];
+		GLfloat DepthRangeValue[2];
+		GLuint DepthMaskValue;
+		GLuint ColorMaskValue;
+		GLenum BlendFuncValue[4];
+		GLenum BlendEquationValue[2];
+		GLenum PolygonModeValue;
+		GLfloat PolygonOffsetValue;
+
+		RGLStateCacheStats FrameStats;
+		RGLStateCacheStats LastFrameStats;
+	};
+}
+#endif
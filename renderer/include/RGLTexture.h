@@ -1,7 +1,13 @@
 #pragma once
 #include "RBaseTexture.h"
+#include "RGLTextureUploader.h"
 
 #ifdef RND_GL
+namespace nv_dds
+{
+	class CDDSImage;
+}
+
 namespace RAPI
 {
 	class RGLTexture : public RBaseTexture
@@ -27,12 +33,13 @@ namespace RAPI
 		bool UpdateSubresourceAPI(void* data, int mipLevel = 0, int arrayIndex = 0);
 
 		/**
-        * Maps the texture for update. Only possible with the right CPU-Acces and usage-flags.
+        * Maps the texture for update. Hands out space in the upload-ring, which may be written from any thread
+        * until the texture is unmapped. Map and Unmap themselves have to be called from the thread owning the GL-Context.
         */
 		bool MapAPI(void** dataOut, int subresource);
 
 		/**
-        * Unmaps the texture
+        * Unmaps the texture and starts uploading what was written
         */
 		bool UnmapAPI(int subresource);
 
@@ -51,18 +58,65 @@ namespace RAPI
 		 * Returns the texture-object owned by this texture
 		 */
 		GLuint GetTextureObjectAPI() { return TextureObject; }
+
+		/**
+		* Called by the upload-ring when the GPU is done with an upload of this
+		*/
+		void OnUploadFinishedGL();
 	private:
 
 		/**
 		* Cleans the created API-Resources
 		*/
 		void CleanAPI();
+
+		/**
+		* Creates the texture-object and puts all levels of the given image into it
+		*/
+		bool CreateFromImageGL(nv_dds::CDDSImage& image);
+
+		/**
+		* Creates the texture-object and reserves the memory of all levels of the image, without filling them
+		*/
+		bool CreateStorageGL(nv_dds::CDDSImage& image);
+
+		/**
+		* Same as CreateStorageGL, but without binding the texture. Gets immutable storage for all levels.
+		*/
+		bool CreateStorageDSA(nv_dds::CDDSImage& image);
+
+		/**
+		* Fills the given level. Goes through the upload-ring if possible, directly from the given memory otherwise.
+		*/
+		void WriteLevelGL(int level, const void* data, size_t size);
+
+		/**
+		* Issues the upload of an allocation of the upload-ring into the given level
+		*/
+		void UploadFromRingGL(int level, const RGLUploadAllocation& allocation);
+
+		/**
+		* Copies the texels of a whole level into the texture
+		*/
+		void UploadLevelGL(int level, const void* data, size_t size);
+
+		/**
+		* Sets how the bound texture is sampled
+		*/
+		void SetSamplingParametersGL();
 		/**
 		 * Texture handle
 		 */
 		GLuint TextureObject;
 		GLenum GLTextureFormat;
-		GLenum GLTextureType;
+		bool IsCompressed;
+
+		// Uploads the GPU isn't done with yet. The texture is ready once there are none left.
+		unsigned int PendingUploads;
+
+		// Ring-space handed out by MapAPI
+		RGLUploadAllocation MappedUpload;
+		int MappedSubresource;
 	};
 }
 #endif
\ No newline at end of file
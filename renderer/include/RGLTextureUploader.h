@@ -0,0 +1,112 @@
+#pragma once
+#include "pch.h"
+#include <deque>
+
+#ifdef RND_GL
+namespace RAPI
+{
+	class RGLTexture;
+
+	// Size of the persistently mapped buffer texel-data is staged in
+	const size_t GL_TEXTURE_UPLOAD_RING_SIZE = 32 * 1024 * 1024;
+
+	/**
+	 * Space of the upload-ring handed out for a single upload
+	 */
+	struct RGLUploadAllocation
+	{
+		RGLUploadAllocation() : Mapped(nullptr), Offset(0), Size(0) {}
+
+		// Where to write the texels to
+		uint8_t *Mapped;
+
+		// Where they are inside the pixel-unpack-buffer, to be passed as data-pointer of the upload
+		GLintptr Offset;
+		size_t Size;
+	};
+
+	/**
+	 * Streams texel-data to the GPU through a ring of persistently mapped pixel-unpack-buffer space, so
+	 * uploads don't have to wait for the driver to copy from client memory. Each upload gets a fence,
+	 * which frees its space and marks the texture ready once the GPU is done with it.
+	 *
+	 * Allocating and submitting must happen on the thread owning the GL-Context. The memory of an
+	 * allocation may be written from any thread until it is submitted.
+	 */
+	class RGLTextureUploader
+	{
+	public:
+		RGLTextureUploader();
+
+		/**
+		 * Creates the ring. Needs ARB_buffer_storage, uploads go directly from client memory without it.
+		 */
+		bool Init();
+
+		/**
+		 * Deletes the ring, after waiting for all uploads still in flight
+		 */
+		void Clear();
+
+		/**
+		 * Returns true if uploads can go through the ring
+		 */
+		bool IsEnabled() const
+		{ return Buffer != 0; }
+
+		/**
+		 * Hands out ring-space for the given number of bytes. Waits for earlier uploads if the ring is full.
+		 * Returns false if the size doesn't fit, or the ring is blocked by allocations not submitted yet.
+		 */
+		bool Allocate(size_t size, RGLUploadAllocation &allocation);
+
+		/**
+		 * Binds the ring as pixel-unpack-buffer, so the offset of an allocation can be used as data-pointer
+		 */
+		void BindForUpload();
+
+		/**
+		 * Unbinds the ring again. Uploads from client memory would read from the ring otherwise.
+		 */
+		void UnbindForUpload();
+
+		/**
+		 * Must be called after the upload-calls reading the allocation were issued. Puts in the fence
+		 * which tells when the space can be reused and the given texture is done.
+		 */
+		void Submit(const RGLUploadAllocation &allocation, RGLTexture *texture);
+
+		/**
+		 * Checks the fences of the uploads in flight, without waiting. Called once per frame.
+		 */
+		void Update();
+
+		/**
+		 * Forgets about uploads of the given texture
+		 */
+		void OnTextureDeleted(RGLTexture *texture);
+
+	private:
+		struct Upload
+		{
+			GLintptr Begin;
+			GLintptr End;
+			GLsync Fence;
+			RGLTexture *Texture;
+		};
+
+		/**
+		 * Finishes the oldest upload, waiting for it if needed.
+		 * Returns false if it wasn't submitted yet.
+		 */
+		bool RetireOldest(bool wait);
+
+		GLuint Buffer;
+		uint8_t *Mapped;
+
+		// Next free byte. Uploads in flight start at the one of the oldest and go up to here, wrapping around.
+		GLintptr Head;
+		std::deque<Upload> Uploads;
+	};
+}
+#endif
@@ -0,0 +1,84 @@
+#pragma once
+#include "pch.h"
+
+#ifdef RND_GL
+namespace RAPI
+{
+	class RBuffer;
+	class RInputLayout;
+
+	/**
+	 * Everything a VAO is made from. The buffers are the GL-Objects and offsets their current data is at,
+	 * so dynamic buffers moving to another region get a VAO of their own instead of rebuilding one.
+	 */
+	struct RGLVertexArrayKey
+	{
+		RGLVertexArrayKey()
+		{
+			// Compared and hashed as a whole, padding included
+			memset(this, 0, sizeof(*this));
+		}
+
+		const RInputLayout *InputLayout;
+		GLuint VertexBuffers[2];
+		GLintptr VertexBufferOffsets[2];
+		GLsizei VertexBufferStrides[2];
+		GLuint IndexBuffer;
+
+		bool operator==(const RGLVertexArrayKey &other) const
+		{ return memcmp(this, &other, sizeof(*this)) == 0; }
+	};
+
+	struct RGLVertexArrayKeyHash
+	{
+		size_t operator()(const RGLVertexArrayKey &key) const;
+	};
+
+	/**
+	 * VAOs of every combination of input layout, vertexbuffers and indexbuffer drawn with. Made on
+	 * first use and kept until one of the objects they point to is deleted, so the same buffers can be
+	 * drawn with any number of layouts without specifying the attributes again.
+	 */
+	class RGLVertexArrayCache
+	{
+	public:
+		/**
+		 * Returns the VAO for the given buffers and layout, creating it if needed.
+		 * Leaves it bound in the state cache.
+		 */
+		GLuint BindVertexArray(const RInputLayout *inputLayout, RBuffer *vertexBuffer0, RBuffer *vertexBuffer1, RBuffer *indexBuffer);
+
+		/**
+		 * Must be called when deleting objects, to drop the VAOs using them
+		 */
+		void OnBufferDeleted(GLuint buffer);
+
+		void OnInputLayoutDeleted(const RInputLayout *inputLayout);
+
+		/**
+		 * Deletes all VAOs
+		 */
+		void Clear();
+
+		/**
+		 * Returns the number of VAOs currently alive
+		 */
+		size_t GetNumVertexArrays() const
+		{ return VertexArrays.size(); }
+
+	private:
+		/**
+		 * Points the attributes of the bound VAO to the buffers of the key
+		 */
+		bool SpecifyAttributes(const RGLVertexArrayKey &key);
+
+		/**
+		 * Deletes all VAOs the given function returns true for
+		 */
+		template<typename Fn>
+		void DeleteWhere(Fn fn);
+
+		std::unordered_map<RGLVertexArrayKey, GLuint, RGLVertexArrayKeyHash> VertexArrays;
+	};
+}
+#endif
@@ -28,6 +28,12 @@ namespace RAPI
          */
         bool UpdateDataAPI(const void *data, size_t dataSize = 0){return true;}
 
+        /**
+         * Copies the contents of this buffer into the given memory. Nothing is stored here, so
+         * there is nothing to read.
+         */
+        bool ReadBackAPI(void *data){return false;}
+
         /**
          * Deletes all resources this holds but keeps the object around.
          * Recreate the buffer by calling Init
@@ -1,5 +1,7 @@
 #pragma once
 #include "RBaseCommandList.h"
+#include "RCommandBuffer.h"
+#include "RDrawPackets.h"
 
 namespace RAPI
 {
@@ -9,10 +11,27 @@ namespace RAPI
 		/** Initializes a commandlist for the given Thread ID */
 		bool InitAPI(){return true;}
 
+		/** Records the given packet of a renderqueue into this commandlist */
+		bool RecordDrawPacketAPI(const RDrawPackets &packets, size_t index, const RStateMachine::ChangesStruct &changes,
+								 RStateMachine &stateMachine)
+		{
+			Commands.RecordDrawPacket(packets, index, changes, stateMachine);
+			return true;
+		}
+
 		/** Creates the commandlist and makes it ready to be played back */
 		bool FinalizeCommandListAPI(){return true;}
 
 		/** Plays the generated commandlist back on the main-thread */
-		bool ExecuteCommandListAPI(){return true;}
+		bool ExecuteCommandListAPI()
+		{
+			// Nothing to call, but recording still goes through the same path as on the real APIs
+			Commands.Reset();
+			return true;
+		}
+
+	protected:
+		// Recorded commands
+		RCommandBuffer Commands;
 	};
-}
\ No newline at end of file
+}
@@ -50,7 +50,21 @@ namespace RAPI
 		/**
          * Renders an array of pipeline-states
          */
-		bool DrawPipelineStatesAPI(struct RPipelineState *const *stateArray, unsigned int numStates){return true;}
+		bool DrawPipelineStatesAPI(const struct RPipelineState *const *stateArray, unsigned int numStates)
+		{
+			// Keep the statemachine going, like single draws do
+			for(unsigned int i = 0; i < numStates; i++)
+			{
+				ContextStateMachine.SetFromPipelineState(stateArray[i]);
+				ContextStateMachine.ResetChanges();
+			}
+			return true;
+		}
+
+		/**
+         * Nothing to link here
+         */
+		bool PrecompileProgramsAPI(const struct RPipelineState *const *stateArray, unsigned int numStates){return true;}
 
 		/**
          * Registers a thread in the renderer. Creates a resources like a deferred context.
@@ -72,6 +86,12 @@ namespace RAPI
         */
 		bool PrepareContextAPI(unsigned int threadId){return true;}
 
+		/**
+		* Binds the API-Context to the calling thread, or releases it from there
+		*/
+		bool MakeContextCurrentAPI(){return true;}
+		bool ReleaseContextAPI(){return true;}
+
 		/**
 		* Returns the resolution needed for the given window
 		*/
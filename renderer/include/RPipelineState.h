@@ -17,6 +17,7 @@ namespace RAPI
 		RPipelineState()
 		{
 			memset(&Key, 0xFF, sizeof(Key));
+			_APIProgram = 0;
 			Locked = false;
 		}
 
@@ -118,6 +119,13 @@ namespace RAPI
 		uint32_t _ConstantBuffersHash[EShaderType::ST_NUM_SHADER_TYPES];
 		std::array<class RBuffer *, RAPI_MAX_NUM_SHADER_RESOURCES> ConstantBuffers[EShaderType::ST_NUM_SHADER_TYPES];
 
+		// Combination of all of the counts and hashes above, so queues can skip comparing them one by one
+		uint32_t _ResourceTablesHash;
+
+		// Backend-private, resolved by the device the first time the state is drawn.
+		// The linked shader-program on GL, unused elsewhere.
+		uint32_t _APIProgram;
+
 		unsigned int NumDrawElements; // Vertices, indices...
 		unsigned int StartVertexOffset;
 		unsigned int StartIndexOffset;
@@ -1,5 +1,7 @@
 #pragma once
 #include "RResource.h"
+#include <atomic>
+#include <mutex>
 #include <set>
 #include <unordered_map>
 #include <vector>
@@ -19,6 +21,8 @@ namespace RAPI
 		/**
 		 * Returns a new resource from the given type.
 		 * IMPORTANT: T must be a RResource-Type!
+		 * Creating and deleting resources is safe from multiple threads. Looking them up by ID while
+		 * an other thread creates one of the same type is not.
 		 */
 		template<typename T>
 		T *CreateResource()
@@ -26,32 +30,25 @@ namespace RAPI
 			// Find the cache-slot of this
 			RCache &cache = RCacheTyped<T>::Cache;
 
-			RegisteredCaches.insert(&RCacheTyped<T>::Cache);
+			RegisterCache(cache);
 
-			// Check if we got any free-objects
-			if (!cache.FreeMemory.empty()) {
-				// Get a free index
-				unsigned int f = cache.FreeMemory.back();
-				cache.FreeMemory.pop_back();
-
-				// Reallocate (Call constructor on memory)
-				// TODO: Allocate linearly
-				cache.Objects[f] = (RResource *) new(cache.Objects[f])T();
-
-				// Re-set the id
-				cache.Objects[f]->SetID(f);
+			std::lock_guard<std::mutex> lock(cache.Mutex);
+			return CreateResourceLocked<T>(cache);
+		}
 
-				return (T *) cache.Objects[f];
-			} else {
-				// Create a totally new object
-				T *obj = (T *) new T();
-				cache.Objects.push_back(obj);
+		/**
+		 * Creates multiple resources of the given type at once, only locking the cache a single time
+		 */
+		template<typename T>
+		void CreateResources(T **resources, unsigned int num)
+		{
+			RCache &cache = RCacheTyped<T>::Cache;
 
-				// Set the current id
-				cache.Objects.back()->SetID((unsigned int)cache.Objects.size() - 1);
+			RegisterCache(cache);
 
-				return (T *) obj;
-			}
+			std::lock_guard<std::mutex> lock(cache.Mutex);
+			for (unsigned int i = 0; i < num; i++)
+				resources[i] = CreateResourceLocked<T>(cache);
 		}
 
 		/**
@@ -73,6 +70,8 @@ namespace RAPI
 			// Find the cache-slot of this
 			RCache &cache = RCacheTyped<T>::Cache;
 
+			std::lock_guard<std::mutex> lock(cache.Mutex);
+
 			// Remove from cachelist
 			unsigned int id = resource->GetID();
 
@@ -107,14 +106,14 @@ namespace RAPI
 		template<typename T>
 		void AddToCache(size_t hash, T *object)
 		{
-			RegisteredCaches.insert(&RCacheTyped<T>::Cache);
+			RegisterCache(RCacheTyped<T>::Cache);
 			RCacheTyped<T>::Cache.HashCache[hash] = object;
 		}
 
 		template<typename T>
 		void AddToCache(const std::string &alias, T *object)
 		{
-			RegisteredCaches.insert(&RCacheTyped<T>::Cache);
+			RegisterCache(RCacheTyped<T>::Cache);
 			RCacheTyped<T>::Cache.HashCache[std::hash<std::string>()(alias)] = object;
 		}
 
@@ -172,8 +171,59 @@ namespace RAPI
 			std::vector<unsigned int> FreeMemory;
 
 			std::unordered_map<size_t, void *> HashCache;
+
+			// Guards creating and deleting objects
+			std::mutex Mutex;
+
+			// Whether this is in the set of registered caches
+			std::atomic<bool> Registered;
 		};
 
+		/**
+		 * Creates a resource in the given cache. Its mutex must be held.
+		 */
+		template<typename T>
+		T *CreateResourceLocked(RCache &cache)
+		{
+			// Check if we got any free-objects
+			if (!cache.FreeMemory.empty()) {
+				// Get a free index
+				unsigned int f = cache.FreeMemory.back();
+				cache.FreeMemory.pop_back();
+
+				// Reallocate (Call constructor on memory)
+				// TODO: Allocate linearly
+				cache.Objects[f] = (RResource *) new(cache.Objects[f])T();
+
+				// Re-set the id
+				cache.Objects[f]->SetID(f);
+
+				return (T *) cache.Objects[f];
+			} else {
+				// Create a totally new object
+				T *obj = (T *) new T();
+				cache.Objects.push_back(obj);
+
+				// Set the current id
+				cache.Objects.back()->SetID((unsigned int)cache.Objects.size() - 1);
+
+				return (T *) obj;
+			}
+		}
+
+		/**
+		 * Remembers the given cache, so its objects are deleted with this
+		 */
+		void RegisterCache(RCache &cache)
+		{
+			if (cache.Registered.load(std::memory_order_acquire))
+				return;
+
+			std::lock_guard<std::mutex> lock(RegisteredCachesMutex);
+			RegisteredCaches.insert(&cache);
+			cache.Registered.store(true, std::memory_order_release);
+		}
+
 		// Resource caches. The idea is that every templated version of this class has its own
 		// memory locations for the static parameters. This way we can statically get the right
 		// RCache just by giving the type at compile time
@@ -184,6 +234,7 @@ namespace RAPI
 		};
 
 		std::set<RCache *> RegisteredCaches;
+		std::mutex RegisteredCachesMutex;
 	};
 
 // Definition of the Cache-Member.
@@ -4,6 +4,11 @@
 #include <sstream>
 #include <array>
 
+// Number of constant-buffer slots a single view can override
+#ifndef RAPI_MAX_VIEW_CONSTANT_BUFFERS
+#define RAPI_MAX_VIEW_CONSTANT_BUFFERS 4
+#endif
+
 namespace RAPI
 {
 	class RBuffer;
@@ -94,13 +99,60 @@ namespace RAPI
 
 	class RDepthStencilState;
 
+	class RViewport;
+
+	/**
+	 * Resources replacing the ones of every pipeline-state drawn while set, for drawing the same states
+	 * into multiple views. Typically the constant buffer holding the view-matrices and the viewport.
+	 */
+	struct RViewOverrides
+	{
+		RViewOverrides()
+		{
+			Viewport = nullptr;
+			NumConstantBuffers = 0;
+		}
+
+		/**
+		 * Replaces the constant buffer in the given slot
+		 */
+		void SetConstantBuffer(unsigned int slot, RBuffer *buffer, EShaderType stage)
+		{
+			if(NumConstantBuffers == RAPI_MAX_VIEW_CONSTANT_BUFFERS)
+				return;
+
+			ConstantBuffers[NumConstantBuffers].Stage = stage;
+			ConstantBuffers[NumConstantBuffers].Slot = slot;
+			ConstantBuffers[NumConstantBuffers].Buffer = buffer;
+			NumConstantBuffers++;
+		}
+
+		/**
+		 * Replaces the viewport. nullptr keeps the one of the state.
+		 */
+		void SetViewport(RViewport *viewport)
+		{ Viewport = viewport; }
+
+		struct ConstantBufferOverride
+		{
+			EShaderType Stage;
+			unsigned int Slot;
+			RBuffer *Buffer;
+		};
+
+		ConstantBufferOverride ConstantBuffers[RAPI_MAX_VIEW_CONSTANT_BUFFERS];
+		unsigned int NumConstantBuffers;
+
+		RViewport *Viewport;
+	};
+
 	class RStateMachine
 	{
 	public:
 
 		RStateMachine(void);
 
-		~RStateMachine(void);
+		virtual ~RStateMachine(void);
 
 		struct ChangesStruct
 		{
@@ -207,7 +259,7 @@ namespace RAPI
 		/**
 		 * Returns the current state
 		 */
-		const RPipelineStateFull &GetCurrentState()
+		const RPipelineStateFull &GetCurrentState() const
 		{ return State; }
 
 		/** Returns the count of changes of states */
@@ -255,12 +307,25 @@ namespace RAPI
 
 		void SetViewport(class RViewport *viewport);
 
+		/**
+		 * Makes every following SetFromPipelineState use the given resources instead of the ones of the state.
+		 * The overrides are only bound along with a change of their slots, so invalidate or force the changes
+		 * of the first draw after setting them. nullptr goes back to the states own resources.
+		 */
+		void SetOverrides(const RViewOverrides *overrides)
+		{ Overrides = overrides; }
+
 		/**
 		* Sets the values from a pipeline-state-object to the current state
 		*/
 		void AssignPipelineStateValues(RPipelineState *state);
 
-	private:
+	protected:
+
+		/**
+		 * Returns a new pipeline-state for the MakeDrawCall-functions
+		 */
+		virtual RPipelineState *AllocatePipelineState();
 
 
 		/**
@@ -268,12 +333,20 @@ namespace RAPI
 		 */
 		void SetDrawOrderFor(RPipelineStateFull *state);
 
+		/**
+		 * Puts the overriding resources into the current state
+		 */
+		void ApplyOverrides();
+
 		// Current state, consisting of real objects, rather than IDs
 		RPipelineStateFull State;
 
 		// Set of changes after the last SetFromPipelineState
 		ChangesStruct Changes;
 		ChangesCountStruct ChangesCount;
+
+		// Resources to use instead of the states ones, if set
+		const RViewOverrides *Overrides;
 	};
 
 
@@ -11,7 +11,6 @@ public:
 #define THREAD_POOL_H
 
 #include <vector>
-#include <queue>
 #include <memory>
 #include <thread>
 #include <mutex>
@@ -19,10 +18,86 @@ public:
 #include <future>
 #include <functional>
 #include <stdexcept>
+#include <atomic>
+#include <type_traits>
+#include <algorithm>
+#include <cstddef>
+#include "RWorkStealingDeque.h"
 
 namespace RAPI
 {
+    // Number of tasks a single thread can have in flight before new tasks get executed inline
+    const size_t THREADPOOL_TASKS_PER_THREAD = 1024;
 
+    // Maximum number of threads (workers and external ones) which can submit tasks to a pool
+    const size_t THREADPOOL_MAX_CONTEXTS = 128;
+
+    // How many chunks per thread parallel_for aims for when no grainsize was given
+    const size_t THREADPOOL_CHUNKS_PER_THREAD = 4;
+
+    // Number of rounds an idle worker looks for work before going to sleep
+    const int THREADPOOL_SPIN_ROUNDS = 64;
+
+    /**
+     * Type erased, move-only callable with inline storage, so queueing a task doesn't need to allocate.
+     * Callables which don't fit are moved to the heap.
+     */
+    class RTask
+    {
+    public:
+        static const size_t INLINE_STORAGE_SIZE = 96;
+
+        RTask() : InvokeFn(nullptr)
+        { }
+
+        template<class F>
+        void Set(F &&f)
+        {
+            typedef typename std::decay<F>::type Fn;
+            SetImpl<Fn>(std::forward<F>(f), std::integral_constant<bool, sizeof(Fn) <= INLINE_STORAGE_SIZE &&
+                    std::alignment_of<Fn>::value <= std::alignment_of<std::max_align_t>::value>());
+        }
+
+        /** Runs the task and destroys the stored callable */
+        void Run()
+        {
+            InvokeFn(Storage);
+        }
+
+    private:
+        template<class Fn, class F>
+        void SetImpl(F &&f, std::true_type)
+        {
+            new(Storage) Fn(std::forward<F>(f));
+            InvokeFn = [](void *s)
+            {
+                Fn &fn = *reinterpret_cast<Fn *>(s);
+                fn();
+                fn.~Fn();
+            };
+        }
+
+        template<class Fn, class F>
+        void SetImpl(F &&f, std::false_type)
+        {
+            *reinterpret_cast<Fn **>(Storage) = new Fn(std::forward<F>(f));
+            InvokeFn = [](void *s)
+            {
+                Fn *fn = *reinterpret_cast<Fn **>(s);
+                (*fn)();
+                delete fn;
+            };
+        }
+
+        typename std::aligned_storage<INLINE_STORAGE_SIZE, std::alignment_of<std::max_align_t>::value>::type Storage[1];
+        void (*InvokeFn)(void *);
+    };
+
+    /**
+     * Work-stealing threadpool. Every thread submitting work gets its own Chase-Lev deque and
+     * a fixed set of task-slots, so queueing never takes a lock or allocates. Idle workers steal
+     * from the other threads' deques.
+     */
     class RThreadPool
     {
     public:
@@ -32,6 +107,13 @@ namespace RAPI
         auto enqueue(F &&f, Args &&... args)
                 -> std::future<typename std::result_of<F(Args...)>::type>;
 
+        /**
+         * Calls fn(start, end) for chunks of [begin, end) on all threads, including the calling one.
+         * Returns once all chunks are done. If grainSize is 0, a chunksize is picked automatically.
+         */
+        template<class F>
+        void parallel_for(size_t begin, size_t end, F &&fn, size_t grainSize = 0);
+
         ~RThreadPool();
 
         size_t getNumThreads()
@@ -39,48 +121,285 @@ namespace RAPI
 
         std::vector<size_t> getThreadIDs();
 
+        /**
+         * Returns the index of the calling worker-thread in [0, getNumThreads()), or getNumThreads()
+         * if the caller isn't a worker of this pool.
+         */
+        size_t getCurrentWorkerIndex();
+
+        /**
+         * Runs one pending task on the calling thread, if there is any. Returns true if a task was run.
+         * Use this instead of blocking when waiting on other tasks.
+         */
+        bool tryRunPendingTask();
+
     private:
+        struct TaskSlot
+        {
+            TaskSlot()
+            { InUse.store(false, std::memory_order_relaxed); }
+
+            std::atomic<bool> InUse;
+            RTask Task;
+        };
+
+        struct ThreadContext
+        {
+            ThreadContext() : NextSlot(0)
+            { }
+
+            RWorkStealingDeque<TaskSlot *, THREADPOOL_TASKS_PER_THREAD> Deque;
+            TaskSlot Slots[THREADPOOL_TASKS_PER_THREAD];
+            size_t NextSlot;
+            std::thread::id Owner;
+        };
+
+        /** Puts a callable into the calling threads deque */
+        template<class F>
+        void submit(F &&f);
+
+        /** Returns the context of the calling thread, registers one if needed */
+        ThreadContext *getThreadContext();
+
+        /** Finds a free slot in the given context. Returns nullptr if all are in use. */
+        TaskSlot *allocateSlot(ThreadContext *ctx);
+
+        /** Runs the task in the given slot and gives the slot back */
+        void execute(TaskSlot *slot);
+
+        /** Tries to get a task from the own deque first, then from the others */
+        TaskSlot *findTask(ThreadContext *ctx, size_t stealStart);
+
+        /** Main-loop of a worker */
+        void workerLoop(size_t index);
+
+        /** Wakes a sleeping worker, if there is one */
+        void wakeWorker();
+
         // need to keep track of threads so we can join them
         std::vector<std::thread> workers;
-        // the task queue
-        std::queue<std::function<void()> > tasks;
 
-        // synchronization
-        std::mutex queue_mutex;
+        // One context per worker, followed by the contexts of external threads
+        std::unique_ptr<ThreadContext> contexts[THREADPOOL_MAX_CONTEXTS];
+        std::atomic<size_t> num_contexts;
+        std::mutex context_mutex;
+
+        // Number of tasks pushed but not yet picked up
+        std::atomic<int> pending_tasks;
+
+        // synchronization for sleeping workers
+        std::mutex sleep_mutex;
         std::condition_variable condition;
-        bool stop;
+        std::atomic<int> num_sleeping;
+        std::atomic<bool> stop;
         size_t num_threads;
+
+        // Unique ID to identify this pool in the thread-local caches
+        uint64_t pool_id;
+    };
+
+    struct RThreadPoolTLS
+    {
+        uint64_t PoolID;
+        void *Context;
+        size_t WorkerIndex;
     };
 
+    /** Per thread cache of the pool-context, so lookups are free after the first one */
+    inline RThreadPoolTLS &GetThreadPoolTLS()
+    {
+        static thread_local RThreadPoolTLS tls = {0, nullptr, (size_t)-1};
+        return tls;
+    }
+
+    /** Returns a new unique ID for a pool. IDs are never reused, unlike addresses. */
+    inline uint64_t MakeThreadPoolID()
+    {
+        static std::atomic<uint64_t> s_NextID(1);
+        return s_NextID.fetch_add(1);
+    }
+
 // the constructor just launches some amount of workers
     inline RThreadPool::RThreadPool(size_t threads)
-            : stop(false)
-    {
-        num_threads = threads;
-
-        for (size_t i = 0; i < threads; ++i)
-            workers.emplace_back(
-                    [this]
-                    {
-                        for (; ;)
-                        {
-                            std::function<void()> task;
-
-                            {
-                                std::unique_lock<std::mutex> lock(this->queue_mutex);
-                                this->condition.wait(lock,
-                                                     [&]
-                                                     { return this->stop || !this->tasks.empty(); });
-                                if (this->stop && this->tasks.empty())
-                                    return;
-                                task = std::move(this->tasks.front());
-                                this->tasks.pop();
-                            }
-
-                            task();
-                        }
-                    }
-            );
+    {
+        // Leave room for the external threads
+        num_threads = std::min(threads, THREADPOOL_MAX_CONTEXTS / 2);
+        pool_id = MakeThreadPoolID();
+        num_contexts.store(num_threads, std::memory_order_relaxed);
+        pending_tasks.store(0);
+        num_sleeping.store(0);
+        stop.store(false);
+
+        // Workers own the first contexts
+        for (size_t i = 0; i < num_threads; ++i)
+            contexts[i].reset(new ThreadContext());
+
+        for (size_t i = 0; i < num_threads; ++i)
+            workers.emplace_back(&RThreadPool::workerLoop, this, i);
+    }
+
+    inline void RThreadPool::workerLoop(size_t index)
+    {
+        ThreadContext *ctx = contexts[index].get();
+        ctx->Owner = std::this_thread::get_id();
+
+        RThreadPoolTLS &tls = GetThreadPoolTLS();
+        tls.PoolID = pool_id;
+        tls.Context = ctx;
+        tls.WorkerIndex = index;
+
+        size_t stealStart = index + 1;
+        for (; ;)
+        {
+            TaskSlot *slot = nullptr;
+            for (int i = 0; i < THREADPOOL_SPIN_ROUNDS && !slot; i++)
+            {
+                slot = findTask(ctx, stealStart++);
+
+                if (!slot)
+                    std::this_thread::yield();
+            }
+
+            if (slot)
+            {
+                execute(slot);
+                continue;
+            }
+
+            // Nothing to do, go to sleep until new tasks arrive
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            num_sleeping.fetch_add(1);
+            condition.wait(lock, [this]
+            { return stop.load() || pending_tasks.load() > 0; });
+            num_sleeping.fetch_sub(1);
+
+            if (stop.load() && pending_tasks.load() <= 0)
+                return;
+        }
+    }
+
+    inline RThreadPool::TaskSlot *RThreadPool::findTask(ThreadContext *ctx, size_t stealStart)
+    {
+        TaskSlot *slot = nullptr;
+
+        if (ctx && ctx->Deque.Pop(slot))
+        {
+            pending_tasks.fetch_sub(1);
+            return slot;
+        }
+
+        size_t n = num_contexts.load(std::memory_order_acquire);
+        for (size_t i = 0; i < n; i++)
+        {
+            ThreadContext *victim = contexts[(stealStart + i) % n].get();
+            if (victim && victim != ctx && victim->Deque.Steal(slot))
+            {
+                pending_tasks.fetch_sub(1);
+                return slot;
+            }
+        }
+
+        return nullptr;
+    }
+
+    inline void RThreadPool::execute(TaskSlot *slot)
+    {
+        slot->Task.Run();
+        slot->InUse.store(false, std::memory_order_release);
+    }
+
+    inline RThreadPool::ThreadContext *RThreadPool::getThreadContext()
+    {
+        RThreadPoolTLS &tls = GetThreadPoolTLS();
+        if (tls.PoolID == pool_id)
+            return (ThreadContext *) tls.Context;
+
+        std::thread::id id = std::this_thread::get_id();
+        std::unique_lock<std::mutex> lock(context_mutex);
+
+        // Maybe this thread was registered before and only used another pool in the meantime
+        size_t n = num_contexts.load(std::memory_order_relaxed);
+        ThreadContext *ctx = nullptr;
+        for (size_t i = num_threads; i < n; i++)
+        {
+            if (contexts[i]->Owner == id)
+                ctx = contexts[i].get();
+        }
+
+        if (!ctx)
+        {
+            if (n == THREADPOOL_MAX_CONTEXTS)
+                return nullptr;
+
+            contexts[n].reset(new ThreadContext());
+            ctx = contexts[n].get();
+            ctx->Owner = id;
+            num_contexts.store(n + 1, std::memory_order_release);
+        }
+
+        tls.PoolID = pool_id;
+        tls.Context = ctx;
+        tls.WorkerIndex = num_threads;
+        return ctx;
+    }
+
+    inline RThreadPool::TaskSlot *RThreadPool::allocateSlot(ThreadContext *ctx)
+    {
+        for (size_t i = 0; i < THREADPOOL_TASKS_PER_THREAD; i++)
+        {
+            TaskSlot *slot = &ctx->Slots[ctx->NextSlot];
+            ctx->NextSlot = (ctx->NextSlot + 1) % THREADPOOL_TASKS_PER_THREAD;
+
+            if (!slot->InUse.load(std::memory_order_acquire))
+            {
+                slot->InUse.store(true, std::memory_order_relaxed);
+                return slot;
+            }
+        }
+
+        return nullptr;
+    }
+
+    inline void RThreadPool::wakeWorker()
+    {
+        if (num_sleeping.load() > 0)
+        {
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            condition.notify_one();
+        }
+    }
+
+    template<class F>
+    void RThreadPool::submit(F &&f)
+    {
+        // don't allow enqueueing after stopping the pool
+        if (stop.load())
+            throw std::runtime_error("enqueue on stopped RThreadPool");
+
+        ThreadContext *ctx = getThreadContext();
+        TaskSlot *slot = ctx ? allocateSlot(ctx) : nullptr;
+
+        if (!slot || num_threads == 0)
+        {
+            // Too much work in flight already, just do it right here
+            if (slot)
+                slot->InUse.store(false, std::memory_order_relaxed);
+
+            typename std::decay<F>::type fn(std::forward<F>(f));
+            fn();
+            return;
+        }
+
+        slot->Task.Set(std::forward<F>(f));
+
+        if (!ctx->Deque.Push(slot))
+        {
+            execute(slot);
+            return;
+        }
+
+        pending_tasks.fetch_add(1);
+        wakeWorker();
     }
 
 // add new work item to the pool
@@ -90,31 +409,91 @@ namespace RAPI
     {
         using return_type = typename std::result_of<F(Args...)>::type;
 
-        auto task = std::make_shared<std::packaged_task<return_type()> >(
-                std::bind(std::forward<F>(f), std::forward<Args>(args)...)
-        );
+        // The packaged task goes straight into the task-slot, no extra shared_ptr or std::function
+        std::packaged_task<return_type()> task(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+        std::future<return_type> res = task.get_future();
+
+        submit(std::move(task));
+
+        return res;
+    }
+
+    template<class F>
+    void RThreadPool::parallel_for(size_t begin, size_t end, F &&fn, size_t grainSize)
+    {
+        if (begin >= end)
+            return;
+
+        size_t count = end - begin;
+        if (grainSize == 0)
+            grainSize = std::max((size_t) 1, count / ((num_threads + 1) * THREADPOOL_CHUNKS_PER_THREAD));
 
-        std::future<return_type> res = task->get_future();
+        size_t numChunks = (count + grainSize - 1) / grainSize;
+        if (numChunks == 1 || num_threads == 0)
         {
-            std::unique_lock<std::mutex> lock(queue_mutex);
+            fn(begin, end);
+            return;
+        }
+
+        std::atomic<size_t> nextChunk(0);
+        std::atomic<size_t> helpersDone(0);
 
-            // don't allow enqueueing after stopping the pool
-            if (stop)
-                throw std::runtime_error("enqueue on stopped RThreadPool");
+        // Chunks are picked up dynamically, so threads which got cheap chunks simply take more of them
+        auto runChunks = [&]()
+        {
+            size_t c;
+            while ((c = nextChunk.fetch_add(1)) < numChunks)
+            {
+                size_t s = begin + c * grainSize;
+                fn(s, std::min(end, s + grainSize));
+            }
+        };
 
-            tasks.emplace([task]()
-                          { (*task)(); });
+        size_t numHelpers = std::min(num_threads, numChunks - 1);
+        for (size_t i = 0; i < numHelpers; i++)
+        {
+            submit([&]()
+                   {
+                       runChunks();
+                       helpersDone.fetch_add(1, std::memory_order_release);
+                   });
         }
-        condition.notify_one();
-        return res;
+
+        runChunks();
+
+        // Helpers reference our stack, wait for all of them. Do some work meanwhile.
+        while (helpersDone.load(std::memory_order_acquire) < numHelpers)
+        {
+            if (!tryRunPendingTask())
+                std::this_thread::yield();
+        }
+    }
+
+    inline bool RThreadPool::tryRunPendingTask()
+    {
+        RThreadPoolTLS &tls = GetThreadPoolTLS();
+        ThreadContext *ctx = tls.PoolID == pool_id ? (ThreadContext *) tls.Context : nullptr;
+
+        TaskSlot *slot = findTask(ctx, (size_t) std::hash<std::thread::id>()(std::this_thread::get_id()));
+        if (!slot)
+            return false;
+
+        execute(slot);
+        return true;
+    }
+
+    inline size_t RThreadPool::getCurrentWorkerIndex()
+    {
+        RThreadPoolTLS &tls = GetThreadPoolTLS();
+        return tls.PoolID == pool_id && tls.WorkerIndex < num_threads ? tls.WorkerIndex : num_threads;
     }
 
 // the destructor joins all threads
     inline RThreadPool::~RThreadPool()
     {
         {
-            std::unique_lock<std::mutex> lock(queue_mutex);
-            stop = true;
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            stop.store(true);
         }
         condition.notify_all();
         for (std::thread &worker: workers)
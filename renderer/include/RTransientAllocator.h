@@ -0,0 +1,140 @@
+#pragma once
+#include "pch.h"
+#include <atomic>
+
+namespace RAPI
+{
+	class RBuffer;
+
+	// Size of the pages a thread grabs from a shared upload region at once
+	const unsigned int TRANSIENT_PAGE_SIZE = 64 * 1024;
+
+	// Default size of a single upload region per frame
+	const unsigned int TRANSIENT_REGION_DEFAULT_SIZE = 4 * 1024 * 1024;
+
+	/**
+	 * Result of a transient allocation. Only valid until the end of the frame it was made in.
+	 */
+	struct RTransientAllocation
+	{
+		RTransientAllocation()
+		{
+			Data = nullptr;
+			Buffer = nullptr;
+			Offset = 0;
+			Size = 0;
+		}
+
+		/** Returns true if the allocation succeeded */
+		bool IsValid() const
+		{ return Data != nullptr; }
+
+		// CPU-Memory to write the data into
+		void *Data;
+
+		// Buffer the data will end up in after the region was flushed
+		RBuffer *Buffer;
+
+		// Offset of the data inside the buffer, in bytes
+		unsigned int Offset;
+
+		// Size of the allocation in bytes
+		unsigned int Size;
+	};
+
+	/**
+	 * Linear upload region shared by all threads for a single frame. Threads reserve whole pages
+	 * from it using a single atomic add and suballocate inside them without any synchronization.
+	 * The used part of the region gets uploaded into its buffer in one go when the frame ends.
+	 */
+	class RTransientUploadRegion
+	{
+	public:
+		RTransientUploadRegion(EBindFlags bindFlags, unsigned int capacity);
+
+		~RTransientUploadRegion();
+
+		/**
+		 * Reserves a range of the given size. Returns false if the region is exhausted. Lock-free.
+		 */
+		bool Reserve(unsigned int size, unsigned int &offsetOut);
+
+		/**
+		 * Uploads everything written this frame into the GPU-Buffer. Must be called on the main-thread.
+		 */
+		bool Flush();
+
+		/**
+		 * Starts a new frame. All previously handed out ranges get invalid.
+		 */
+		void Reset();
+
+		/**
+		 * Getters
+		 */
+		EBindFlags GetBindFlags()
+		{ return BindFlags; }
+
+		RBuffer *GetBuffer()
+		{ return Buffer; }
+
+		byte *GetStagingData()
+		{ return Staging.data(); }
+
+		unsigned int GetGeneration()
+		{ return Generation.load(std::memory_order_acquire); }
+
+		unsigned int GetUsedBytes()
+		{ return std::min(Used.load(std::memory_order_acquire), Capacity); }
+
+	private:
+		// Kind of buffer this region is uploaded to
+		EBindFlags BindFlags;
+
+		// Maximum number of bytes for a single frame
+		unsigned int Capacity;
+
+		// CPU-Side copy of the data written this frame
+		std::vector<byte> Staging;
+
+		// Bytes reserved by all threads so far
+		std::atomic<unsigned int> Used;
+
+		// Counts up each frame, so threads know when their pages got invalid
+		std::atomic<unsigned int> Generation;
+
+		// Buffer holding the data on the GPU. Created on the first flush.
+		RBuffer *Buffer;
+		bool BufferCreated;
+	};
+
+	/**
+	 * Allocator owned by a single thread. Hands out suballocations from its current page
+	 * of the shared upload region and only touches the region when a page is used up.
+	 */
+	class RTransientAllocator
+	{
+	public:
+		RTransientAllocator();
+
+		/**
+		 * Allocates memory from the given region. The returned memory may be written until the end of the frame.
+		 */
+		RTransientAllocation Allocate(RTransientUploadRegion *region, unsigned int size, unsigned int alignment);
+
+	private:
+		struct Page
+		{
+			RTransientUploadRegion *Region;
+			unsigned int Generation;
+			unsigned int Cursor;
+			unsigned int End;
+		};
+
+		/** Returns the page-slot used for the given region */
+		Page &GetPageFor(RTransientUploadRegion *region);
+
+		// Current pages, one per region this thread has allocated from
+		std::vector<Page> Pages;
+	};
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+namespace RAPI
+{
+	/**
+	 * Fixed size Chase-Lev work-stealing deque. The owning thread pushes and pops at the bottom,
+	 * any other thread may steal from the top. Memory orderings follow
+	 * "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al., 2013).
+	 *
+	 * T must be trivially copyable (usually a pointer). Capacity must be a power of two.
+	 */
+	template<typename T, size_t Capacity>
+	class RWorkStealingDeque
+	{
+		static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+	public:
+		RWorkStealingDeque()
+		{
+			Top.store(0, std::memory_order_relaxed);
+			Bottom.store(0, std::memory_order_relaxed);
+		}
+
+		/**
+		 * Pushes an item to the bottom. Owner only. Returns false if the deque is full.
+		 */
+		bool Push(T item)
+		{
+			int64_t b = Bottom.load(std::memory_order_relaxed);
+			int64_t t = Top.load(std::memory_order_acquire);
+
+			if(b - t >= (int64_t)Capacity)
+				return false;
+
+			Buffer[b & (Capacity - 1)].store(item, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			Bottom.store(b + 1, std::memory_order_relaxed);
+
+			return true;
+		}
+
+		/**
+		 * Takes the most recently pushed item. Owner only.
+		 */
+		bool Pop(T &out)
+		{
+			int64_t b = Bottom.load(std::memory_order_relaxed) - 1;
+			Bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t t = Top.load(std::memory_order_relaxed);
+
+			if(t > b)
+			{
+				// Empty
+				Bottom.store(b + 1, std::memory_order_relaxed);
+				return false;
+			}
+
+			out = Buffer[b & (Capacity - 1)].load(std::memory_order_relaxed);
+
+			if(t == b)
+			{
+				// Last item, race against thieves
+				bool won = Top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+													   std::memory_order_relaxed);
+				Bottom.store(b + 1, std::memory_order_relaxed);
+				return won;
+			}
+
+			return true;
+		}
+
+		/**
+		 * Takes the oldest item. Can be called from any thread.
+		 */
+		bool Steal(T &out)
+		{
+			int64_t t = Top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t b = Bottom.load(std::memory_order_acquire);
+
+			if(t >= b)
+				return false;
+
+			T item = Buffer[t & (Capacity - 1)].load(std::memory_order_relaxed);
+			if(!Top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				return false; // Lost against an other thief or the owner
+
+			out = item;
+			return true;
+		}
+
+		/**
+		 * Approximate number of items in the deque
+		 */
+		size_t SizeApprox() const
+		{
+			int64_t b = Bottom.load(std::memory_order_relaxed);
+			int64_t t = Top.load(std::memory_order_relaxed);
+			return b > t ? (size_t)(b - t) : 0;
+		}
+
+	private:
+		// Keep the indices on their own cachelines, thieves hammer Top. Padding rather than alignas,
+		// so heap-allocated deques work without C++17 aligned new.
+		std::atomic<int64_t> Top;
+		char PadTop[64 - sizeof(std::atomic<int64_t>)];
+		std::atomic<int64_t> Bottom;
+		char PadBottom[64 - sizeof(std::atomic<int64_t>)];
+		std::atomic<T> Buffer[Capacity];
+	};
+}